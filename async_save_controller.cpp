@@ -0,0 +1,42 @@
+#include "async_save_controller.h"
+#include "warehouse.h"
+#include <QMetaObject>
+
+using namespace std;
+
+AsyncSaveController::AsyncSaveController(Warehouse& _warehouse, QObject* parent)
+    : QObject(parent), warehouse(_warehouse) {}
+
+bool AsyncSaveController::start() {
+    if (running) return false;
+
+    // Обратные вызовы приходят из потока записи: в поток интерфейса они
+    // передаются очередью событий. Если контроллер к тому времени удален,
+    // Qt просто отбрасывает событие.
+    int lastPercent = -1;
+    auto onProgress = [this, lastPercent](uint64_t written, uint64_t total) mutable {
+        int percent = total > 0 ? static_cast<int>(written * 100 / total) : 100;
+        if (percent == lastPercent) return;
+        lastPercent = percent;
+        QMetaObject::invokeMethod(this, [this, percent] { emit progress(percent); },
+                                  Qt::QueuedConnection);
+    };
+    auto onFinished = [this](bool success) {
+        QMetaObject::invokeMethod(this, [this, success] { complete(success); },
+                                  Qt::QueuedConnection);
+    };
+
+    running = true;
+    timer.start();
+    if (!warehouse.saveInBackground(onProgress, onFinished)) {
+        running = false;
+        return false;
+    }
+    emit started();
+    return true;
+}
+
+void AsyncSaveController::complete(bool success) {
+    running = false;
+    emit finished(success, timer.elapsed());
+}
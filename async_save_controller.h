@@ -0,0 +1,39 @@
+#ifndef ASYNC_SAVE_CONTROLLER_H
+#define ASYNC_SAVE_CONTROLLER_H
+
+#include <QObject>
+#include <QElapsedTimer>
+
+class Warehouse;
+
+// Сохранение склада без блокировки окна.
+//
+// Копия состояния снимается в потоке интерфейса за время, не зависящее
+// от размера каталога (колонки товаров разделяются с хранилищем), а снимок
+// пишется в фоновом потоке (Warehouse::saveInBackground). Ход и результат
+// передаются сигналами в поток интерфейса; пока идет запись, склад можно
+// менять - изменения попадают в журнал и в следующий снимок.
+class AsyncSaveController : public QObject {
+    Q_OBJECT
+
+public:
+    explicit AsyncSaveController(Warehouse& warehouse, QObject* parent = nullptr);
+
+    // false - запись уже идет или начать ее не удалось
+    bool start();
+    bool isRunning() const { return running; }
+
+signals:
+    void started();
+    void progress(int percent);
+    void finished(bool success, qint64 elapsedMs);
+
+private:
+    Warehouse& warehouse;
+    bool running = false;
+    QElapsedTimer timer;
+
+    void complete(bool success);
+};
+
+#endif // ASYNC_SAVE_CONTROLLER_H
@@ -0,0 +1,132 @@
+#include "block_codec.h"
+#include <vector>
+#include <cstring>
+#include <cstdint>
+
+using namespace std;
+
+namespace {
+
+const size_t MIN_MATCH = 4;
+const size_t MAX_OFFSET = 65535;
+// Последние байты блока всегда идут литералами: поиск совпадений
+// не читает за концом данных
+const size_t TAIL_LITERALS = 8;
+const unsigned HASH_BITS = 14;
+
+uint32_t read32(const char* p) {
+    uint32_t value;
+    memcpy(&value, p, sizeof(value));
+    return value;
+}
+
+uint32_t hash4(uint32_t value) {
+    return (value * 2654435761u) >> (32 - HASH_BITS);
+}
+
+void putLength(string& out, size_t length) {
+    while (length >= 255) {
+        out += static_cast<char>(255);
+        length -= 255;
+    }
+    out += static_cast<char>(length);
+}
+
+void putSequence(string& out, const char* literals, size_t literalCount,
+                 size_t offset, size_t matchLength) {
+    size_t matchCode = matchLength >= MIN_MATCH ? matchLength - MIN_MATCH : 0;
+    unsigned char token = static_cast<unsigned char>(
+        (literalCount < 15 ? literalCount : 15) << 4 | (matchCode < 15 ? matchCode : 15));
+    out += static_cast<char>(token);
+    if (literalCount >= 15) putLength(out, literalCount - 15);
+    out.append(literals, literalCount);
+    if (matchLength == 0) return;
+    out += static_cast<char>(offset & 0xFF);
+    out += static_cast<char>(offset >> 8);
+    if (matchCode >= 15) putLength(out, matchCode - 15);
+}
+
+// Читает продолжение длины; false при выходе за конец входа
+bool getLength(const unsigned char*& p, const unsigned char* end, size_t& length) {
+    unsigned char byte;
+    do {
+        if (p >= end) return false;
+        byte = *p++;
+        length += byte;
+    } while (byte == 255);
+    return true;
+}
+
+} // namespace
+
+size_t BlockCodec::compress(const char* data, size_t size, string& out) {
+    size_t start = out.size();
+    out.reserve(start + size + size / 255 + 16);
+
+    vector<uint32_t> table(size_t(1) << HASH_BITS, UINT32_MAX);
+    size_t anchor = 0;
+    size_t position = 0;
+    size_t limit = size > TAIL_LITERALS + MIN_MATCH ? size - TAIL_LITERALS - MIN_MATCH : 0;
+
+    while (position < limit) {
+        uint32_t value = read32(data + position);
+        uint32_t& slot = table[hash4(value)];
+        size_t candidate = slot;
+        slot = static_cast<uint32_t>(position);
+        if (candidate == UINT32_MAX || position - candidate > MAX_OFFSET ||
+            read32(data + candidate) != value) {
+            position++;
+            continue;
+        }
+
+        size_t length = MIN_MATCH;
+        size_t maxLength = size - TAIL_LITERALS - position;
+        while (length < maxLength && data[candidate + length] == data[position + length]) length++;
+
+        putSequence(out, data + anchor, position - anchor, position - candidate, length);
+        position += length;
+        anchor = position;
+    }
+
+    putSequence(out, data + anchor, size - anchor, 0, 0);
+    return out.size() - start;
+}
+
+bool BlockCodec::decompress(const char* data, size_t size, char* output, size_t rawSize) {
+    const unsigned char* p = reinterpret_cast<const unsigned char*>(data);
+    const unsigned char* end = p + size;
+    size_t written = 0;
+
+    while (p < end) {
+        unsigned char token = *p++;
+
+        size_t literalCount = token >> 4;
+        if (literalCount == 15 && !getLength(p, end, literalCount)) return false;
+        if (literalCount > static_cast<size_t>(end - p) || literalCount > rawSize - written) {
+            return false;
+        }
+        memcpy(output + written, p, literalCount);
+        p += literalCount;
+        written += literalCount;
+        if (p == end) break;                    // последняя последовательность
+
+        if (end - p < 2) return false;
+        size_t offset = p[0] | size_t(p[1]) << 8;
+        p += 2;
+        size_t matchLength = token & 15;
+        if (matchLength == 15 && !getLength(p, end, matchLength)) return false;
+        matchLength += MIN_MATCH;
+        if (offset == 0 || offset > written || matchLength > rawSize - written) return false;
+
+        // Совпадение может перекрывать само себя (повтор коротких серий)
+        char* target = output + written;
+        const char* source = target - offset;
+        if (offset >= matchLength) {
+            memcpy(target, source, matchLength);
+        } else {
+            for (size_t i = 0; i < matchLength; i++) target[i] = source[i];
+        }
+        written += matchLength;
+    }
+    return written == rawSize;
+}
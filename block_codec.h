@@ -0,0 +1,23 @@
+#ifndef BLOCK_CODEC_H
+#define BLOCK_CODEC_H
+
+#include <string>
+#include <cstddef>
+
+// Сжатие блоков данных без внешних зависимостей (семейство LZ77, формат
+// последовательностей как у LZ4): [токен][литералы][смещение 2 байта][длина].
+// Старшие 4 бита токена - число литералов, младшие - длина совпадения минус 4;
+// значение 15 продолжается байтами по 255. Последняя последовательность
+// состоит только из литералов. Рассчитано на блоки до нескольких сотен КБ.
+namespace BlockCodec {
+
+// Дописывает сжатые данные в out; возвращает их размер
+size_t compress(const char* data, size_t size, std::string& out);
+
+// Распаковывает ровно rawSize байт в output. false - данные повреждены
+// (проверяются все длины и смещения, за границы буферов чтение не выходит).
+bool decompress(const char* data, size_t size, char* output, size_t rawSize);
+
+}
+
+#endif // BLOCK_CODEC_H
@@ -0,0 +1,181 @@
+#include "change_delta.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+DeltaExportResult DeltaWriter::write(const string& filename, const string& basePath,
+                                     uint64_t sourceId, WalPosition from, WalPosition to) {
+    DeltaExportResult result;
+    result.from = from;
+    result.to = to;
+
+    string tempFilename = filename + ".tmp";
+    FILE* file = fopen(tempFilename.c_str(), "wb");
+    if (!file) {
+        result.error = "Не удалось создать файл " + tempFilename;
+        return result;
+    }
+    vector<char> buffer(1 << 20);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    DeltaHeader header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, 1, sizeof(header), file) == sizeof(header);
+    uint64_t position = sizeof(header);
+    SnapshotChecksum checksum;
+    auto put = [&](const void* data, size_t size) {
+        checksum.update(data, size);
+        ok = ok && fwrite(data, 1, size, file) == size;
+        position += size;
+    };
+
+    vector<uint64_t> generations = WriteAheadLog::listGenerations(basePath);
+    for (uint64_t generation = from.generation; ok && generation <= to.generation; generation++) {
+        uint64_t start = generation == from.generation ? from.offset : 0;
+        if (generation == to.generation && start >= to.offset) break;
+        if (!binary_search(generations.begin(), generations.end(), generation)) {
+            result.error = "Поколение журнала " + to_string(generation) + " уже удалено";
+            ok = false;
+            break;
+        }
+
+        string path = WriteAheadLog::generationPath(basePath, generation);
+        MappedFile log;
+        if (!log.open(path)) {
+            result.error = "Не удалось открыть журнал " + path;
+            ok = false;
+            break;
+        }
+        uint64_t end = generation == to.generation ? min<uint64_t>(to.offset, log.size()) : log.size();
+        if (start >= end) continue;
+
+        // Берутся только целые кадры: оборванный после сбоя хвост поколения
+        // не подтвержден и в пакет не попадает
+        size_t records = 0;
+        size_t size = WriteAheadLog::scanFrames(log.data() + start, end - start,
+            [&records](const char*, size_t, size_t, WalRecordReader&) {
+                records++;
+                return true;
+            });
+        if (size == 0) continue;
+
+        DeltaChunk chunk{generation, start, size};
+        put(&chunk, sizeof(chunk));
+        put(log.data() + start, size);
+        header.chunkCount++;
+        result.records += records;
+    }
+
+    memcpy(header.magic, DELTA_MAGIC, sizeof(header.magic));
+    header.version = DELTA_VERSION;
+    header.headerSize = sizeof(DeltaHeader);
+    header.checksum = checksum.finish();
+    header.fileSize = position;
+    header.sourceId = sourceId;
+    header.fromGeneration = from.generation;
+    header.fromOffset = from.offset;
+    header.toGeneration = to.generation;
+    header.toOffset = to.offset;
+    header.recordCount = result.records;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+         fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(tempFilename.c_str());
+        if (result.error.empty()) result.error = "Ошибка записи в " + tempFilename;
+        return result;
+    }
+    remove(filename.c_str());
+    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        remove(tempFilename.c_str());
+        result.error = "Не удалось переименовать " + tempFilename;
+        return result;
+    }
+    result.bytes = position;
+    result.success = true;
+    return result;
+}
+
+bool DeltaReader::fail(const string& message) {
+    error = message;
+    file.close();
+    header = nullptr;
+    return false;
+}
+
+bool DeltaReader::open(const string& filename) {
+    if (!file.open(filename)) return fail("Не удалось открыть файл " + filename);
+
+    const char* data = file.data();
+    size_t size = file.size();
+    if (size < sizeof(DeltaHeader)) return fail("Файл слишком мал: " + filename);
+    header = reinterpret_cast<const DeltaHeader*>(data);
+    if (memcmp(header->magic, DELTA_MAGIC, sizeof(DELTA_MAGIC)) != 0 ||
+        header->version == 0 || header->version > DELTA_VERSION ||
+        header->headerSize < sizeof(DeltaHeader) || header->fileSize != size ||
+        to() < from()) {
+        return fail("Файл не является пакетом изменений склада: " + filename);
+    }
+
+    SnapshotChecksum checksum;
+    checksum.update(data + header->headerSize, size - header->headerSize);
+    if (checksum.finish() != header->checksum) {
+        return fail("Контрольная сумма пакета не совпадает: " + filename);
+    }
+
+    // Участки должны покрывать файл целиком и состоять из целых кадров
+    size_t position = header->headerSize;
+    uint64_t records = 0;
+    for (uint64_t i = 0; i < header->chunkCount; i++) {
+        DeltaChunk chunk;
+        if (size - position < sizeof(chunk)) return fail("Пакет изменений оборван: " + filename);
+        memcpy(&chunk, data + position, sizeof(chunk));
+        position += sizeof(chunk);
+        if (chunk.size > size - position) return fail("Пакет изменений оборван: " + filename);
+        size_t parsed = WriteAheadLog::scanFrames(data + position, chunk.size,
+            [&records](const char*, size_t, size_t, WalRecordReader&) {
+                records++;
+                return true;
+            });
+        if (parsed != chunk.size) return fail("Поврежденная запись в пакете " + filename);
+        position += chunk.size;
+    }
+    if (position != size || records != header->recordCount) {
+        return fail("Поврежденный пакет изменений " + filename);
+    }
+    return true;
+}
+
+bool DeltaReader::forEach(const RecordVisitor& visit) const {
+    const char* data = file.data();
+    size_t position = header->headerSize;
+    for (uint64_t i = 0; i < header->chunkCount; i++) {
+        DeltaChunk chunk;
+        memcpy(&chunk, data + position, sizeof(chunk));
+        position += sizeof(chunk);
+        bool stopped = false;
+        WriteAheadLog::scanFrames(data + position, chunk.size,
+            [&](const char* frame, size_t frameSize, size_t offset, WalRecordReader& record) {
+                if (visit(frame, frameSize, WalPosition{chunk.generation, chunk.offset + offset},
+                          record)) {
+                    return true;
+                }
+                stopped = true;
+                return false;
+            });
+        if (stopped) return false;
+        position += chunk.size;
+    }
+    return true;
+}
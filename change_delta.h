@@ -0,0 +1,103 @@
+#ifndef CHANGE_DELTA_H
+#define CHANGE_DELTA_H
+
+#include "mapped_file.h"
+#include "write_ahead_log.h"
+#include <string>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Пакет изменений склада для зеркала (например, в центральном офисе).
+//
+// Пакет - это записи журнала источника между двумя позициями [from, to)
+// в исходном двоичном виде: создание и удаление товаров, новые остатки,
+// документы и их проведение. Записи сгруппированы по поколениям журнала
+// (DeltaChunk + кадры подряд), каждая сохраняет свою контрольную сумму;
+// весь пакет дополнительно покрыт SnapshotChecksum.
+//
+// Зеркало начинается с копии снимка источника (<base>.bin и сегменты
+// <base>.cold.*): в его заголовке записаны id источника и позиция журнала,
+// которой соответствует снимок. Дальше зеркало применяет пакеты по порядку;
+// уже примененные записи пропускаются, поэтому повторный или перекрывающийся
+// пакет безопасен (см. Warehouse::importChanges). Зеркало повторяет один
+// источник: id товаров и документов разных складов выдаются независимо и
+// пересекаются, поэтому пакеты другого склада применяются к его собственному
+// зеркалу, а не сливаются в одно.
+
+constexpr char DELTA_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'D', 'L', 'T'};
+constexpr uint32_t DELTA_VERSION = 1;
+
+struct DeltaHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t checksum;             // SnapshotChecksum всего, что после заголовка
+    uint64_t fileSize;
+    uint64_t sourceId;             // склад, чьи изменения в пакете
+    uint64_t fromGeneration;
+    uint64_t fromOffset;
+    uint64_t toGeneration;
+    uint64_t toOffset;
+    uint64_t recordCount;
+    uint64_t chunkCount;
+};
+
+// Непрерывный участок одного поколения журнала; за ним size байт кадров
+struct DeltaChunk {
+    uint64_t generation;
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct DeltaExportResult {
+    bool success = false;
+    std::string error;
+    size_t records = 0;
+    uint64_t bytes = 0;
+    WalPosition from;
+    WalPosition to;
+};
+
+struct DeltaImportResult {
+    bool success = false;
+    std::string error;
+    size_t appliedRecords = 0;
+    size_t skippedRecords = 0;     // уже были применены раньше
+};
+
+class DeltaWriter {
+public:
+    // Собирает записи журнала basePath в [from, to) в файл filename
+    // (через <filename>.part, с fsync). Все поколения журнала в этом
+    // диапазоне должны быть на диске.
+    static DeltaExportResult write(const std::string& filename, const std::string& basePath,
+                                   uint64_t sourceId, WalPosition from, WalPosition to);
+};
+
+class DeltaReader {
+public:
+    // Кадр записи целиком, позиция записи в журнале источника и сама запись
+    using RecordVisitor = std::function<bool(const char* frame, size_t frameSize,
+                                             WalPosition position, WalRecordReader& record)>;
+
+    bool open(const std::string& filename);
+    const std::string& getError() const { return error; }
+
+    uint64_t sourceId() const { return header->sourceId; }
+    WalPosition from() const { return WalPosition{header->fromGeneration, header->fromOffset}; }
+    WalPosition to() const { return WalPosition{header->toGeneration, header->toOffset}; }
+    size_t recordCount() const { return static_cast<size_t>(header->recordCount); }
+
+    // Обходит записи по порядку; false - visit остановил обход
+    bool forEach(const RecordVisitor& visit) const;
+
+private:
+    MappedFile file;
+    const DeltaHeader* header = nullptr;
+    std::string error;
+
+    bool fail(const std::string& message);
+};
+
+#endif // CHANGE_DELTA_H
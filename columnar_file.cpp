@@ -0,0 +1,457 @@
+#include "columnar_file.h"
+#include "snapshot.h"
+#include <algorithm>
+#include <unordered_map>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+ColumnarWriter::ColumnarWriter(vector<ColumnarColumnSpec> _schema, size_t _rowGroupRows)
+    : schema(std::move(_schema)), rowGroupRows(max<size_t>(1, _rowGroupRows)),
+      buffers(schema.size()), fileBuffer(1 << 20) {}
+
+// Файл, не завершенный finish(), не остается на диске даже частично
+ColumnarWriter::~ColumnarWriter() {
+    if (file) {
+        fclose(file);
+        remove(tempFilename.c_str());
+    }
+}
+
+bool ColumnarWriter::fail(const string& message) {
+    if (error.empty()) error = message;
+    if (file) {
+        fclose(file);
+        file = nullptr;
+        remove(tempFilename.c_str());
+    }
+    return false;
+}
+
+bool ColumnarWriter::write(const void* data, size_t size) {
+    if (fwrite(data, 1, size, file) != size) return fail("Ошибка записи в " + tempFilename);
+    position += size;
+    return true;
+}
+
+bool ColumnarWriter::open(const string& _filename) {
+    filename = _filename;
+    tempFilename = filename + ".tmp";
+    file = fopen(tempFilename.c_str(), "wb");
+    if (!file) return fail("Не удалось создать файл " + tempFilename);
+    setvbuf(file, fileBuffer.data(), _IOFBF, fileBuffer.size());
+
+    // Заголовок перезаписывается в finish()
+    ColumnarFileHeader header;
+    memset(&header, 0, sizeof(header));
+    position = 0;
+    return write(&header, sizeof(header));
+}
+
+void ColumnarWriter::setInt(size_t column, int64_t value) {
+    buffers[column].ints.push_back(value);
+}
+
+void ColumnarWriter::setDouble(size_t column, double value) {
+    buffers[column].reals.push_back(value);
+}
+
+void ColumnarWriter::setString(size_t column, string_view value) {
+    ColumnBuffer& buffer = buffers[column];
+    buffer.bytes.append(value.data(), value.size());
+    buffer.offsets.push_back(static_cast<uint32_t>(buffer.bytes.size()));
+}
+
+size_t ColumnarWriter::valueCount(size_t column) const {
+    switch (schema[column].type) {
+        case ColumnarType::DOUBLE: return buffers[column].reals.size();
+        case ColumnarType::STRING: return buffers[column].offsets.size();
+        default: return buffers[column].ints.size();
+    }
+}
+
+bool ColumnarWriter::endRow() {
+    if (!file) return fail("Файл " + filename + " не открыт");
+    for (size_t column = 0; column < schema.size(); column++) {
+        if (valueCount(column) != groupRows + 1) {
+            return fail("Строка " + to_string(totalRows + 1) + ": столбец " + schema[column].name +
+                        " задан не один раз или не задан");
+        }
+    }
+    groupRows++;
+    totalRows++;
+    return groupRows < rowGroupRows || flushGroup();
+}
+
+void ColumnarWriter::encodeNumbers(size_t column, ColumnarChunkInfo& info) {
+    const ColumnBuffer& buffer = buffers[column];
+    if (schema[column].type == ColumnarType::DOUBLE) {
+        auto range = minmax_element(buffer.reals.begin(), buffer.reals.end());
+        info.minReal = *range.first;
+        info.maxReal = *range.second;
+        chunk.append(reinterpret_cast<const char*>(buffer.reals.data()),
+                     buffer.reals.size() * sizeof(double));
+        return;
+    }
+
+    auto range = minmax_element(buffer.ints.begin(), buffer.ints.end());
+    info.minInt = *range.first;
+    info.maxInt = *range.second;
+    if (schema[column].type == ColumnarType::INT64) {
+        chunk.append(reinterpret_cast<const char*>(buffer.ints.data()),
+                     buffer.ints.size() * sizeof(int64_t));
+        return;
+    }
+    size_t start = chunk.size();
+    chunk.resize(start + buffer.ints.size() * sizeof(int32_t));
+    char* out = &chunk[start];
+    for (int64_t value : buffer.ints) {
+        int32_t narrow = static_cast<int32_t>(value);
+        memcpy(out, &narrow, sizeof(narrow));
+        out += sizeof(narrow);
+    }
+}
+
+void ColumnarWriter::encodeStrings(size_t column, ColumnarChunkInfo& info) {
+    const ColumnBuffer& buffer = buffers[column];
+    size_t rows = buffer.offsets.size();
+    auto valueAt = [&buffer](size_t row) {
+        uint32_t begin = row == 0 ? 0 : buffer.offsets[row - 1];
+        return string_view(buffer.bytes.data() + begin, buffer.offsets[row] - begin);
+    };
+    auto appendOffset = [this](uint32_t offset) {
+        chunk.append(reinterpret_cast<const char*>(&offset), sizeof(offset));
+    };
+
+    // Словарь выгоден, когда различных значений не больше половины строк;
+    // как только их становится больше, построение прекращается
+    size_t limit = rows / 2;
+    unordered_map<string_view, uint32_t> dictionary;
+    vector<string_view> values;
+    vector<uint32_t> codes(rows);
+    bool useDictionary = limit > 0;
+    for (size_t row = 0; useDictionary && row < rows; row++) {
+        auto inserted = dictionary.emplace(valueAt(row), static_cast<uint32_t>(values.size()));
+        if (inserted.second) {
+            values.push_back(inserted.first->first);
+            useDictionary = values.size() <= limit;
+        }
+        codes[row] = inserted.first->second;
+    }
+
+    if (!useDictionary) {
+        info.encoding = ColumnarEncoding::PLAIN;
+        appendOffset(0);
+        chunk.append(reinterpret_cast<const char*>(buffer.offsets.data()), rows * sizeof(uint32_t));
+        chunk.append(buffer.bytes);
+        return;
+    }
+
+    info.encoding = ColumnarEncoding::DICTIONARY;
+    info.dictionarySize = static_cast<uint32_t>(values.size());
+    info.codeWidth = values.size() <= 0x100 ? 1 : values.size() <= 0x10000 ? 2 : 4;
+    uint32_t offset = 0;
+    appendOffset(offset);
+    for (string_view value : values) {
+        offset += static_cast<uint32_t>(value.size());
+        appendOffset(offset);
+    }
+    for (string_view value : values) chunk.append(value.data(), value.size());
+    chunk.append((4 - chunk.size() % 4) % 4, '\0');
+    info.codesOffset = static_cast<uint32_t>(chunk.size());
+
+    size_t start = chunk.size();
+    chunk.resize(start + rows * info.codeWidth);
+    unsigned char* out = reinterpret_cast<unsigned char*>(&chunk[start]);
+    for (uint32_t code : codes) {
+        for (uint32_t byte = 0; byte < info.codeWidth; byte++) *out++ = (code >> (8 * byte)) & 0xFF;
+    }
+}
+
+bool ColumnarWriter::flushGroup() {
+    if (groupRows == 0) return true;
+    static const char zeros[8] = {0};
+
+    for (size_t column = 0; column < schema.size(); column++) {
+        ColumnarChunkInfo info;
+        memset(&info, 0, sizeof(info));
+        chunk.clear();
+        if (schema[column].type == ColumnarType::STRING) {
+            encodeStrings(column, info);
+        } else {
+            encodeNumbers(column, info);
+        }
+
+        // Участки выровнены по 8 байт: числа читаются прямо из отображенного файла
+        size_t padding = static_cast<size_t>((8 - position % 8) % 8);
+        if (!write(zeros, padding)) return false;
+        SnapshotChecksum checksum;
+        checksum.update(chunk.data(), chunk.size());
+        info.offset = position;
+        info.size = chunk.size();
+        info.checksum = checksum.finish();
+        if (!write(chunk.data(), chunk.size())) return false;
+        chunks.push_back(info);
+
+        ColumnBuffer& buffer = buffers[column];
+        buffer.ints.clear();
+        buffer.reals.clear();
+        buffer.offsets.clear();
+        buffer.bytes.clear();
+    }
+    groups.push_back({totalRows - groupRows, groupRows});
+    groupRows = 0;
+    return true;
+}
+
+bool ColumnarWriter::finish() {
+    if (!file) return error.empty();
+    if (!flushGroup()) return false;
+
+    static const char zeros[8] = {0};
+    size_t padding = static_cast<size_t>((8 - position % 8) % 8);
+    if (!write(zeros, padding)) return false;
+
+    ColumnarFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, COLUMNAR_MAGIC, sizeof(header.magic));
+    header.version = COLUMNAR_VERSION;
+    header.headerSize = sizeof(ColumnarFileHeader);
+    header.columnCount = static_cast<uint32_t>(schema.size());
+    header.rowCount = totalRows;
+    header.rowGroupCount = groups.size();
+
+    header.columnsOffset = position;
+    for (const ColumnarColumnSpec& spec : schema) {
+        ColumnarColumnInfo info;
+        memset(&info, 0, sizeof(info));
+        memcpy(info.name, spec.name.data(), min(spec.name.size(), sizeof(info.name) - 1));
+        info.type = spec.type;
+        if (!write(&info, sizeof(info))) return false;
+    }
+    header.groupsOffset = position;
+    if (!write(groups.data(), groups.size() * sizeof(ColumnarRowGroupInfo))) return false;
+    header.chunksOffset = position;
+    if (!write(chunks.data(), chunks.size() * sizeof(ColumnarChunkInfo))) return false;
+    header.fileSize = position;
+
+    bool ok = fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+              fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok) {
+        remove(tempFilename.c_str());
+        return fail("Ошибка записи в " + tempFilename);
+    }
+    remove(filename.c_str());
+    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        remove(tempFilename.c_str());
+        return fail("Не удалось переименовать " + tempFilename);
+    }
+    return true;
+}
+
+bool ColumnarReader::fail(const string& message) {
+    error = message;
+    return false;
+}
+
+bool ColumnarReader::open(const string& filename) {
+    error.clear();
+    header = nullptr;
+    auto reject = [this](const string& message) {
+        header = nullptr;
+        file.close();
+        return fail(message);
+    };
+    if (!file.open(filename)) return reject("Не удалось открыть файл " + filename);
+    size_t size = file.size();
+    if (size < sizeof(ColumnarFileHeader)) return reject("Файл слишком мал: " + filename);
+
+    header = reinterpret_cast<const ColumnarFileHeader*>(file.data());
+    if (memcmp(header->magic, COLUMNAR_MAGIC, sizeof(COLUMNAR_MAGIC)) != 0) {
+        return reject("Файл не является колоночной выгрузкой: " + filename);
+    }
+    if (header->version == 0 || header->version > COLUMNAR_VERSION) {
+        return reject("Неподдерживаемая версия файла: " + to_string(header->version));
+    }
+    uint64_t chunkCount = header->rowGroupCount * header->columnCount;
+    if (header->headerSize < sizeof(ColumnarFileHeader) || header->fileSize != size ||
+        header->columnsOffset % 8 != 0 || header->columnsOffset > size ||
+        header->columnCount > (size - header->columnsOffset) / sizeof(ColumnarColumnInfo) ||
+        header->groupsOffset != header->columnsOffset + header->columnCount * sizeof(ColumnarColumnInfo) ||
+        header->rowGroupCount > (size - header->groupsOffset) / sizeof(ColumnarRowGroupInfo) ||
+        header->chunksOffset != header->groupsOffset + header->rowGroupCount * sizeof(ColumnarRowGroupInfo) ||
+        (header->columnCount > 0 && chunkCount / header->columnCount != header->rowGroupCount) ||
+        chunkCount > (size - header->chunksOffset) / sizeof(ColumnarChunkInfo)) {
+        return reject("Поврежденный заголовок файла " + filename);
+    }
+
+    columns = reinterpret_cast<const ColumnarColumnInfo*>(file.data() + header->columnsOffset);
+    groups = reinterpret_cast<const ColumnarRowGroupInfo*>(file.data() + header->groupsOffset);
+    chunks = reinterpret_cast<const ColumnarChunkInfo*>(file.data() + header->chunksOffset);
+    for (uint32_t column = 0; column < header->columnCount; column++) {
+        if (columns[column].type > ColumnarType::STRING ||
+            memchr(columns[column].name, 0, sizeof(columns[column].name)) == nullptr) {
+            return reject("Поврежденное описание столбцов в " + filename);
+        }
+    }
+    uint64_t rows = 0;
+    for (uint64_t group = 0; group < header->rowGroupCount; group++) {
+        if (groups[group].firstRow != rows) return reject("Поврежденное описание групп в " + filename);
+        rows += groups[group].rowCount;
+    }
+    if (rows != header->rowCount) return reject("Поврежденное описание групп в " + filename);
+    for (uint64_t i = 0; i < chunkCount; i++) {
+        if (chunks[i].offset % 8 != 0 || chunks[i].offset < header->headerSize ||
+            chunks[i].offset > header->columnsOffset ||
+            chunks[i].size > header->columnsOffset - chunks[i].offset) {
+            return reject("Поврежденное описание участков в " + filename);
+        }
+    }
+    verified.assign(static_cast<size_t>(chunkCount), 0);
+    return true;
+}
+
+size_t ColumnarReader::columnIndex(string_view name) const {
+    for (size_t column = 0; column < columnCount(); column++) {
+        if (name == columns[column].name) return column;
+    }
+    return npos;
+}
+
+// Проверяет сумму и разметку участка и настраивает target на его данные.
+// Смещения и коды проверяются целиком, поэтому дальше обращения по ним
+// не выходят за границы участка.
+bool ColumnarReader::decode(size_t group, size_t column, ColumnarVector& target) {
+    size_t index = group * header->columnCount + column;
+    const ColumnarChunkInfo& info = chunks[index];
+    const char* data = file.data() + info.offset;
+    size_t size = static_cast<size_t>(info.size);
+    size_t rows = static_cast<size_t>(groups[group].rowCount);
+    string where = string(" столбца ") + columns[column].name + " в группе " + to_string(group);
+
+    if (!verified[index]) {
+        SnapshotChecksum checksum;
+        checksum.update(data, size);
+        if (checksum.finish() != info.checksum) return fail("Контрольная сумма не совпадает для" + where);
+    }
+
+    target = ColumnarVector();
+    target.type = columns[column].type;
+    target.encoding = info.encoding;
+    target.rows = rows;
+
+    auto checkOffsets = [](const uint32_t* offsets, size_t count, size_t limit) {
+        if (offsets[0] != 0) return false;
+        for (size_t i = 0; i < count; i++) {
+            if (offsets[i + 1] < offsets[i]) return false;
+        }
+        return offsets[count] <= limit;
+    };
+
+    if (target.type != ColumnarType::STRING) {
+        size_t width = target.type == ColumnarType::INT32 ? sizeof(int32_t) : sizeof(int64_t);
+        if (info.encoding != ColumnarEncoding::PLAIN || size != rows * width) {
+            return fail("Поврежденный участок" + where);
+        }
+        target.values = data;
+    } else if (info.encoding == ColumnarEncoding::PLAIN) {
+        size_t offsetBytes = (rows + 1) * sizeof(uint32_t);
+        if (size < offsetBytes) return fail("Поврежденный участок" + where);
+        target.offsets = reinterpret_cast<const uint32_t*>(data);
+        target.bytes = data + offsetBytes;
+        if (!checkOffsets(target.offsets, rows, size - offsetBytes)) {
+            return fail("Поврежденные смещения строк" + where);
+        }
+    } else if (info.encoding == ColumnarEncoding::DICTIONARY) {
+        size_t count = info.dictionarySize;
+        size_t offsetBytes = (count + 1) * sizeof(uint32_t);
+        if ((info.codeWidth != 1 && info.codeWidth != 2 && info.codeWidth != 4) ||
+            info.codesOffset < offsetBytes || info.codesOffset > size ||
+            (size - info.codesOffset) / info.codeWidth != rows ||
+            (size - info.codesOffset) % info.codeWidth != 0) {
+            return fail("Поврежденный словарь" + where);
+        }
+        target.offsets = reinterpret_cast<const uint32_t*>(data);
+        target.bytes = data + offsetBytes;
+        target.codes = reinterpret_cast<const unsigned char*>(data + info.codesOffset);
+        target.dictionaryCount = count;
+        target.codeWidth = info.codeWidth;
+        if (!checkOffsets(target.offsets, count, info.codesOffset - offsetBytes)) {
+            return fail("Поврежденный словарь" + where);
+        }
+        for (size_t row = 0; row < rows; row++) {
+            if (target.codeAt(row) >= count) return fail("Поврежденные коды словаря" + where);
+        }
+    } else {
+        return fail("Неизвестное кодирование" + where);
+    }
+    verified[index] = 1;
+    return true;
+}
+
+bool ColumnarReader::scan(const vector<string>& projection, const vector<ColumnarRange>& ranges,
+                          const BatchVisitor& visit, ColumnarScanStats* stats) {
+    if (!header) return fail("Файл не открыт");
+
+    vector<size_t> selected;
+    for (const string& name : projection) {
+        size_t column = columnIndex(name);
+        if (column == npos) return fail("Нет столбца " + name);
+        selected.push_back(column);
+    }
+    if (projection.empty()) {
+        for (size_t column = 0; column < columnCount(); column++) selected.push_back(column);
+    }
+
+    vector<pair<size_t, const ColumnarRange*>> filters;
+    for (const ColumnarRange& range : ranges) {
+        size_t column = columnIndex(range.column);
+        if (column == npos) return fail("Нет столбца " + range.column);
+        if (columns[column].type == ColumnarType::STRING) {
+            return fail("Условие на диапазон задано для строкового столбца " + range.column);
+        }
+        filters.push_back({column, &range});
+    }
+
+    ColumnarBatch batch;
+    batch.columns.resize(selected.size());
+    for (size_t group = 0; group < rowGroupCount(); group++) {
+        bool matches = true;
+        for (const auto& filter : filters) {
+            const ColumnarChunkInfo& info = chunk(group, filter.first);
+            const ColumnarRange& range = *filter.second;
+            if (columns[filter.first].type == ColumnarType::DOUBLE) {
+                matches = info.maxReal >= range.min && info.minReal <= range.max;
+            } else {
+                matches = static_cast<double>(info.maxInt) >= range.min &&
+                          static_cast<double>(info.minInt) <= range.max;
+            }
+            if (!matches) break;
+        }
+        if (!matches) {
+            if (stats) stats->rowGroupsSkipped++;
+            continue;
+        }
+
+        batch.rowGroup = group;
+        batch.firstRow = static_cast<size_t>(groups[group].firstRow);
+        batch.rows = static_cast<size_t>(groups[group].rowCount);
+        for (size_t i = 0; i < selected.size(); i++) {
+            if (!decode(group, selected[i], batch.columns[i])) return false;
+            if (stats) stats->bytesRead += chunk(group, selected[i]).size;
+        }
+        if (stats) stats->rowGroupsRead++;
+        if (!visit(batch)) break;
+    }
+    return true;
+}
@@ -0,0 +1,252 @@
+#ifndef COLUMNAR_FILE_H
+#define COLUMNAR_FILE_H
+
+#include "mapped_file.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+// Колоночный файл для передачи данных аналитикам (товары, документы,
+// строки документов, движение товаров).
+//
+// Строки таблицы делятся на группы (row group) по DEFAULT_ROW_GROUP_ROWS;
+// внутри группы каждый столбец лежит отдельным непрерывным участком (chunk),
+// выровненным по 8 байт. Числа хранятся массивами как есть, поэтому читатель
+// обращается к ним прямо в отображенном файле. Строки - смещения + байты,
+// а если значения часто повторяются (тип документа, статус, подразделение) -
+// словарем группы и кодами шириной 1, 2 или 4 байта.
+//
+// В конце файла - описание столбцов, групп и участков: смещение, размер,
+// контрольная сумма и min/max числовых столбцов. По ним читатель берет
+// только нужные столбцы и пропускает группы, которые не попадают в условие.
+
+constexpr char COLUMNAR_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'C', 'O', 'L'};
+constexpr uint32_t COLUMNAR_VERSION = 1;
+
+enum class ColumnarType : uint32_t {
+    INT32,
+    INT64,
+    DOUBLE,
+    STRING
+};
+
+enum class ColumnarEncoding : uint32_t {
+    PLAIN,          // числа массивом; строки - uint32 offsets[rows + 1] + байты
+    DICTIONARY      // uint32 offsets[size + 1] + байты словаря, затем коды
+};
+
+struct ColumnarFileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint32_t columnCount;
+    uint32_t reserved;
+    uint64_t rowCount;
+    uint64_t rowGroupCount;
+    uint64_t columnsOffset;       // ColumnarColumnInfo[columnCount]
+    uint64_t groupsOffset;        // ColumnarRowGroupInfo[rowGroupCount]
+    uint64_t chunksOffset;        // ColumnarChunkInfo[rowGroupCount * columnCount]
+    uint64_t fileSize;
+};
+
+struct ColumnarColumnInfo {
+    char name[32];                // ASCII, с нулем в конце
+    ColumnarType type;
+    uint32_t reserved;
+};
+
+struct ColumnarRowGroupInfo {
+    uint64_t firstRow;
+    uint64_t rowCount;
+};
+
+struct ColumnarChunkInfo {
+    uint64_t offset;              // от начала файла
+    uint64_t size;
+    uint64_t checksum;            // SnapshotChecksum участка
+    ColumnarEncoding encoding;
+    uint32_t dictionarySize;      // DICTIONARY: число различных значений
+    uint32_t codeWidth;           // DICTIONARY: байт на код
+    uint32_t codesOffset;         // DICTIONARY: начало кодов от начала участка
+    // Числовые столбцы: диапазон значений группы. INT32/INT64 - в minInt/maxInt,
+    // DOUBLE - в minReal/maxReal; у строк не заполняются
+    int64_t minInt;
+    int64_t maxInt;
+    double minReal;
+    double maxReal;
+};
+
+struct ColumnarColumnSpec {
+    std::string name;
+    ColumnarType type;
+};
+
+// Запись файла построчно: значения столбцов строки задаются set*,
+// затем endRow(). Группа сбрасывается на диск, как только наберется.
+class ColumnarWriter {
+public:
+    static constexpr size_t DEFAULT_ROW_GROUP_ROWS = 64 * 1024;
+
+    explicit ColumnarWriter(std::vector<ColumnarColumnSpec> schema,
+                            size_t rowGroupRows = DEFAULT_ROW_GROUP_ROWS);
+    ~ColumnarWriter();
+
+    ColumnarWriter(const ColumnarWriter&) = delete;
+    ColumnarWriter& operator=(const ColumnarWriter&) = delete;
+
+    // Файл пишется как <filename>.tmp и переименовывается в finish();
+    // без finish() временный файл удаляется
+    bool open(const std::string& filename);
+
+    void setInt(size_t column, int64_t value);
+    void setDouble(size_t column, double value);
+    void setString(size_t column, std::string_view value);
+    // false - не всем столбцам задано значение или ошибка записи
+    bool endRow();
+    bool finish();
+
+    size_t rowCount() const { return totalRows; }
+    const std::string& getError() const { return error; }
+
+private:
+    struct ColumnBuffer {
+        std::vector<int64_t> ints;
+        std::vector<double> reals;
+        std::vector<uint32_t> offsets;    // строки: конец каждого значения в bytes
+        std::string bytes;
+    };
+
+    std::vector<ColumnarColumnSpec> schema;
+    size_t rowGroupRows;
+    std::vector<ColumnBuffer> buffers;
+    size_t groupRows = 0;
+    size_t totalRows = 0;
+
+    std::string filename;
+    std::string tempFilename;
+    FILE* file = nullptr;
+    std::vector<char> fileBuffer;
+    uint64_t position = 0;
+    std::vector<ColumnarRowGroupInfo> groups;
+    std::vector<ColumnarChunkInfo> chunks;
+    std::string chunk;                    // участок, собираемый перед записью
+    std::string error;
+
+    size_t valueCount(size_t column) const;
+    bool flushGroup();
+    void encodeNumbers(size_t column, ColumnarChunkInfo& info);
+    void encodeStrings(size_t column, ColumnarChunkInfo& info);
+    bool write(const void* data, size_t size);
+    bool fail(const std::string& message);
+};
+
+// Столбец одной группы в отображенном файле (без копирования)
+class ColumnarVector {
+public:
+    ColumnarType type = ColumnarType::INT32;
+    ColumnarEncoding encoding = ColumnarEncoding::PLAIN;
+    size_t rows = 0;
+
+    int64_t intAt(size_t row) const {
+        return type == ColumnarType::INT32 ? static_cast<const int32_t*>(values)[row]
+                                           : static_cast<const int64_t*>(values)[row];
+    }
+    double realAt(size_t row) const {
+        return type == ColumnarType::DOUBLE ? static_cast<const double*>(values)[row]
+                                            : static_cast<double>(intAt(row));
+    }
+    std::string_view stringAt(size_t row) const {
+        if (encoding == ColumnarEncoding::DICTIONARY) return dictionaryAt(codeAt(row));
+        return std::string_view(bytes + offsets[row], offsets[row + 1] - offsets[row]);
+    }
+
+    // Словарь строкового столбца: группировка по коду без сравнения строк
+    size_t dictionarySize() const { return dictionaryCount; }
+    std::string_view dictionaryAt(uint32_t code) const {
+        return std::string_view(bytes + offsets[code], offsets[code + 1] - offsets[code]);
+    }
+    uint32_t codeAt(size_t row) const {
+        const unsigned char* code = codes + row * codeWidth;
+        if (codeWidth == 1) return code[0];
+        if (codeWidth == 2) return code[0] | (code[1] << 8);
+        return code[0] | (code[1] << 8) | (code[2] << 16) | (static_cast<uint32_t>(code[3]) << 24);
+    }
+
+private:
+    friend class ColumnarReader;
+    const void* values = nullptr;
+    const uint32_t* offsets = nullptr;
+    const char* bytes = nullptr;
+    const unsigned char* codes = nullptr;
+    size_t dictionaryCount = 0;
+    uint32_t codeWidth = 0;
+};
+
+// Прочитанная группа: столбцы в порядке, запрошенном в scan
+struct ColumnarBatch {
+    size_t rowGroup = 0;
+    size_t firstRow = 0;
+    size_t rows = 0;
+    std::vector<ColumnarVector> columns;
+
+    const ColumnarVector& operator[](size_t column) const { return columns[column]; }
+};
+
+// Условие на числовой столбец: группы, чей [min, max] не пересекается
+// с [min, max] условия, не читаются. Строки внутри прочитанных групп
+// читатель не фильтрует.
+struct ColumnarRange {
+    std::string column;
+    double min;
+    double max;
+};
+
+struct ColumnarScanStats {
+    size_t rowGroupsRead = 0;
+    size_t rowGroupsSkipped = 0;
+    uint64_t bytesRead = 0;       // размер прочитанных участков
+};
+
+class ColumnarReader {
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    using BatchVisitor = std::function<bool(const ColumnarBatch& batch)>;
+
+    bool open(const std::string& filename);
+    const std::string& getError() const { return error; }
+
+    size_t columnCount() const { return header ? header->columnCount : 0; }
+    const ColumnarColumnInfo& column(size_t index) const { return columns[index]; }
+    size_t columnIndex(std::string_view name) const;
+    size_t rowCount() const { return header ? static_cast<size_t>(header->rowCount) : 0; }
+    size_t rowGroupCount() const { return header ? static_cast<size_t>(header->rowGroupCount) : 0; }
+    const ColumnarRowGroupInfo& rowGroup(size_t group) const { return groups[group]; }
+    const ColumnarChunkInfo& chunk(size_t group, size_t column) const {
+        return chunks[group * header->columnCount + column];
+    }
+
+    // Читает только столбцы projection (пустой - все) в группах, которые
+    // могут содержать строки с условиями ranges. visit вызывается на каждую
+    // группу; false из visit останавливает чтение. Участки проверяются
+    // по контрольной сумме перед первым обращением.
+    bool scan(const std::vector<std::string>& projection, const std::vector<ColumnarRange>& ranges,
+              const BatchVisitor& visit, ColumnarScanStats* stats = nullptr);
+
+private:
+    MappedFile file;
+    const ColumnarFileHeader* header = nullptr;
+    const ColumnarColumnInfo* columns = nullptr;
+    const ColumnarRowGroupInfo* groups = nullptr;
+    const ColumnarChunkInfo* chunks = nullptr;
+    std::vector<uint8_t> verified;        // участки с уже проверенной суммой
+    std::string error;
+
+    bool decode(size_t group, size_t column, ColumnarVector& target);
+    bool fail(const std::string& message);
+};
+
+#endif // COLUMNAR_FILE_H
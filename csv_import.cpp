@@ -0,0 +1,452 @@
+#include "csv_import.h"
+#include "mapped_file.h"
+#include "product_store.h"
+#include <string_view>
+#include <charconv>
+#include <thread>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cmath>
+#include <array>
+
+using namespace std;
+
+namespace {
+
+// Фрагменты меньше мегабайта не стоят отдельного потока, а больше 256 МБ
+// не делаются, чтобы смещения наименований фрагмента помещались в uint32
+const size_t MIN_CHUNK_SIZE = 1 << 20;
+const size_t MAX_CHUNK_SIZE = 256u << 20;
+
+struct CsvField {
+    string_view text;        // без внешних кавычек, удвоенные кавычки еще не раскрыты
+    bool quoted = false;
+    bool hasEscapes = false;
+};
+
+string_view trim(string_view value) {
+    while (!value.empty() && (value.front() == ' ' || value.front() == '\t')) value.remove_prefix(1);
+    while (!value.empty() && (value.back() == ' ' || value.back() == '\t' || value.back() == '\r')) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+template<typename T>
+bool parseNumber(string_view text, T& value) {
+    text = trim(text);
+    if (!text.empty() && text.front() == '+') text.remove_prefix(1);
+    if (text.empty()) return false;
+    auto [end, ec] = from_chars(text.data(), text.data() + text.size(), value);
+    return ec == errc() && end == text.data() + text.size();
+}
+
+string snippet(string_view text) {
+    const size_t limit = 40;
+    return "'" + string(text.substr(0, limit)) + (text.size() > limit ? "...'" : "'");
+}
+
+// Выполняет task(i) для i из [0, count) на пуле из threads потоков
+template<typename Task>
+void runParallel(size_t count, unsigned threads, const Task& task) {
+    atomic<size_t> next{0};
+    auto worker = [&] {
+        for (size_t i; (i = next++) < count;) task(i);
+    };
+    vector<thread> pool;
+    for (size_t t = 1; t < min<size_t>(threads, count); t++) pool.emplace_back(worker);
+    worker();
+    for (auto& th : pool) th.join();
+}
+
+// Разбор одного фрагмента файла
+class ChunkParser {
+private:
+    const char* p;
+    const char* end;
+    CsvCatalogChunk& chunk;
+    const char* lineEnd = nullptr;    // ближайший перевод строки после p (или end)
+    size_t line = 0;
+
+    void reject(size_t lineNumber, string message) {
+        chunk.rejectedRows++;
+        if (chunk.errors.size() < CsvImporter::MAX_REPORTED_ERRORS) {
+            chunk.errors.push_back({lineNumber, std::move(message)});
+        }
+    }
+
+    void skipLine() {
+        const char* newline = static_cast<const char*>(memchr(p, '\n', end - p));
+        p = newline ? newline : end;
+    }
+
+    // Читает поле и возвращает разделитель после него: ',', '\n' или 0 в конце фрагмента
+    char readField(CsvField& field, string& problem) {
+        field = CsvField();
+        if (p < end && *p == '"') {
+            field.quoted = true;
+            const char* start = ++p;
+            while (true) {
+                const char* quote = static_cast<const char*>(memchr(p, '"', end - p));
+                if (!quote) {
+                    problem = "не закрыта кавычка";
+                    line += count(start, end, '\n');
+                    p = end;
+                    return 0;
+                }
+                if (quote + 1 < end && quote[1] == '"') {
+                    field.hasEscapes = true;
+                    p = quote + 2;
+                    continue;
+                }
+                field.text = string_view(start, quote - start);
+                p = quote + 1;
+                break;
+            }
+            line += count(field.text.begin(), field.text.end(), '\n');
+            while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+            if (p < end && *p != ',' && *p != '\n') {
+                problem = "лишние символы после закрывающей кавычки";
+                skipLine();
+            }
+        } else {
+            // Поле без кавычек не выходит за конец строки
+            if (lineEnd < p) {
+                lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+                if (!lineEnd) lineEnd = end;
+            }
+            const char* comma = static_cast<const char*>(memchr(p, ',', lineEnd - p));
+            const char* start = p;
+            p = comma ? comma : lineEnd;
+            field.text = string_view(start, p - start);
+        }
+
+        if (p >= end) return 0;
+        char separator = *p++;
+        if (separator == '\n') line++;
+        return separator;
+    }
+
+    void appendName(const CsvField& field) {
+        if (!field.hasEscapes) {
+            chunk.names.append(field.text.data(), field.text.size());
+            return;
+        }
+        for (size_t i = 0; i < field.text.size(); i++) {
+            chunk.names += field.text[i];
+            if (field.text[i] == '"') i++;
+        }
+    }
+
+    void parseLine() {
+        size_t lineNumber = line;
+        CsvField fields[4];
+        size_t fieldCount = 0;
+        string problem;
+        char separator;
+        do {
+            CsvField field;
+            separator = readField(field, problem);
+            if (fieldCount < 4) fields[fieldCount] = field;
+            fieldCount++;
+        } while (separator == ',' && problem.empty());
+
+        // Пустые строки не считаются ошибкой
+        if (problem.empty() && fieldCount == 1 && !fields[0].quoted && trim(fields[0].text).empty()) {
+            return;
+        }
+        if (!problem.empty()) {
+            reject(lineNumber, problem);
+            return;
+        }
+        if (fieldCount < 4) {
+            reject(lineNumber, "ожидается 4 поля id,name,price,quantity, найдено " +
+                               to_string(fieldCount));
+            return;
+        }
+
+        int id;
+        double price;
+        int quantity;
+        if (!parseNumber(fields[0].text, id) || id <= 0) {
+            reject(lineNumber, "некорректный id " + snippet(fields[0].text));
+            return;
+        }
+        if (!parseNumber(fields[2].text, price) || !isfinite(price) || price < 0) {
+            reject(lineNumber, "некорректная цена " + snippet(fields[2].text));
+            return;
+        }
+        if (!parseNumber(fields[3].text, quantity) || quantity < 0) {
+            reject(lineNumber, "некорректное количество " + snippet(fields[3].text));
+            return;
+        }
+
+        chunk.ids.push_back(id);
+        chunk.prices.push_back(price);
+        chunk.quantities.push_back(quantity);
+        chunk.nameOffsets.push_back(static_cast<uint32_t>(chunk.names.size()));
+        appendName(fields[1]);
+        chunk.lines.push_back(static_cast<uint32_t>(lineNumber));
+    }
+
+public:
+    ChunkParser(const char* begin, const char* _end, CsvCatalogChunk& _chunk)
+        : p(begin), end(_end), chunk(_chunk) {}
+
+    void run() {
+        // Грубая оценка: строка каталога - около 40 байт
+        size_t expectedRows = static_cast<size_t>(end - p) / 40;
+        chunk.ids.reserve(expectedRows);
+        chunk.prices.reserve(expectedRows);
+        chunk.quantities.reserve(expectedRows);
+        chunk.nameOffsets.reserve(expectedRows + 1);
+        chunk.lines.reserve(expectedRows);
+
+        while (p < end) parseLine();
+        chunk.nameOffsets.push_back(static_cast<uint32_t>(chunk.names.size()));
+        chunk.lineCount = line;
+    }
+};
+
+// Состояние разбора в произвольном месте файла - по тем же правилам, что
+// у ChunkParser: кавычка открывает поле, только если стоит в его начале,
+// внутри поля без кавычек она обычный символ (Монитор 24" Dell)
+enum class ScanState : uint8_t {
+    FIELD_START,     // начало поля
+    UNQUOTED,        // поле без кавычек
+    QUOTED,          // поле в кавычках
+    QUOTE_SEEN,      // кавычка внутри поля в кавычках: закрывающая или первая из удвоенных
+    AFTER_CLOSE,     // пробелы после закрывающей кавычки
+    BAD_LINE         // лишние символы после закрывающей кавычки - до конца строки
+};
+const size_t SCAN_STATE_COUNT = 6;
+
+enum CharClass : uint8_t { CHAR_OTHER, CHAR_QUOTE, CHAR_COMMA, CHAR_NEWLINE, CHAR_SPACE };
+const size_t CHAR_CLASS_COUNT = 5;
+
+CharClass classify(char c) {
+    switch (c) {
+        case '"': return CHAR_QUOTE;
+        case ',': return CHAR_COMMA;
+        case '\n': return CHAR_NEWLINE;
+        case ' ': case '\t': case '\r': return CHAR_SPACE;
+        default: return CHAR_OTHER;
+    }
+}
+
+ScanState scanStep(ScanState state, CharClass c) {
+    bool separator = c == CHAR_COMMA || c == CHAR_NEWLINE;
+    switch (state) {
+        case ScanState::FIELD_START:
+            if (c == CHAR_QUOTE) return ScanState::QUOTED;
+            return separator ? ScanState::FIELD_START : ScanState::UNQUOTED;
+        case ScanState::UNQUOTED:
+            return separator ? ScanState::FIELD_START : ScanState::UNQUOTED;
+        case ScanState::QUOTED:
+            return c == CHAR_QUOTE ? ScanState::QUOTE_SEEN : ScanState::QUOTED;
+        case ScanState::QUOTE_SEEN:
+            if (c == CHAR_QUOTE) return ScanState::QUOTED;
+            if (separator) return ScanState::FIELD_START;
+            return c == CHAR_SPACE ? ScanState::AFTER_CLOSE : ScanState::BAD_LINE;
+        case ScanState::AFTER_CLOSE:
+            if (separator) return ScanState::FIELD_START;
+            return c == CHAR_SPACE ? ScanState::AFTER_CLOSE : ScanState::BAD_LINE;
+        case ScanState::BAD_LINE:
+            return c == CHAR_NEWLINE ? ScanState::FIELD_START : ScanState::BAD_LINE;
+    }
+    return state;
+}
+
+using ScanTransition = array<ScanState, SCAN_STATE_COUNT>;   // начальное состояние -> текущее
+
+// Автомат, который ведет все шесть путей разбора сразу: его состояние - набор
+// текущих состояний путей. Наборов, достижимых из начального, немного (после
+// первой строки обычно остаются два пути: "внутри кавычек" и "вне кавычек"),
+// поэтому автомат строится целиком один раз. Для каждого набора известны
+// символы, которые его меняют; остальные пропускаются без переходов.
+struct ScanAutomaton {
+    vector<ScanTransition> sets;
+    vector<array<uint32_t, CHAR_CLASS_COUNT>> next;
+    vector<array<bool, 256>> stops;
+    array<CharClass, 256> classes;
+
+    ScanAutomaton() {
+        for (size_t c = 0; c < classes.size(); c++) classes[c] = classify(static_cast<char>(c));
+
+        ScanTransition identity;
+        for (size_t s = 0; s < SCAN_STATE_COUNT; s++) identity[s] = static_cast<ScanState>(s);
+        sets.push_back(identity);
+        for (size_t i = 0; i < sets.size(); i++) {
+            array<uint32_t, CHAR_CLASS_COUNT> targets;
+            for (size_t c = 0; c < CHAR_CLASS_COUNT; c++) {
+                ScanTransition moved = sets[i];
+                for (auto& state : moved) state = scanStep(state, static_cast<CharClass>(c));
+                auto it = find(sets.begin(), sets.end(), moved);
+                targets[c] = static_cast<uint32_t>(it - sets.begin());
+                if (it == sets.end()) sets.push_back(moved);
+            }
+            next.push_back(targets);
+        }
+        stops.resize(sets.size());
+        for (size_t i = 0; i < sets.size(); i++) {
+            for (size_t c = 0; c < classes.size(); c++) stops[i][c] = next[i][classes[c]] != i;
+        }
+    }
+
+    static const ScanAutomaton& instance() {
+        static const ScanAutomaton automaton;
+        return automaton;
+    }
+
+    // Состояние в конце [begin, end) для каждого возможного состояния в начале
+    ScanTransition run(const char* begin, const char* end) const {
+        const unsigned char* p = reinterpret_cast<const unsigned char*>(begin);
+        const unsigned char* last = reinterpret_cast<const unsigned char*>(end);
+        uint32_t current = 0;
+        while (true) {
+            const array<bool, 256>& stop = stops[current];
+            while (p < last && !stop[*p]) p++;
+            if (p == last) break;
+            current = next[current][classes[*p++]];
+        }
+        return sets[current];
+    }
+};
+
+// Пропускает строку заголовка, если данные начинаются с prefix
+bool skipHeader(const char* data, size_t size, size_t& position, string_view prefix) {
+    if (size - position < prefix.size() || memcmp(data + position, prefix.data(), prefix.size()) != 0) {
+        return false;
+    }
+    const char* newline = static_cast<const char*>(memchr(data + position, '\n', size - position));
+    position = newline ? static_cast<size_t>(newline - data) + 1 : size;
+    return true;
+}
+
+} // namespace
+
+bool CsvImporter::parse(const string& filename, unsigned threads) {
+    chunks.clear();
+    firstLines.clear();
+    error.clear();
+
+    MappedFile file;
+    if (!file.open(filename)) {
+        error = "Не удалось открыть файл " + filename;
+        return false;
+    }
+    const char* data = file.data();
+    size_t size = file.size();
+
+    size_t start = 0;
+    size_t headerLines = 0;
+    if (size >= 3 && memcmp(data, "\xEF\xBB\xBF", 3) == 0) start = 3;
+    if (skipHeader(data, size, start, "[PRODUCTS]")) headerLines++;
+    if (skipHeader(data, size, start, "id,")) headerLines++;
+
+    if (threads == 0) threads = max(1u, thread::hardware_concurrency());
+    size_t dataSize = size - start;
+    size_t chunkCount = max<size_t>(1, min<size_t>(threads, dataSize / MIN_CHUNK_SIZE));
+    chunkCount = max(chunkCount, (dataSize + MAX_CHUNK_SIZE - 1) / MAX_CHUNK_SIZE);
+
+    vector<size_t> bounds(chunkCount + 1);
+    for (size_t i = 0; i <= chunkCount; i++) {
+        bounds[i] = start + dataSize / chunkCount * i;
+    }
+    bounds[chunkCount] = size;
+
+    // Первый проход: для каждого фрагмента - в каком состоянии разбора он
+    // заканчивается при любом состоянии в начале. Цепочка переходов слева
+    // дает точное состояние на каждой границе. Простой подсчет четности
+    // кавычек здесь не годится: одиночная кавычка внутри поля без кавычек
+    // сдвинула бы четность для всех следующих границ.
+    vector<ScanTransition> transitions(chunkCount);
+    runParallel(chunkCount - 1, threads, [&](size_t i) {
+        transitions[i] = ScanAutomaton::instance().run(data + bounds[i], data + bounds[i + 1]);
+    });
+
+    // Сдвигаем границы к ближайшему переводу строки вне кавычек
+    vector<size_t> starts(chunkCount + 1);
+    starts[0] = start;
+    starts[chunkCount] = size;
+    ScanState boundState = ScanState::FIELD_START;
+    for (size_t i = 1; i < chunkCount; i++) {
+        boundState = transitions[i - 1][static_cast<size_t>(boundState)];
+        ScanState state = boundState;
+        size_t position = bounds[i];
+        while (position < size) {
+            CharClass c = classify(data[position++]);
+            bool recordEnd = c == CHAR_NEWLINE && state != ScanState::QUOTED;
+            state = scanStep(state, c);
+            if (recordEnd) break;
+        }
+        starts[i] = max(position, starts[i - 1]);
+    }
+
+    // Второй проход: разбор фрагментов
+    chunks.resize(chunkCount);
+    runParallel(chunkCount, threads, [&](size_t i) {
+        ChunkParser(data + starts[i], data + starts[i + 1], chunks[i]).run();
+    });
+
+    // Номера строк фрагментов становятся известны только после разбора
+    firstLines.resize(chunkCount);
+    size_t line = headerLines + 1;
+    for (size_t i = 0; i < chunkCount; i++) {
+        firstLines[i] = line;
+        for (auto& lineError : chunks[i].errors) lineError.line += line;
+        line += chunks[i].lineCount;
+    }
+    return true;
+}
+
+size_t CsvImporter::rowCount() const {
+    size_t rows = 0;
+    for (const auto& chunk : chunks) rows += chunk.ids.size();
+    return rows;
+}
+
+CsvImportResult CsvImporter::storeTo(ProductStore& products) {
+    CsvImportResult result;
+    size_t nameBytes = 0;
+    for (const auto& chunk : chunks) nameBytes += chunk.names.size();
+
+    products.clear();
+    products.reserve(rowCount(), nameBytes);
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        CsvCatalogChunk& chunk = chunks[i];
+        for (size_t row = 0; row < chunk.ids.size(); row++) {
+            int id = chunk.ids[row];
+            uint32_t offset = chunk.nameOffsets[row];
+            size_t slot = products.appendUnique(id, string_view(chunk.names.data() + offset,
+                                                                chunk.nameOffsets[row + 1] - offset),
+                                                chunk.prices[row], chunk.quantities[row]);
+            if (slot == ProductStore::npos) {
+                result.rejectedRows++;
+                if (result.errors.size() < MAX_REPORTED_ERRORS) {
+                    result.errors.push_back({firstLines[i] + chunk.lines[row],
+                                             "повторный id " + to_string(id)});
+                }
+                continue;
+            }
+            result.maxProductId = max(result.maxProductId, id);
+            result.importedRows++;
+        }
+
+        result.rejectedRows += chunk.rejectedRows;
+        result.errors.insert(result.errors.end(), make_move_iterator(chunk.errors.begin()),
+                             make_move_iterator(chunk.errors.end()));
+        chunk = CsvCatalogChunk();
+    }
+
+    sort(result.errors.begin(), result.errors.end(),
+         [](const CsvImportError& a, const CsvImportError& b) { return a.line < b.line; });
+    if (result.errors.size() > MAX_REPORTED_ERRORS) result.errors.resize(MAX_REPORTED_ERRORS);
+
+    chunks.clear();
+    firstLines.clear();
+    result.success = true;
+    return result;
+}
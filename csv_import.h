@@ -0,0 +1,66 @@
+#ifndef CSV_IMPORT_H
+#define CSV_IMPORT_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+class ProductStore;
+
+// Ошибка в отдельной строке файла; строка пропускается, импорт продолжается
+struct CsvImportError {
+    size_t line;          // номер строки в файле, начиная с 1
+    std::string message;
+};
+
+struct CsvImportResult {
+    bool success = false;
+    std::string error;                    // ошибка уровня файла (не открылся и т.п.)
+    size_t importedRows = 0;
+    size_t rejectedRows = 0;
+    std::vector<CsvImportError> errors;   // первые MAX_REPORTED_ERRORS ошибок по строкам
+    int maxProductId = 0;
+};
+
+// Разобранный фрагмент файла: колонки в том виде, в каком их принимает ProductStore
+struct CsvCatalogChunk {
+    std::vector<int> ids;
+    std::vector<int> quantities;
+    std::vector<double> prices;
+    std::vector<uint32_t> nameOffsets;    // rows + 1 смещений в names
+    std::string names;
+    std::vector<uint32_t> lines;          // номер строки внутри фрагмента для каждой записи
+    std::vector<CsvImportError> errors;   // номера строк внутри фрагмента
+    size_t rejectedRows = 0;
+    size_t lineCount = 0;                 // переводов строки во фрагменте
+};
+
+// Массовый импорт каталога в формате id,name,price,quantity.
+//
+// Файл отображается в память и делится на фрагменты по границам строк
+// (перевод строки внутри кавычек границей не считается). Фрагменты
+// разбираются параллельно: поля - string_view поверх файла, числа -
+// std::from_chars, без промежуточных строк. Необязательные заголовки
+// "[PRODUCTS]" и "id,name,price,quantity" в начале файла пропускаются.
+class CsvImporter {
+public:
+    static constexpr size_t MAX_REPORTED_ERRORS = 1000;
+
+    // threads = 0 - по числу ядер
+    bool parse(const std::string& filename, unsigned threads = 0);
+
+    // Заменяет содержимое products разобранными строками. Повторные id
+    // отклоняются с ошибкой по строке.
+    CsvImportResult storeTo(ProductStore& products);
+
+    size_t rowCount() const;
+    const std::string& getError() const { return error; }
+
+private:
+    std::vector<CsvCatalogChunk> chunks;
+    std::vector<size_t> firstLines;       // номер первой строки каждого фрагмента
+    std::string error;
+};
+
+#endif // CSV_IMPORT_H
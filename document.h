@@ -2,60 +2,247 @@
 #define DOCUMENT_H
 
 #include "product.h"
+#include "document_line.h"
 #include "document_type.h"  // Включаем отдельный файл с enum
+#include "document_schema.h"
+#include "document_status.h"
+#include "document_pool.h"
+#include <array>
 #include <vector>
 #include <memory>
+#include <atomic>
+#include <mutex>
 #include <string>
+#include <string_view>
 #include <ctime>
-#include <map>
 #include <iostream>
 #include <fstream>
 #include <iomanip>
+#include <cstdint>
+#include <cstdio>
 
-struct DocumentItem {
-    std::shared_ptr<Product> product;
-    int quantity;
-    std::string comment;
+// Строки документа без копирования. Действительно, пока документ жив
+// и в него не добавляются строки (addLine может перенести их в памяти).
+// Комментарии строк хранит документ, поэтому читаются через commentOf.
+class DocumentItemView {
+private:
+    const DocumentLine* first = nullptr;
+    size_t count = 0;
+    const std::vector<std::string>* comments = nullptr;
+
+public:
+    using const_iterator = const DocumentLine*;
+
+    DocumentItemView() = default;
+    DocumentItemView(const DocumentLine* _first, size_t _count) : first(_first), count(_count) {}
+    DocumentItemView(const std::vector<DocumentLine>& lines) : first(lines.data()), count(lines.size()) {}
+    DocumentItemView(const std::vector<DocumentLine>& lines, const std::vector<std::string>& _comments)
+        : first(lines.data()), count(lines.size()), comments(&_comments) {}
+
+    const_iterator begin() const { return first; }
+    const_iterator end() const { return first + count; }
+    size_t size() const { return count; }
+    bool empty() const { return count == 0; }
+    const DocumentLine& operator[](size_t index) const { return first[index]; }
+
+    std::string_view commentOf(const DocumentLine& line) const {
+        if (line.comment == DocumentLine::NO_COMMENT || !comments) return std::string_view();
+        return (*comments)[line.comment - 1];
+    }
+};
+
+// Дата документа в печатной форме: ДД.ММ.ГГГГ ЧЧ:ММ:СС.
+// localtime вызывается один раз на час: при выгрузке тысяч документов
+// за день остальные даты собираются из запомненного префикса.
+inline void appendDocumentDate(std::string& out, time_t date) {
+    thread_local time_t cachedHour = -1;
+    thread_local char cachedPrefix[32];
     
-    DocumentItem(std::shared_ptr<Product> _product, int _quantity = 1, 
-                std::string _comment = "")
-        : product(_product), quantity(_quantity), comment(_comment) {}
+    if (cachedHour < 0 || date < cachedHour || date >= cachedHour + 3600) {
+        std::tm* tm_info = std::localtime(&date);
+        std::strftime(cachedPrefix, sizeof(cachedPrefix), "%d.%m.%Y %H:", tm_info);
+        cachedHour = date - (tm_info->tm_min * 60 + tm_info->tm_sec);
+    }
+    int seconds = static_cast<int>(date - cachedHour);
+    char buffer[48];
+    int length = std::snprintf(buffer, sizeof(buffer), "%s%02d:%02d", cachedPrefix,
+                               seconds / 60, seconds % 60);
+    out.append(buffer, length);
+}
+
+// Число в печатной форме - как его выводит поток по умолчанию (%g)
+inline void appendDocumentNumber(std::string& out, double value) {
+    char buffer[32];
+    int length = std::snprintf(buffer, sizeof(buffer), "%g", value);
+    out.append(buffer, length);
+}
+
+// Источник строк и специфичных полей документа, которые загружаются
+// при первом обращении (например, из отображенного в память снимка)
+class DocumentContentSource {
+public:
+    virtual ~DocumentContentSource() = default;
+    // Комментарии строк добавляются в comments; DocumentLine::comment - номер в нем с 1
+    virtual void load(uint32_t index, std::vector<DocumentLine>& lines,
+                      std::vector<std::string>& comments, DocumentFieldSlots fields) const = 0;
 };
 
-// Базовый класс для всех документов
+// Строки и поля документа на момент DocumentBase::shareContent(). Последующие
+// правки документа их не меняют, поэтому их можно читать из другого потока
+// (фоновая запись снимка), пока жив owner.
+struct DocumentContentShare {
+    std::shared_ptr<const void> owner;
+    DocumentItemView items;
+    DocumentFieldsView fields;
+};
+
+// Базовый класс для всех документов: интерфейс для кода, которому
+// тип документа неизвестен (окно, снимки, сегменты, журнал)
 class DocumentBase {
 public:
     virtual ~DocumentBase() = default;
     
-    virtual void addItem(std::shared_ptr<Product> product, int quantity = 1, 
-                        std::string comment = "") = 0;
-    virtual void setSpecificField(const std::string& fieldName, 
-                                 const std::string& value) = 0;
+    // Строка с наименованием и ценой товара на момент добавления
+    virtual void addLine(int productId, std::string_view productName, double price,
+                         int quantity, std::string_view comment = std::string_view()) = 0;
+    void addItem(const std::shared_ptr<const Product>& product, int quantity = 1,
+                 std::string_view comment = std::string_view()) {
+        addLine(product->getId(), product->getName(), product->getPrice(), quantity, comment);
+    }
+    // Поля по номеру в схеме типа (см. DocumentSchema)
+    virtual const std::string& getField(size_t slot) const = 0;
+    virtual void setField(size_t slot, std::string_view value) = 0;
+    // false - у типа документа нет такого поля
+    bool setSpecificField(std::string_view fieldName, std::string_view value) {
+        size_t slot = getSchema().find(fieldName);
+        if (slot == DocumentSchemaRef::npos) return false;
+        setField(slot, value);
+        return true;
+    }
     virtual void process() = 0;
     virtual void print() const = 0;
     virtual void saveToFile(const std::string& filename = "") const = 0;
+    // Печатная форма документа (та же, что пишет saveToFile)
+    virtual void renderText(std::string& out) const = 0;
     virtual std::string getTypeName() const = 0;
     virtual int getId() const = 0;
-    virtual std::string getNumber() const = 0;
-    virtual std::string getStatus() const = 0;
-    virtual std::string getComment() const = 0;
+    virtual const std::string& getNumber() const = 0;
+    virtual DocumentStatus getStatus() const = 0;
+    std::string_view getStatusLabel() const { return documentStatusLabel(getType(), getStatus()); }
+    virtual const std::string& getComment() const = 0;
+    virtual const std::string& getCreatedBy() const = 0;
+    virtual const std::string& getDepartment() const = 0;
     virtual time_t getDate() const = 0;
     virtual DocumentType getType() const = 0;
-    virtual std::vector<DocumentItem> getItems() const = 0;
+    // Строки документа для чтения (без копирования, см. DocumentItemView)
+    virtual DocumentItemView getItemView() const = 0;
+    // Копия строк - когда они нужны дольше, чем живет представление
+    // (без комментариев: они остаются в документе)
+    std::vector<DocumentLine> getItems() const {
+        DocumentItemView view = getItemView();
+        return std::vector<DocumentLine>(view.begin(), view.end());
+    }
+    DocumentSchemaRef getSchema() const { return documentSchema(getType()); }
+    virtual DocumentFieldsView getSpecificFields() const = 0;
+    
+    // Отложенная загрузка содержимого: source->load(index, ...) вызывается
+    // при первом обращении к строкам или полям документа
+    virtual void setContentSource(std::shared_ptr<const DocumentContentSource> source,
+                                  uint32_t index) = 0;
+    // Источник еще не загруженного содержимого или nullptr
+    virtual const DocumentContentSource* getContentSource(uint32_t& index) const = 0;
+    // Содержимое без копирования (загружается, если еще не загружено);
+    // вызывается под той же блокировкой, что и правки документа
+    virtual DocumentContentShare shareContent() const = 0;
+
+private:
+    // Статус без проверки перехода. Переходы выполняет только
+    // DocumentRegistry::transition (он же обновляет индексы), сохраненный
+    // статус ставит restoreDocument.
+    virtual void setStatus(DocumentStatus newStatus) = 0;
+
+    friend class DocumentRegistry;
+    template<DocumentType Type>
+    friend std::shared_ptr<DocumentBase> restoreDocument(int id, const std::string& number,
+                                                         const std::string& createdBy,
+                                                         const std::string& department,
+                                                         const std::string& comment,
+                                                         time_t date, DocumentStatus status);
 };
 
+// Единственная реализация DocumentBase. Класс final: там, где тип документа
+// известен при компиляции (DocumentRegistry::forEach), вызовы его методов
+// не виртуальные.
 template<DocumentType Type>
-class DocumentTemplate : public DocumentBase {
-protected:
+class DocumentTemplate final : public DocumentBase {
+private:
+    // Поля, которые читают массовые обходы (дата, статус, строки), - в начале
+    // объекта: обход документа затрагивает одну-две строки кэша
+    // Строки документа лежат одним непрерывным массивом (24 байта на строку),
+    // наименования - в общем DocumentStringPool, комментарии - в lineComments.
+    // Содержимое копируется при записи, как колонки товаров (см. SharedColumn):
+    // shareContent() отдает его без копирования, а правка, пока розданную
+    // копию кто-то читает, сначала копирует его. Счетчик копий - в самом
+    // содержимом: после такого копирования прежний счетчик уже не нужен.
+    struct Content {
+        std::vector<DocumentLine> items;
+        std::vector<std::string> lineComments;
+        // Значения специфичных полей в порядке DocumentSchema<Type>
+        std::array<std::string, documentFieldCount<Type>> specificFields;
+        mutable std::atomic<int> readers{0};
+        
+        Content() {
+            for (size_t slot = 0; slot < specificFields.size(); slot++) {
+                specificFields[slot] = DocumentSchema<Type>::fields[slot].defaultValue;
+            }
+        }
+        Content(const Content& other)
+            : items(other.items), lineComments(other.lineComments),
+              specificFields(other.specificFields) {}
+    };
+    
     int id;
-    std::string number;
+    DocumentStatus status = DocumentStatus::DRAFT;
+    // Содержимое создается при первом обращении и может подгружаться лениво
+    // из contentSource, в том числе из const-методов и из других потоков
+    // (фоновая запись, выгрузка): загрузка выполняется один раз под
+    // contentOnce, после нее contentLoaded = true. Сам contentSource после
+    // setContentSource не меняется.
+    mutable std::atomic<bool> contentLoaded{false};
+    mutable std::once_flag contentOnce;
+    uint32_t contentIndex = 0;
     time_t date;
+    mutable std::shared_ptr<Content> content;
+    std::shared_ptr<const DocumentContentSource> contentSource;
+    
+    std::string number;
     std::string createdBy;
     std::string department;
-    std::vector<DocumentItem> items;
-    std::string status;
     std::string comment;
-    std::map<std::string, std::string> specificFields;
+    
+    const Content& readContent() const {
+        if (!contentLoaded.load(std::memory_order_acquire)) {
+            std::call_once(contentOnce, [this] {
+                auto loaded = std::make_shared<Content>();
+                if (contentSource) {
+                    contentSource->load(contentIndex, loaded->items, loaded->lineComments,
+                                        DocumentFieldSlots(DocumentSchema<Type>::fields,
+                                                           loaded->specificFields.data()));
+                }
+                content = std::move(loaded);
+                contentLoaded.store(true, std::memory_order_release);
+            });
+        }
+        return *content;
+    }
+    
+    Content& editContent() {
+        readContent();
+        if (content->readers.load(std::memory_order_acquire) > 0) {
+            content = std::make_shared<Content>(*content);
+        }
+        return *content;
+    }
 
 public:
     DocumentTemplate(int _id, std::string _number, std::string _createdBy, 
@@ -63,70 +250,31 @@ public:
         : id(_id), number(_number), createdBy(_createdBy),
           department(_department), comment(_comment) {
         date = time(nullptr);
-        status = "Черновик";
-        initializeSpecificFields();
     }
 
-    void initializeSpecificFields() {
-        switch(Type) {
-            case DocumentType::RECEIPT:
-                specificFields = {
-                    {"Сотрудник", ""},
-                    {"Смена", ""},
-                    {"Номер заказа", ""},
-                    {"Тип оплаты", "Наличные"}
-                };
-                break;
-                
-            case DocumentType::INCOME_INVOICE:
-                specificFields = {
-                    {"Поставщик", ""},
-                    {"Договор", ""},
-                    {"Счет-фактура", ""},
-                    {"Склад приемки", "Основной"}
-                };
-                break;
-                
-            case DocumentType::OUTCOME_INVOICE:
-                specificFields = {
-                    {"Получатель", ""},
-                    {"Основание", ""},
-                    {"Склад отгрузки", "Основной"},
-                    {"Транспорт", ""}
-                };
-                break;
-                
-            case DocumentType::INVENTORY:
-                specificFields = {
-                    {"Комиссия", ""},
-                    {"Склад", "Основной"},
-                    {"Причина", "Плановая инвентаризация"},
-                    {"Результат", "Не проведена"}
-                };
-                break;
+    void addLine(int productId, std::string_view productName, double price,
+                 int quantity, std::string_view comment = std::string_view()) override {
+        Content& edited = editContent();
+        uint32_t commentIndex = DocumentLine::NO_COMMENT;
+        if (!comment.empty()) {
+            edited.lineComments.emplace_back(comment);
+            commentIndex = static_cast<uint32_t>(edited.lineComments.size());
         }
+        edited.items.push_back(DocumentLine{productId, quantity, price,
+                                     DocumentStringPool::instance().intern(productName),
+                                     commentIndex});
     }
 
-    void addItem(std::shared_ptr<Product> product, int quantity = 1, 
-                std::string comment = "") override {
-        items.push_back(DocumentItem(product, quantity, comment));
+    const std::string& getField(size_t slot) const override {
+        return readContent().specificFields[slot];
     }
 
-    void setSpecificField(const std::string& fieldName, 
-                         const std::string& value) override {
-        if (specificFields.find(fieldName) != specificFields.end()) {
-            specificFields[fieldName] = value;
-        }
+    void setField(size_t slot, std::string_view value) override {
+        editContent().specificFields[slot].assign(value.data(), value.size());
     }
 
     std::string getTypeName() const override {
-        switch(Type) {
-            case DocumentType::RECEIPT: return "ЧЕК";
-            case DocumentType::INCOME_INVOICE: return "НАКЛАДНАЯ ПРИХОДА";
-            case DocumentType::OUTCOME_INVOICE: return "НАКЛАДНАЯ РАСХОДА";
-            case DocumentType::INVENTORY: return "АКТ ИНВЕНТАРИЗАЦИИ";
-            default: return "ДОКУМЕНТ";
-        }
+        return std::string(documentTypeName(Type));
     }
 
     DocumentType getType() const override {
@@ -134,6 +282,7 @@ public:
     }
 
     void print() const override {
+        const Content& current = readContent();
         std::cout << "=== " << getTypeName() << " ===" << std::endl;
         std::cout << "Номер: " << number << std::endl;
         
@@ -145,19 +294,19 @@ public:
         
         std::cout << "Создал: " << createdBy << std::endl;
         std::cout << "Подразделение: " << department << std::endl;
-        std::cout << "Статус: " << status << std::endl;
+        std::cout << "Статус: " << getStatusLabel() << std::endl;
         
         std::cout << "\nСпецифичные поля:" << std::endl;
-        for (const auto& field : specificFields) {
-            std::cout << "  " << field.first << ": " << field.second << std::endl;
+        for (const auto& [name, value] : getSpecificFields()) {
+            std::cout << "  " << name << ": " << value << std::endl;
         }
         
         std::cout << "\nПозиции:" << std::endl;
         std::cout << "----------------------------------------" << std::endl;
-        for (const auto& item : items) {
-            std::cout << item.product->getName() << " × " << item.quantity;
-            if (!item.comment.empty()) {
-                std::cout << " (" << item.comment << ")";
+        for (const auto& item : current.items) {
+            std::cout << item.productName() << " × " << item.quantity;
+            if (item.comment != DocumentLine::NO_COMMENT) {
+                std::cout << " (" << current.lineComments[item.comment - 1] << ")";
             }
             std::cout << std::endl;
         }
@@ -179,80 +328,167 @@ public:
             return;
         }
         
-        // Сохраняем информацию в файл
-        file << "=== " << getTypeName() << " ===" << std::endl;
-        file << "Номер: " << number << std::endl;
-        
-        char dateBuffer[80];
-        std::tm* tm_info = std::localtime(&date);
-        std::strftime(dateBuffer, sizeof(dateBuffer), "%d.%m.%Y %H:%M:%S", tm_info);
-        file << "Дата: " << dateBuffer << std::endl;
-        
-        file << "Создал: " << createdBy << std::endl;
-        file << "Подразделение: " << department << std::endl;
-        file << "Статус: " << status << std::endl;
+        // Документ собирается в памяти и пишется одним вызовом
+        std::string text;
+        renderText(text);
+        file.write(text.data(), static_cast<std::streamsize>(text.size()));
+        file.close();
+        std::cout << "Документ сохранен в файл: " << actualFilename << std::endl;
+    }
+
+    void renderText(std::string& out) const override {
+        const Content& current = readContent();
+        out += "=== ";
+        out += getTypeName();
+        out += " ===\n";
+        out.append("Номер: ").append(number).append("\n");
+        out += "Дата: ";
+        appendDocumentDate(out, date);
+        out += "\n";
+        out.append("Создал: ").append(createdBy).append("\n");
+        out.append("Подразделение: ").append(department).append("\n");
+        out.append("Статус: ").append(getStatusLabel()).append("\n");
         
         if (!comment.empty()) {
-            file << "Комментарий: " << comment << std::endl;
+            out.append("Комментарий: ").append(comment).append("\n");
         }
         
-        file << "\nСпецифичные поля:" << std::endl;
-        for (const auto& field : specificFields) {
-            file << "  " << field.first << ": " << field.second << std::endl;
+        out += "\nСпецифичные поля:\n";
+        for (const auto& [name, value] : getSpecificFields()) {
+            out.append("  ").append(name).append(": ").append(value).append("\n");
         }
         
-        file << "\nПозиции:" << std::endl;
-        file << "----------------------------------------" << std::endl;
+        out += "\nПозиции:\n";
+        out += "----------------------------------------\n";
         double total = 0.0;
-        for (const auto& item : items) {
-            double itemTotal = item.product->getPrice() * item.quantity;
+        for (const auto& item : current.items) {
+            double itemTotal = item.total();
             total += itemTotal;
-            file << item.product->getName() << " × " << item.quantity;
-            file << " | Цена: " << item.product->getPrice() << " руб.";
-            file << " | Сумма: " << itemTotal << " руб.";
-            if (!item.comment.empty()) {
-                file << " (" << item.comment << ")";
+            out += item.productName();
+            out.append(" × ").append(std::to_string(item.quantity));
+            out += " | Цена: ";
+            appendDocumentNumber(out, item.price);
+            out += " руб. | Сумма: ";
+            appendDocumentNumber(out, itemTotal);
+            out += " руб.";
+            if (item.comment != DocumentLine::NO_COMMENT) {
+                out.append(" (").append(current.lineComments[item.comment - 1]).append(")");
             }
-            file << std::endl;
+            out += "\n";
         }
-        file << "----------------------------------------" << std::endl;
-        file << "ИТОГО: " << total << " руб." << std::endl;
-        
-        file.close();
-        std::cout << "Документ сохранен в файл: " << actualFilename << std::endl;
+        out += "----------------------------------------\n";
+        out += "ИТОГО: ";
+        appendDocumentNumber(out, total);
+        out += " руб.\n";
     }
 
+    // Сообщение о проведении; статус меняет Warehouse::postDocument
     void process() override {
         std::cout << "Обработка " << getTypeName() << " №" << number << std::endl;
         
         switch(Type) {
             case DocumentType::RECEIPT:
-                status = "Продано";
                 std::cout << "Чек проведен через кассу" << std::endl;
                 break;
             case DocumentType::INCOME_INVOICE:
-                status = "Принято";
                 std::cout << "Товары приняты на склад" << std::endl;
                 break;
             case DocumentType::OUTCOME_INVOICE:
-                status = "Отгружено";
                 std::cout << "Товары отгружены со склада" << std::endl;
                 break;
             case DocumentType::INVENTORY:
-                status = "Проведена";
                 std::cout << "Инвентаризация завершена" << std::endl;
                 break;
         }
     }
 
     int getId() const override { return id; }
-    std::string getNumber() const override { return number; }
-    std::string getStatus() const override { return status; }
-    std::string getComment() const override { return comment; }
+    const std::string& getNumber() const override { return number; }
+    DocumentStatus getStatus() const override { return status; }
+    const std::string& getComment() const override { return comment; }
+    const std::string& getCreatedBy() const override { return createdBy; }
+    const std::string& getDepartment() const override { return department; }
     time_t getDate() const override { return date; }
-    std::vector<DocumentItem> getItems() const override { return items; }
+    DocumentItemView getItemView() const override {
+        const Content& current = readContent();
+        return DocumentItemView(current.items, current.lineComments);
+    }
+    DocumentFieldsView getSpecificFields() const override {
+        return DocumentFieldsView(DocumentSchema<Type>::fields, readContent().specificFields.data());
+    }
     
-    void setStatus(const std::string& newStatus) { status = newStatus; }
+    // Вызывается до того, как документ станет доступен другим потокам
+    void setContentSource(std::shared_ptr<const DocumentContentSource> source,
+                          uint32_t index) override {
+        contentSource = std::move(source);
+        contentIndex = index;
+    }
+    const DocumentContentSource* getContentSource(uint32_t& index) const override {
+        if (contentLoaded.load(std::memory_order_acquire)) return nullptr;
+        index = contentIndex;
+        return contentSource.get();
+    }
+    DocumentContentShare shareContent() const override {
+        const Content& current = readContent();
+        current.readers.fetch_add(1, std::memory_order_relaxed);
+        std::shared_ptr<const Content> shared(&current, [owner = content](const Content*) {
+            owner->readers.fetch_sub(1, std::memory_order_release);
+        });
+        return DocumentContentShare{std::move(shared),
+                                    DocumentItemView(current.items, current.lineComments),
+                                    DocumentFieldsView(DocumentSchema<Type>::fields,
+                                                       current.specificFields.data())};
+    }
+    
+    void setDate(time_t newDate) { date = newDate; }
+
+private:
+    void setStatus(DocumentStatus newStatus) override { status = newStatus; }
 };
 
+// Новый документ типа Type; документы одного типа лежат в памяти подряд
+// (см. DocumentSlab)
+template<DocumentType Type, typename... Args>
+std::shared_ptr<DocumentTemplate<Type>> makeDocument(Args&&... args) {
+    return std::allocate_shared<DocumentTemplate<Type>>(DocumentAllocator<DocumentTemplate<Type>>(),
+                                                        std::forward<Args>(args)...);
+}
+
+// Восстанавливает документ с сохраненными датой и статусом
+template<DocumentType Type>
+std::shared_ptr<DocumentBase> restoreDocument(int id, const std::string& number,
+                                              const std::string& createdBy,
+                                              const std::string& department,
+                                              const std::string& comment,
+                                              time_t date, DocumentStatus status) {
+    auto doc = makeDocument<Type>(id, number, createdBy, department, comment);
+    doc->setDate(date);
+    std::shared_ptr<DocumentBase> base = std::move(doc);
+    base->setStatus(status);
+    return base;
+}
+
+inline std::shared_ptr<DocumentBase> restoreDocument(DocumentType type, int id,
+                                                     const std::string& number,
+                                                     const std::string& createdBy,
+                                                     const std::string& department,
+                                                     const std::string& comment,
+                                                     time_t date, DocumentStatus status) {
+    switch(type) {
+        case DocumentType::RECEIPT:
+            return restoreDocument<DocumentType::RECEIPT>(
+                id, number, createdBy, department, comment, date, status);
+        case DocumentType::INCOME_INVOICE:
+            return restoreDocument<DocumentType::INCOME_INVOICE>(
+                id, number, createdBy, department, comment, date, status);
+        case DocumentType::OUTCOME_INVOICE:
+            return restoreDocument<DocumentType::OUTCOME_INVOICE>(
+                id, number, createdBy, department, comment, date, status);
+        case DocumentType::INVENTORY:
+            return restoreDocument<DocumentType::INVENTORY>(
+                id, number, createdBy, department, comment, date, status);
+    }
+    return nullptr;
+}
+
 #endif // DOCUMENT_H
\ No newline at end of file
@@ -0,0 +1,165 @@
+#include "document_archive.h"
+#include "document.h"
+#include <filesystem>
+#include <algorithm>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+DocumentArchiveWriter::DocumentArchiveWriter(const string& _directory, const string& _prefix,
+                                             uint64_t _segmentBytes)
+    : directory(_directory), prefix(_prefix), segmentBytes(_segmentBytes), buffer(1 << 20) {}
+
+DocumentArchiveWriter::~DocumentArchiveWriter() {
+    finish();
+}
+
+bool DocumentArchiveWriter::fail(const string& message) {
+    if (error.empty()) error = message;
+    if (file) {
+        fclose(file);
+        file = nullptr;
+        remove(tempFilename.c_str());
+    }
+    return false;
+}
+
+bool DocumentArchiveWriter::openSegment() {
+    char suffix[16];
+    snprintf(suffix, sizeof(suffix), "-%05zu.arc", files.size() + 1);
+    string filename = (filesystem::path(directory) / (prefix + suffix)).string();
+    tempFilename = filename + ".tmp";
+
+    error_code ignored;
+    filesystem::create_directories(directory, ignored);
+    file = fopen(tempFilename.c_str(), "wb");
+    if (!file) return fail("Не удалось создать файл " + tempFilename);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    // Заголовок перезаписывается при закрытии сегмента
+    ArchiveSegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    if (fwrite(&header, 1, sizeof(header), file) != sizeof(header)) {
+        return fail("Ошибка записи в " + tempFilename);
+    }
+    position = sizeof(header);
+    index.clear();
+    files.push_back(filename);
+    return true;
+}
+
+bool DocumentArchiveWriter::closeSegment() {
+    if (!file) return true;
+
+    // Индекс выравнивается по 8 байт и сортируется по id для двоичного поиска
+    static const char zeros[8] = {0};
+    size_t padding = static_cast<size_t>((8 - position % 8) % 8);
+    sort(index.begin(), index.end(), [](const ArchiveIndexEntry& a, const ArchiveIndexEntry& b) {
+        return a.documentId < b.documentId;
+    });
+
+    ArchiveSegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, ARCHIVE_MAGIC, sizeof(header.magic));
+    header.version = ARCHIVE_VERSION;
+    header.headerSize = sizeof(ArchiveSegmentHeader);
+    header.documentCount = index.size();
+    header.indexOffset = position + padding;
+    header.fileSize = header.indexOffset + index.size() * sizeof(ArchiveIndexEntry);
+
+    size_t indexBytes = index.size() * sizeof(ArchiveIndexEntry);
+    bool ok = fwrite(zeros, 1, padding, file) == padding &&
+              fwrite(index.data(), 1, indexBytes, file) == indexBytes &&
+              fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+              fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = fclose(file) == 0 && ok;
+    file = nullptr;
+    if (!ok) {
+        remove(tempFilename.c_str());
+        return fail("Ошибка записи в " + tempFilename);
+    }
+
+    const string& filename = files.back();
+#ifdef _WIN32
+    remove(filename.c_str());
+#endif
+    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        return fail("Не удалось переименовать " + tempFilename);
+    }
+    return true;
+}
+
+bool DocumentArchiveWriter::add(const DocumentBase& doc) {
+    if (!error.empty()) return false;
+    if (file && position >= segmentBytes && !closeSegment()) return false;
+    if (!file && !openSegment()) return false;
+
+    text.clear();
+    doc.renderText(text);
+    if (fwrite(text.data(), 1, text.size(), file) != text.size()) {
+        return fail("Ошибка записи в " + tempFilename);
+    }
+
+    index.push_back({doc.getId(), static_cast<int32_t>(doc.getType()),
+                     static_cast<int64_t>(doc.getDate()), position, text.size()});
+    position += text.size();
+    totalDocuments++;
+    return true;
+}
+
+bool DocumentArchiveWriter::finish() {
+    if (!error.empty()) return false;
+    return closeSegment();
+}
+
+bool DocumentArchiveReader::fail(const string& message) {
+    error = message;
+    header = nullptr;
+    entries = nullptr;
+    file.close();
+    return false;
+}
+
+bool DocumentArchiveReader::open(const string& filename) {
+    error.clear();
+    if (!file.open(filename)) return fail("Не удалось открыть файл " + filename);
+    if (file.size() < sizeof(ArchiveSegmentHeader)) return fail("Файл слишком мал для архива");
+
+    header = reinterpret_cast<const ArchiveSegmentHeader*>(file.data());
+    if (memcmp(header->magic, ARCHIVE_MAGIC, sizeof(ARCHIVE_MAGIC)) != 0) {
+        return fail("Файл не является архивом документов");
+    }
+    if (header->version == 0 || header->version > ARCHIVE_VERSION) {
+        return fail("Неподдерживаемая версия архива: " + to_string(header->version));
+    }
+    if (header->headerSize < sizeof(ArchiveSegmentHeader) || header->fileSize != file.size() ||
+        header->indexOffset % 8 != 0 ||
+        header->indexOffset + header->documentCount * sizeof(ArchiveIndexEntry) != file.size()) {
+        return fail("Поврежденный заголовок архива");
+    }
+
+    entries = reinterpret_cast<const ArchiveIndexEntry*>(file.data() + header->indexOffset);
+    for (uint64_t i = 0; i < header->documentCount; i++) {
+        if (entries[i].offset < header->headerSize ||
+            entries[i].offset + entries[i].length > header->indexOffset ||
+            (i > 0 && entries[i - 1].documentId > entries[i].documentId)) {
+            return fail("Поврежденный индекс архива");
+        }
+    }
+    return true;
+}
+
+const ArchiveIndexEntry* DocumentArchiveReader::find(int documentId) const {
+    const ArchiveIndexEntry* end = entries + size();
+    const ArchiveIndexEntry* it = lower_bound(entries, end, documentId,
+        [](const ArchiveIndexEntry& entry, int id) { return entry.documentId < id; });
+    return it != end && it->documentId == documentId ? it : nullptr;
+}
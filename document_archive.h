@@ -0,0 +1,119 @@
+#ifndef DOCUMENT_ARCHIVE_H
+#define DOCUMENT_ARCHIVE_H
+
+#include "mapped_file.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <cstddef>
+
+class DocumentBase;
+
+// Как выгружать документы: сегментами архива или, как раньше, файлом на документ
+enum class DocumentExportFormat {
+    ARCHIVE,
+    TEXT_FILES
+};
+
+struct DocumentExportResult {
+    bool success = false;
+    std::string error;
+    size_t documentCount = 0;
+    std::vector<std::string> files;
+};
+
+// Архив выгруженных документов.
+//
+// Документы пишутся подряд в печатной форме (DocumentBase::renderText) в
+// сегменты <directory>/<prefix>-NNNNN.arc. Сегмент закрывается, когда
+// превышает заданный размер. В конце сегмента лежит индекс смещений,
+// отсортированный по id документа, поэтому любой документ читается без
+// просмотра остальных.
+
+constexpr char ARCHIVE_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'A', 'R', 'C'};
+constexpr uint32_t ARCHIVE_VERSION = 1;
+
+struct ArchiveSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t documentCount;
+    uint64_t indexOffset;         // ArchiveIndexEntry[documentCount]
+    uint64_t fileSize;
+};
+
+struct ArchiveIndexEntry {
+    int32_t documentId;
+    int32_t type;
+    int64_t date;
+    uint64_t offset;              // начало печатной формы от начала файла
+    uint64_t length;
+};
+
+class DocumentArchiveWriter {
+public:
+    static constexpr uint64_t DEFAULT_SEGMENT_BYTES = 64ull << 20;
+
+    DocumentArchiveWriter(const std::string& directory, const std::string& prefix = "documents",
+                          uint64_t segmentBytes = DEFAULT_SEGMENT_BYTES);
+    ~DocumentArchiveWriter();
+
+    DocumentArchiveWriter(const DocumentArchiveWriter&) = delete;
+    DocumentArchiveWriter& operator=(const DocumentArchiveWriter&) = delete;
+
+    bool add(const DocumentBase& doc);
+    // Дописывает индекс последнего сегмента; после вызова add не допускается
+    bool finish();
+
+    size_t documentCount() const { return totalDocuments; }
+    const std::vector<std::string>& segmentFiles() const { return files; }
+    const std::string& getError() const { return error; }
+
+private:
+    std::string directory;
+    std::string prefix;
+    uint64_t segmentBytes;
+
+    FILE* file = nullptr;
+    std::vector<char> buffer;
+    std::string tempFilename;
+    uint64_t position = 0;
+    std::vector<ArchiveIndexEntry> index;
+    std::string text;             // печатная форма текущего документа
+
+    std::vector<std::string> files;
+    size_t totalDocuments = 0;
+    std::string error;
+
+    bool openSegment();
+    bool closeSegment();
+    bool fail(const std::string& message);
+};
+
+// Чтение сегмента архива из отображенного в память файла
+class DocumentArchiveReader {
+private:
+    MappedFile file;
+    const ArchiveSegmentHeader* header = nullptr;
+    const ArchiveIndexEntry* entries = nullptr;
+    std::string error;
+
+    bool fail(const std::string& message);
+
+public:
+    bool open(const std::string& filename);
+    const std::string& getError() const { return error; }
+
+    size_t size() const { return header ? static_cast<size_t>(header->documentCount) : 0; }
+    const ArchiveIndexEntry& entry(size_t position) const { return entries[position]; }
+
+    // Поиск по индексу: nullptr, если документа в сегменте нет
+    const ArchiveIndexEntry* find(int documentId) const;
+    std::string_view text(const ArchiveIndexEntry& entry) const {
+        return std::string_view(file.data() + entry.offset, static_cast<size_t>(entry.length));
+    }
+};
+
+#endif // DOCUMENT_ARCHIVE_H
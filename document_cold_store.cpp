@@ -0,0 +1,588 @@
+#include "document_cold_store.h"
+#include "block_codec.h"
+#include "snapshot.h"
+#include "document.h"
+#include <filesystem>
+#include <algorithm>
+#include <unordered_set>
+#include <tuple>
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Сериализация документа для холодного сегмента
+class ColdRecordWriter {
+private:
+    string& out;
+
+    void putRaw(const void* data, size_t size) { out.append(static_cast<const char*>(data), size); }
+
+public:
+    explicit ColdRecordWriter(string& _out) : out(_out) {}
+
+    void putInt(int32_t value) { putRaw(&value, sizeof(value)); }
+    void putInt64(int64_t value) { putRaw(&value, sizeof(value)); }
+    void putDouble(double value) { putRaw(&value, sizeof(value)); }
+    void putString(string_view value) {
+        putInt(static_cast<int32_t>(value.size()));
+        out.append(value);
+    }
+};
+
+class ColdRecordReader {
+private:
+    const char* data;
+    size_t size;
+    size_t position = 0;
+    bool ok = true;
+
+    template<typename T>
+    T getRaw() {
+        T value{};
+        if (position + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+public:
+    ColdRecordReader(const char* _data, size_t _size) : data(_data), size(_size) {}
+
+    int32_t getInt() { return getRaw<int32_t>(); }
+    int64_t getInt64() { return getRaw<int64_t>(); }
+    double getDouble() { return getRaw<double>(); }
+    string getString() {
+        int32_t length = getInt();
+        if (!ok || length < 0 || position + static_cast<size_t>(length) > size) {
+            ok = false;
+            return string();
+        }
+        string value(data + position, static_cast<size_t>(length));
+        position += static_cast<size_t>(length);
+        return value;
+    }
+    bool good() const { return ok; }
+};
+
+void serializeDocument(const DocumentBase& doc, string& out) {
+    ColdRecordWriter record(out);
+    record.putInt(static_cast<int32_t>(doc.getType()));
+    record.putInt(doc.getId());
+    record.putInt64(static_cast<int64_t>(doc.getDate()));
+    record.putString(doc.getNumber());
+    record.putString(doc.getStatusLabel());
+    record.putString(doc.getCreatedBy());
+    record.putString(doc.getDepartment());
+    record.putString(doc.getComment());
+
+    DocumentItemView items = doc.getItemView();
+    record.putInt(static_cast<int32_t>(items.size()));
+    for (const auto& item : items) {
+        record.putInt(item.productId);
+        record.putInt(item.quantity);
+        record.putDouble(item.price);
+        record.putString(item.productName());
+        record.putString(items.commentOf(item));
+    }
+
+    DocumentFieldsView fields = doc.getSpecificFields();
+    record.putInt(static_cast<int32_t>(fields.size()));
+    for (const auto& [key, value] : fields) {
+        record.putString(key);
+        record.putString(value);
+    }
+}
+
+shared_ptr<DocumentBase> deserializeDocument(const char* data, size_t size) {
+    ColdRecordReader record(data, size);
+    int32_t type = record.getInt();
+    int32_t id = record.getInt();
+    time_t date = static_cast<time_t>(record.getInt64());
+    string number = record.getString();
+    string status = record.getString();
+    string createdBy = record.getString();
+    string department = record.getString();
+    string comment = record.getString();
+    if (!record.good() || type < 0 || type >= DOCUMENT_TYPE_COUNT) return nullptr;
+
+    auto doc = restoreDocument(static_cast<DocumentType>(type), id, number, createdBy,
+                               department, comment, date,
+                               parseDocumentStatus(static_cast<DocumentType>(type), status));
+    int32_t itemCount = record.getInt();
+    for (int32_t i = 0; i < itemCount && record.good(); i++) {
+        int32_t productId = record.getInt();
+        int32_t quantity = record.getInt();
+        double price = record.getDouble();
+        string name = record.getString();
+        string itemComment = record.getString();
+        if (record.good()) {
+            doc->addLine(productId, name, price, quantity, itemComment);
+        }
+    }
+    int32_t fieldCount = record.getInt();
+    for (int32_t i = 0; i < fieldCount && record.good(); i++) {
+        string key = record.getString();
+        string value = record.getString();
+        if (record.good()) doc->setSpecificField(key, value);
+    }
+    return record.good() ? doc : nullptr;
+}
+
+// Номер документа из сериализованной записи без разбора остального
+bool readRecordNumber(const char* data, size_t size, string& number) {
+    ColdRecordReader record(data, size);
+    record.getInt();
+    record.getInt();
+    record.getInt64();
+    number = record.getString();
+    return record.good();
+}
+
+// Индекс по номеру: записи по возрастанию номера, сами номера подряд в bytes
+void buildNumberTable(vector<pair<string, int32_t>>& numbers,
+                      vector<ColdNumberEntry>& table, string& bytes) {
+    sort(numbers.begin(), numbers.end());
+    table.clear();
+    bytes.clear();
+    for (const auto& [number, documentId] : numbers) {
+        table.push_back({static_cast<uint32_t>(bytes.size()), static_cast<uint32_t>(number.size()),
+                         documentId, 0});
+        bytes += number;
+    }
+}
+
+} // namespace
+
+DocumentColdStore::~DocumentColdStore() {
+    close();
+}
+
+bool DocumentColdStore::fail(const string& message) {
+    error = message;
+    return false;
+}
+
+string DocumentColdStore::segmentPath(const string& basePath, uint64_t number) {
+    return basePath + ".cold." + to_string(number);
+}
+
+vector<uint64_t> DocumentColdStore::listSegments(const string& basePath) {
+    vector<uint64_t> numbers;
+    filesystem::path base(basePath);
+    filesystem::path directory = base.has_parent_path() ? base.parent_path() : filesystem::path(".");
+    string prefix = base.filename().string() + ".cold.";
+
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        string suffix = name.substr(prefix.size());
+        if (suffix.empty() || !all_of(suffix.begin(), suffix.end(), ::isdigit)) continue;
+        numbers.push_back(stoull(suffix));
+    }
+    sort(numbers.begin(), numbers.end());
+    return numbers;
+}
+
+bool DocumentColdStore::open(const string& _basePath) {
+    close();
+    basePath = _basePath;
+    error.clear();
+    opened = true;
+    bool ok = true;
+    // Поврежденный сегмент пропускается: остальные документы остаются доступны
+    for (uint64_t number : listSegments(basePath)) {
+        if (!openSegment(number)) ok = false;
+    }
+    return ok;
+}
+
+void DocumentColdStore::close() {
+    lock_guard<mutex> lock(cacheMutex);
+    cachedSegment = nullptr;
+    cachedData.clear();
+    segments.clear();
+    opened = false;
+}
+
+bool DocumentColdStore::openSegment(uint64_t number) {
+    string filename = segmentPath(basePath, number);
+    auto segment = make_unique<Segment>();
+    segment->number = number;
+    if (!segment->file.open(filename)) return fail("Не удалось открыть файл " + filename);
+
+    const char* data = segment->file.data();
+    size_t size = segment->file.size();
+    if (size < sizeof(ColdSegmentHeader)) return fail("Файл слишком мал: " + filename);
+    const ColdSegmentHeader* header = reinterpret_cast<const ColdSegmentHeader*>(data);
+    // В версии 1 файл кончается индексом по id, с версии 2 за ним индекс по номеру
+    uint64_t indexEnd = header->indexOffset + header->documentCount * sizeof(ColdIndexEntry);
+    uint64_t numberBytesOffset = indexEnd + header->documentCount * sizeof(ColdNumberEntry);
+    if (memcmp(header->magic, COLD_SEGMENT_MAGIC, sizeof(COLD_SEGMENT_MAGIC)) != 0 ||
+        header->version == 0 || header->version > COLD_SEGMENT_VERSION ||
+        header->headerSize < sizeof(ColdSegmentHeader) || header->fileSize != size ||
+        header->blockTableOffset % 8 != 0 || header->indexOffset % 8 != 0 ||
+        header->blockTableOffset + header->blockCount * sizeof(ColdBlockEntry) > header->indexOffset ||
+        (header->version == 1 ? indexEnd != size : numberBytesOffset > size)) {
+        return fail("Поврежденный заголовок сегмента " + filename);
+    }
+
+    SnapshotChecksum checksum;
+    checksum.update(data + header->headerSize, size - header->headerSize);
+    if (checksum.finish() != header->checksum) {
+        return fail("Контрольная сумма сегмента не совпадает: " + filename);
+    }
+
+    const ColdBlockEntry* blocks = reinterpret_cast<const ColdBlockEntry*>(data + header->blockTableOffset);
+    for (uint64_t i = 0; i < header->blockCount; i++) {
+        if (blocks[i].offset < header->headerSize || blocks[i].storedSize > blocks[i].rawSize ||
+            blocks[i].offset + blocks[i].storedSize > header->blockTableOffset) {
+            return fail("Поврежденная таблица блоков сегмента " + filename);
+        }
+    }
+    const ColdIndexEntry* entries = reinterpret_cast<const ColdIndexEntry*>(data + header->indexOffset);
+    for (uint64_t i = 0; i < header->documentCount; i++) {
+        const ColdIndexEntry& entry = entries[i];
+        if (entry.block >= header->blockCount ||
+            uint64_t(entry.offset) + entry.length > blocks[entry.block].rawSize ||
+            (i > 0 && entries[i - 1].documentId >= entry.documentId)) {
+            return fail("Поврежденный индекс сегмента " + filename);
+        }
+    }
+
+    segment->header = header;
+    segment->blocks = blocks;
+    segment->entries = entries;
+    if (header->version >= 2) {
+        const ColdNumberEntry* numbers = reinterpret_cast<const ColdNumberEntry*>(data + indexEnd);
+        const char* numberBytes = data + numberBytesOffset;
+        for (uint64_t i = 0; i < header->documentCount; i++) {
+            if (numberBytesOffset + numbers[i].offset + numbers[i].length > size ||
+                (i > 0 && string_view(numberBytes + numbers[i - 1].offset, numbers[i - 1].length) >
+                              string_view(numberBytes + numbers[i].offset, numbers[i].length))) {
+                return fail("Поврежденный индекс номеров сегмента " + filename);
+            }
+        }
+        segment->numbers = numbers;
+        segment->numberBytes = numberBytes;
+    } else if (!buildNumberIndex(*segment)) {
+        return fail("Не удалось прочитать номера документов сегмента " + filename);
+    }
+    segments.push_back(std::move(segment));
+    return true;
+}
+
+// Индекс по номеру для сегмента версии 1: номера читаются из самих записей,
+// блоки распаковываются по одному разу
+bool DocumentColdStore::buildNumberIndex(Segment& segment) {
+    size_t count = static_cast<size_t>(segment.header->documentCount);
+    vector<const ColdIndexEntry*> order(count);
+    for (size_t i = 0; i < count; i++) order[i] = &segment.entries[i];
+    sort(order.begin(), order.end(), [](const ColdIndexEntry* a, const ColdIndexEntry* b) {
+        return a->block < b->block;
+    });
+
+    vector<pair<string, int32_t>> numbers;
+    numbers.reserve(count);
+    vector<char> data;
+    bool loaded = false;
+    uint32_t loadedBlock = 0;
+    for (const ColdIndexEntry* entry : order) {
+        if (!loaded || entry->block != loadedBlock) {
+            if (!segment.readBlock(entry->block, data)) return false;
+            loaded = true;
+            loadedBlock = entry->block;
+        }
+        string number;
+        if (!readRecordNumber(data.data() + entry->offset, entry->length, number)) return false;
+        numbers.emplace_back(std::move(number), entry->documentId);
+    }
+    buildNumberTable(numbers, segment.builtNumbers, segment.builtNumberBytes);
+    segment.numbers = segment.builtNumbers.data();
+    segment.numberBytes = segment.builtNumberBytes.data();
+    return true;
+}
+
+bool DocumentColdStore::writeSegment(const vector<shared_ptr<DocumentBase>>& documents) {
+    if (!opened) return fail("Холодное хранилище не открыто");
+    if (documents.empty()) return true;
+
+    size_t next = 0;
+    return writeRecords([&](string& block, ColdIndexEntry& entry, string& number) {
+        if (next == documents.size()) return RecordResult::DONE;
+        const DocumentBase& doc = *documents[next++];
+        serializeDocument(doc, block);
+        entry.documentId = doc.getId();
+        entry.type = static_cast<int32_t>(doc.getType());
+        entry.date = static_cast<int64_t>(doc.getDate());
+        number = doc.getNumber();
+        return RecordResult::APPENDED;
+    });
+}
+
+bool DocumentColdStore::compact() {
+    if (!opened) return fail("Холодное хранилище не открыто");
+    if (segments.size() < 2) return true;
+
+    // Действующая версия каждого документа - из самого нового сегмента
+    struct LiveRecord {
+        const Segment* segment;
+        const ColdIndexEntry* entry;
+    };
+    vector<LiveRecord> live;
+    unordered_set<int> seen;
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        const Segment& segment = **it;
+        for (uint64_t i = 0; i < segment.header->documentCount; i++) {
+            if (seen.insert(segment.entries[i].documentId).second) {
+                live.push_back({&segment, &segment.entries[i]});
+            }
+        }
+    }
+    // Записи переносятся в порядке блоков: каждый блок распаковывается один раз
+    sort(live.begin(), live.end(), [](const LiveRecord& a, const LiveRecord& b) {
+        return tie(a.segment->number, a.entry->block, a.entry->offset) <
+               tie(b.segment->number, b.entry->block, b.entry->offset);
+    });
+
+    size_t next = 0;
+    const Segment* loadedSegment = nullptr;
+    uint32_t loadedBlock = 0;
+    vector<char> data;
+    size_t oldCount = segments.size();
+    bool ok = writeRecords([&](string& block, ColdIndexEntry& entry, string& number) {
+        if (next == live.size()) return RecordResult::DONE;
+        const LiveRecord& record = live[next++];
+        if (record.segment != loadedSegment || record.entry->block != loadedBlock) {
+            loadedSegment = nullptr;
+            if (!record.segment->readBlock(record.entry->block, data)) return RecordResult::FAILED;
+            loadedSegment = record.segment;
+            loadedBlock = record.entry->block;
+        }
+        const char* bytes = data.data() + record.entry->offset;
+        if (!readRecordNumber(bytes, record.entry->length, number)) return RecordResult::FAILED;
+        block.append(bytes, record.entry->length);
+        entry = *record.entry;
+        return RecordResult::APPENDED;
+    });
+    if (!ok) return false;
+
+    // Новый сегмент уже на диске и открыт; прежние больше не нужны
+    vector<string> obsolete;
+    {
+        lock_guard<mutex> lock(cacheMutex);
+        cachedSegment = nullptr;
+        cachedData.clear();
+        for (size_t i = 0; i < oldCount; i++) obsolete.push_back(segmentPath(basePath, segments[i]->number));
+        segments.erase(segments.begin(), segments.begin() + static_cast<ptrdiff_t>(oldCount));
+    }
+    for (const string& filename : obsolete) remove(filename.c_str());
+    return true;
+}
+
+bool DocumentColdStore::writeRecords(const RecordSource& source) {
+    vector<uint64_t> existing = listSegments(basePath);
+    uint64_t number = existing.empty() ? 1 : existing.back() + 1;
+    string filename = segmentPath(basePath, number);
+    string tempFilename = filename + ".tmp";
+
+    FILE* file = fopen(tempFilename.c_str(), "wb");
+    if (!file) return fail("Не удалось создать файл " + tempFilename);
+    vector<char> buffer(1 << 20);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    ColdSegmentHeader header;
+    memset(&header, 0, sizeof(header));
+    bool ok = fwrite(&header, 1, sizeof(header), file) == sizeof(header);
+    uint64_t position = sizeof(header);
+    SnapshotChecksum checksum;
+    auto put = [&](const void* data, size_t size) {
+        checksum.update(data, size);
+        ok = ok && fwrite(data, 1, size, file) == size;
+        position += size;
+    };
+
+    // Документы копятся в блоке, пока он не заполнится; блок сжимается целиком
+    vector<ColdBlockEntry> blocks;
+    vector<ColdIndexEntry> index;
+    vector<string> numbers;
+    bool readFailed = false;
+    string block;
+    string compressed;
+    auto flushBlock = [&]() {
+        if (block.empty()) return;
+        compressed.clear();
+        BlockCodec::compress(block.data(), block.size(), compressed);
+        const string& stored = compressed.size() < block.size() ? compressed : block;
+        blocks.push_back({position, static_cast<uint32_t>(stored.size()),
+                          static_cast<uint32_t>(block.size())});
+        put(stored.data(), stored.size());
+        block.clear();
+    };
+
+    block.reserve(COLD_BLOCK_SIZE * 2);
+    for (;;) {
+        size_t start = block.size();
+        ColdIndexEntry entry{};
+        string number;
+        RecordResult result = source(block, entry, number);
+        if (result == RecordResult::DONE) break;
+        if (result == RecordResult::FAILED) {
+            readFailed = true;
+            ok = false;
+            break;
+        }
+        size_t length = block.size() - start;
+        // Запись, не поместившаяся в блок, начинает следующий
+        if (start > 0 && block.size() > COLD_BLOCK_SIZE) {
+            string record = block.substr(start);
+            block.resize(start);
+            flushBlock();
+            block = std::move(record);
+            start = 0;
+        }
+        entry.block = static_cast<uint32_t>(blocks.size());
+        entry.offset = static_cast<uint32_t>(start);
+        entry.length = static_cast<uint32_t>(length);
+        entry.reserved = 0;
+        index.push_back(entry);
+        numbers.push_back(std::move(number));
+    }
+    flushBlock();
+
+    // Индекс по id; если документ передан дважды, остается последняя версия
+    vector<size_t> order(index.size());
+    for (size_t i = 0; i < order.size(); i++) order[i] = i;
+    stable_sort(order.begin(), order.end(), [&index](size_t a, size_t b) {
+        return index[a].documentId < index[b].documentId;
+    });
+    vector<ColdIndexEntry> sortedIndex;
+    vector<pair<string, int32_t>> documentNumbers;
+    for (size_t i = 0; i < order.size(); i++) {
+        if (i + 1 < order.size() && index[order[i + 1]].documentId == index[order[i]].documentId) continue;
+        sortedIndex.push_back(index[order[i]]);
+        documentNumbers.emplace_back(std::move(numbers[order[i]]), index[order[i]].documentId);
+    }
+    index = std::move(sortedIndex);
+    vector<ColdNumberEntry> numberTable;
+    string numberBytes;
+    buildNumberTable(documentNumbers, numberTable, numberBytes);
+
+    static const char zeros[8] = {0};
+    put(zeros, static_cast<size_t>((8 - position % 8) % 8));
+    header.blockTableOffset = position;
+    put(blocks.data(), blocks.size() * sizeof(ColdBlockEntry));
+    put(zeros, static_cast<size_t>((8 - position % 8) % 8));
+    header.indexOffset = position;
+    put(index.data(), index.size() * sizeof(ColdIndexEntry));
+    put(numberTable.data(), numberTable.size() * sizeof(ColdNumberEntry));
+    put(numberBytes.data(), numberBytes.size());
+
+    memcpy(header.magic, COLD_SEGMENT_MAGIC, sizeof(header.magic));
+    header.version = COLD_SEGMENT_VERSION;
+    header.headerSize = sizeof(ColdSegmentHeader);
+    header.checksum = checksum.finish();
+    header.fileSize = position;
+    header.documentCount = index.size();
+    header.blockCount = blocks.size();
+    ok = ok && fseek(file, 0, SEEK_SET) == 0 &&
+         fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+         fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = fclose(file) == 0 && ok;
+    if (!ok) {
+        remove(tempFilename.c_str());
+        return fail(readFailed ? "Не удалось прочитать записи для сегмента " + filename
+                               : "Ошибка записи в " + tempFilename);
+    }
+    if (rename(tempFilename.c_str(), filename.c_str()) != 0) {
+        remove(tempFilename.c_str());
+        return fail("Не удалось переименовать " + tempFilename);
+    }
+    return openSegment(number);
+}
+
+const ColdIndexEntry* DocumentColdStore::Segment::find(int documentId) const {
+    const ColdIndexEntry* end = entries + header->documentCount;
+    const ColdIndexEntry* it = lower_bound(entries, end, documentId,
+        [](const ColdIndexEntry& entry, int id) { return entry.documentId < id; });
+    return it != end && it->documentId == documentId ? it : nullptr;
+}
+
+// Самая новая версия документа: сегменты просматриваются от последнего
+const ColdIndexEntry* DocumentColdStore::locate(int documentId, const Segment*& segment) const {
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        if (const ColdIndexEntry* entry = (*it)->find(documentId)) {
+            segment = it->get();
+            return entry;
+        }
+    }
+    return nullptr;
+}
+
+int DocumentColdStore::Segment::findNumber(const string& number) const {
+    auto text = [this](const ColdNumberEntry& entry) {
+        return string_view(numberBytes + entry.offset, entry.length);
+    };
+    const ColdNumberEntry* end = numbers + header->documentCount;
+    const ColdNumberEntry* it = lower_bound(numbers, end, string_view(number),
+        [&text](const ColdNumberEntry& entry, string_view value) { return text(entry) < value; });
+    return it != end && text(*it) == number ? it->documentId : 0;
+}
+
+bool DocumentColdStore::Segment::readBlock(uint32_t block, vector<char>& data) const {
+    const ColdBlockEntry& entry = blocks[block];
+    const char* stored = file.data() + entry.offset;
+    data.resize(entry.rawSize);
+    if (entry.storedSize == entry.rawSize) {
+        memcpy(data.data(), stored, entry.rawSize);
+        return true;
+    }
+    return BlockCodec::decompress(stored, entry.storedSize, data.data(), entry.rawSize);
+}
+
+bool DocumentColdStore::contains(int documentId) const {
+    const Segment* segment;
+    return locate(documentId, segment) != nullptr;
+}
+
+// Номер документа не меняется, поэтому подходит любой сегмент, где он есть
+int DocumentColdStore::findNumber(const string& number) const {
+    for (auto it = segments.rbegin(); it != segments.rend(); ++it) {
+        if (int documentId = (*it)->findNumber(number)) return documentId;
+    }
+    return 0;
+}
+
+shared_ptr<DocumentBase> DocumentColdStore::load(int documentId) const {
+    const Segment* segment = nullptr;
+    const ColdIndexEntry* entry = locate(documentId, segment);
+    if (!entry) return nullptr;
+
+    lock_guard<mutex> lock(cacheMutex);
+    if (cachedSegment != segment || cachedBlock != entry->block) {
+        cachedSegment = nullptr;
+        if (!segment->readBlock(entry->block, cachedData)) return nullptr;
+        cachedSegment = segment;
+        cachedBlock = entry->block;
+    }
+    return deserializeDocument(cachedData.data() + entry->offset, entry->length);
+}
+
+size_t DocumentColdStore::entryCount() const {
+    size_t count = 0;
+    for (const auto& segment : segments) count += static_cast<size_t>(segment->header->documentCount);
+    return count;
+}
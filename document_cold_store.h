@@ -0,0 +1,151 @@
+#ifndef DOCUMENT_COLD_STORE_H
+#define DOCUMENT_COLD_STORE_H
+
+#include "mapped_file.h"
+#include <string>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+class DocumentBase;
+
+// Холодный уровень хранения проведенных документов.
+//
+// Документы целиком (заголовок, строки, специфичные поля) сериализуются
+// подряд и режутся на блоки по COLD_BLOCK_SIZE байт, каждый блок сжимается
+// BlockCodec. Сегмент <base>.cold.<N> пишется один раз и дальше только
+// читается через отображение в память: в памяти процесса остаются лишь
+// страницы, к которым обращались. В конце сегмента - таблица блоков и
+// индекс, отсортированный по id документа.
+//
+// Один и тот же документ может оказаться в нескольких сегментах (если его
+// изменили после возврата из холодного уровня) - действует самый новый.
+// Когда сегментов набирается COLD_COMPACT_SEGMENTS, compact() сливает их
+// в один, оставляя только действующие версии.
+//
+// С версии 2 за индексом по id лежит индекс по номеру документа
+// (ColdNumberEntry, отсортирован по номеру) и сами номера: номер вытесненного
+// документа остается занятым, и документ находится по номеру. Для сегментов
+// версии 1 такой индекс строится в памяти при открытии.
+
+constexpr char COLD_SEGMENT_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'C', 'L', 'D'};
+constexpr uint32_t COLD_SEGMENT_VERSION = 2;
+constexpr size_t COLD_BLOCK_SIZE = 64 * 1024;
+constexpr size_t COLD_COMPACT_SEGMENTS = 8;
+
+struct ColdSegmentHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t checksum;            // SnapshotChecksum всего, что после заголовка
+    uint64_t fileSize;
+    uint64_t documentCount;
+    uint64_t blockCount;
+    uint64_t blockTableOffset;    // ColdBlockEntry[blockCount]
+    uint64_t indexOffset;         // ColdIndexEntry[documentCount]
+};
+
+struct ColdBlockEntry {
+    uint64_t offset;
+    uint32_t storedSize;          // равен rawSize - блок записан без сжатия
+    uint32_t rawSize;
+};
+
+struct ColdIndexEntry {
+    int32_t documentId;
+    int32_t type;
+    int64_t date;
+    uint32_t block;
+    uint32_t offset;              // начало записи внутри распакованного блока
+    uint32_t length;
+    uint32_t reserved;
+};
+
+// Номер документа; offset - от начала номеров, которые идут сразу за этой таблицей
+struct ColdNumberEntry {
+    uint32_t offset;
+    uint32_t length;
+    int32_t documentId;
+    uint32_t reserved;
+};
+
+class DocumentColdStore {
+public:
+    DocumentColdStore() = default;
+    ~DocumentColdStore();
+
+    DocumentColdStore(const DocumentColdStore&) = delete;
+    DocumentColdStore& operator=(const DocumentColdStore&) = delete;
+
+    // Открывает существующие сегменты <basePath>.cold.<N>
+    bool open(const std::string& basePath);
+    void close();
+    bool isOpen() const { return opened; }
+
+    // Пишет документы в новый сегмент; к возврату сегмент уже на диске (fsync)
+    bool writeSegment(const std::vector<std::shared_ptr<DocumentBase>>& documents);
+
+    // Сливает все сегменты в один с последними версиями документов;
+    // прежние сегменты удаляются после того, как новый уже на диске
+    bool compact();
+
+    bool contains(int documentId) const;
+    // id документа с номером number или 0
+    int findNumber(const std::string& number) const;
+    // Восстанавливает документ целиком или возвращает nullptr
+    std::shared_ptr<DocumentBase> load(int documentId) const;
+
+    size_t segmentCount() const { return segments.size(); }
+    // Записей во всех сегментах (повторные версии документа считаются отдельно)
+    size_t entryCount() const;
+    const std::string& getError() const { return error; }
+
+    static std::string segmentPath(const std::string& basePath, uint64_t number);
+    static std::vector<uint64_t> listSegments(const std::string& basePath);
+
+private:
+    struct Segment {
+        uint64_t number = 0;
+        MappedFile file;
+        const ColdSegmentHeader* header = nullptr;
+        const ColdBlockEntry* blocks = nullptr;
+        const ColdIndexEntry* entries = nullptr;
+        const ColdNumberEntry* numbers = nullptr;
+        const char* numberBytes = nullptr;
+        // Индекс по номеру для сегментов версии 1
+        std::vector<ColdNumberEntry> builtNumbers;
+        std::string builtNumberBytes;
+
+        const ColdIndexEntry* find(int documentId) const;
+        int findNumber(const std::string& number) const;
+        bool readBlock(uint32_t block, std::vector<char>& data) const;
+    };
+
+    // Источник записей для writeRecords: дописывает в block очередную
+    // сериализованную запись и заполняет id, тип, дату и номер документа
+    enum class RecordResult { APPENDED, DONE, FAILED };
+    using RecordSource = std::function<RecordResult(std::string& block, ColdIndexEntry& entry,
+                                                    std::string& number)>;
+
+    std::string basePath;
+    bool opened = false;
+    std::vector<std::unique_ptr<Segment>> segments;   // по возрастанию номера
+    std::string error;
+
+    // Последний распакованный блок: соседние документы обычно читаются подряд
+    mutable std::mutex cacheMutex;
+    mutable const Segment* cachedSegment = nullptr;
+    mutable uint32_t cachedBlock = 0;
+    mutable std::vector<char> cachedData;
+
+    bool openSegment(uint64_t number);
+    bool buildNumberIndex(Segment& segment);
+    bool writeRecords(const RecordSource& source);
+    const ColdIndexEntry* locate(int documentId, const Segment*& segment) const;
+    bool fail(const std::string& message);
+};
+
+#endif // DOCUMENT_COLD_STORE_H
@@ -0,0 +1,47 @@
+#include "document_line.h"
+#include <algorithm>
+
+using namespace std;
+
+uint32_t DocumentStringPool::intern(string_view value) {
+    if (value.empty()) return EMPTY;
+
+    lock_guard<mutex> lock(poolMutex);
+    auto it = index.find(value);
+    if (it != index.end()) return it->second;
+
+    size_t need = sizeof(uint32_t) + value.size();
+    if (chunkUsed + need > chunkCapacity) {
+        // Все 4096 блоков заняты - 4 ГБ различных строк; строка не сохраняется
+        if (storage.size() == MAX_CHUNKS) return EMPTY;
+        // В нулевом блоке смещение 0 заняло бы id пустой строки
+        size_t start = storage.empty() ? sizeof(uint32_t) : 0;
+        // Строка длиннее блока получает собственный блок
+        chunkCapacity = max(CHUNK_SIZE, start + need);
+        storage.push_back(make_unique<char[]>(chunkCapacity));
+        chunks[storage.size() - 1].store(storage.back().get(), memory_order_release);
+        chunkUsed = start;
+        allocatedBytes += chunkCapacity;
+    }
+
+    char* entry = storage.back().get() + chunkUsed;
+    uint32_t length = static_cast<uint32_t>(value.size());
+    memcpy(entry, &length, sizeof(length));
+    memcpy(entry + sizeof(length), value.data(), value.size());
+    uint32_t id = static_cast<uint32_t>(((storage.size() - 1) << CHUNK_BITS) | chunkUsed);
+    chunkUsed += need;
+    index.emplace(string_view(entry + sizeof(length), value.size()), id);
+    return id;
+}
+
+size_t DocumentStringPool::size() const {
+    lock_guard<mutex> lock(poolMutex);
+    return index.size();
+}
+
+size_t DocumentStringPool::memoryUsage() const {
+    lock_guard<mutex> lock(poolMutex);
+    // Узел индекса: ключ, id и указатель на следующий узел
+    return allocatedBytes + index.size() * (sizeof(string_view) + 2 * sizeof(void*)) +
+           index.bucket_count() * sizeof(void*);
+}
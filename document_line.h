@@ -0,0 +1,77 @@
+#ifndef DOCUMENT_LINE_H
+#define DOCUMENT_LINE_H
+
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+// Общий для всех документов набор наименований товаров в строках.
+// Одинаковые наименования хранятся один раз, документ держит только
+// 32-битный id. Строки лежат в блоках по 1 МБ, которые не перемещаются
+// и не освобождаются, поэтому get() не берет блокировку и возвращенный
+// string_view действителен до конца работы программы. Набор только
+// растет: в нем каждое наименование, когда-либо попавшее в строку
+// документа (в том числе переименованных и удаленных товаров), поэтому
+// сюда не попадает произвольный текст - комментарии строк хранит сам
+// документ (см. DocumentItemView::commentOf).
+class DocumentStringPool {
+public:
+    static constexpr uint32_t EMPTY = 0;
+
+    static DocumentStringPool& instance() {
+        static DocumentStringPool pool;
+        return pool;
+    }
+
+    uint32_t intern(std::string_view value);
+    std::string_view get(uint32_t id) const {
+        if (id == EMPTY) return std::string_view();
+        const char* chunk = chunks[id >> CHUNK_BITS].load(std::memory_order_acquire);
+        const char* entry = chunk + (id & (CHUNK_SIZE - 1));
+        uint32_t length;
+        std::memcpy(&length, entry, sizeof(length));
+        return std::string_view(entry + sizeof(length), length);
+    }
+
+    size_t size() const;
+    size_t memoryUsage() const;
+
+private:
+    static constexpr uint32_t CHUNK_BITS = 20;
+    static constexpr size_t CHUNK_SIZE = size_t(1) << CHUNK_BITS;
+    static constexpr size_t MAX_CHUNKS = size_t(1) << (32 - CHUNK_BITS);
+
+    DocumentStringPool() = default;
+
+    std::array<std::atomic<const char*>, MAX_CHUNKS> chunks{};
+    std::vector<std::unique_ptr<char[]>> storage;
+    size_t chunkUsed = 0;                   // занято в последнем блоке
+    size_t chunkCapacity = 0;
+    size_t allocatedBytes = 0;
+    std::unordered_map<std::string_view, uint32_t> index;
+    mutable std::mutex poolMutex;
+};
+
+// Строка документа: 24 байта без отдельных блоков в куче. Цена
+// и наименование товара запоминаются на момент добавления строки.
+struct DocumentLine {
+    static constexpr uint32_t NO_COMMENT = 0;
+
+    int32_t productId;
+    int32_t quantity;
+    double price;
+    uint32_t name;          // id в DocumentStringPool
+    uint32_t comment;       // номер комментария в документе (с 1), NO_COMMENT - без комментария
+
+    std::string_view productName() const { return DocumentStringPool::instance().get(name); }
+    double total() const { return price * quantity; }
+};
+
+#endif // DOCUMENT_LINE_H
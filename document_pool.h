@@ -0,0 +1,94 @@
+#ifndef DOCUMENT_POOL_H
+#define DOCUMENT_POOL_H
+
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <cstddef>
+
+// Память под объекты одного класса: блоки по SLOTS_PER_BLOCK мест,
+// освободившиеся места используются повторно. Документы одного типа
+// создаются через DocumentAllocator и лежат в памяти подряд, поэтому
+// обход по типу (DocumentRegistry::forEach) читает память последовательно,
+// а не вперемешку с документами других типов.
+// Блоки не возвращаются системе до конца работы программы.
+template<typename T>
+class DocumentSlab {
+public:
+    static constexpr size_t SLOTS_PER_BLOCK = 256;
+
+    // Экземпляр не разрушается: документы могут пережить статические объекты
+    static DocumentSlab& instance() {
+        static DocumentSlab* slab = new DocumentSlab();
+        return *slab;
+    }
+
+    T* allocate() {
+        std::lock_guard<std::mutex> lock(slabMutex);
+        if (!freeList) grow();
+        Slot* slot = freeList;
+        freeList = slot->next;
+        return reinterpret_cast<T*>(slot->storage);
+    }
+
+    // Освобождение возможно из любого потока (например, после фоновой записи снимка)
+    void deallocate(T* object) {
+        std::lock_guard<std::mutex> lock(slabMutex);
+        Slot* slot = reinterpret_cast<Slot*>(object);
+        slot->next = freeList;
+        freeList = slot;
+    }
+
+private:
+    union Slot {
+        Slot* next;
+        alignas(T) unsigned char storage[sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Slot[]>> blocks;
+    Slot* freeList = nullptr;
+    std::mutex slabMutex;
+
+    DocumentSlab() = default;
+
+    void grow() {
+        blocks.emplace_back(new Slot[SLOTS_PER_BLOCK]);
+        Slot* block = blocks.back().get();
+        // Места выдаются по возрастанию адреса
+        for (size_t i = SLOTS_PER_BLOCK; i-- > 0;) {
+            block[i].next = freeList;
+            freeList = &block[i];
+        }
+    }
+};
+
+// Распределитель для std::allocate_shared: объект документа вместе со
+// счетчиком ссылок занимает одно место в DocumentSlab своего типа
+template<typename T>
+struct DocumentAllocator {
+    using value_type = T;
+
+    DocumentAllocator() = default;
+    template<typename U>
+    DocumentAllocator(const DocumentAllocator<U>&) {}
+
+    T* allocate(size_t count) {
+        if (count != 1) return std::allocator<T>().allocate(count);
+        return DocumentSlab<T>::instance().allocate();
+    }
+
+    void deallocate(T* object, size_t count) {
+        if (count != 1) {
+            std::allocator<T>().deallocate(object, count);
+            return;
+        }
+        DocumentSlab<T>::instance().deallocate(object);
+    }
+
+    template<typename U>
+    bool operator==(const DocumentAllocator<U>&) const { return true; }
+    template<typename U>
+    bool operator!=(const DocumentAllocator<U>&) const { return false; }
+};
+
+#endif // DOCUMENT_POOL_H
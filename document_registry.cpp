@@ -0,0 +1,134 @@
+#include "document_registry.h"
+#include "document.h"
+
+using namespace std;
+
+bool DocumentRegistry::add(DocumentPtr doc) {
+    if (!doc) return false;
+    if (idIndex.count(doc->getId()) || numberIndex.count(doc->getNumber())) {
+        return false;
+    }
+
+    size_t typeIndex = static_cast<size_t>(doc->getType());
+    idIndex[doc->getId()] = documents.size();
+    numberIndex[doc->getNumber()] = doc->getId();
+    typeLists[typeIndex].push_back(doc);
+    dateIndex.emplace(doc->getDate(), doc);
+    typeDateIndex[typeIndex].emplace(doc->getDate(), doc);
+    statusDateIndex[static_cast<size_t>(doc->getStatus())].emplace(doc->getDate(), doc);
+    addTyped(doc);
+    documents.push_back(std::move(doc));
+    return true;
+}
+
+size_t DocumentRegistry::removeIf(const function<bool(const DocumentPtr&)>& predicate) {
+    vector<DocumentPtr> kept;
+    kept.reserve(documents.size());
+    for (const auto& doc : documents) {
+        if (!predicate(doc)) kept.push_back(doc);
+    }
+    size_t removed = documents.size() - kept.size();
+    if (removed == 0) return 0;
+
+    clear();
+    for (auto& doc : kept) add(std::move(doc));
+    return removed;
+}
+
+void DocumentRegistry::clear() {
+    documents.clear();
+    idIndex.clear();
+    numberIndex.clear();
+    dateIndex.clear();
+    for (auto& list : typeLists) list.clear();
+    for (auto& index : typeDateIndex) index.clear();
+    for (auto& index : statusDateIndex) index.clear();
+    variants.clear();
+    std::apply([](auto&... lists) { (lists.clear(), ...); }, typedLists);
+}
+
+// Каждый документ типа Type - DocumentTemplate<Type> (других реализаций
+// DocumentBase нет), поэтому приведение по getType() безопасно
+template<DocumentType Type>
+void DocumentRegistry::addTyped(const DocumentPtr& doc) {
+    auto typed = static_pointer_cast<DocumentTemplate<Type>>(doc);
+    variants.emplace_back(typed.get());
+    std::get<static_cast<size_t>(Type)>(typedLists).push_back(std::move(typed));
+}
+
+void DocumentRegistry::addTyped(const DocumentPtr& doc) {
+    switch(doc->getType()) {
+        case DocumentType::RECEIPT:
+            addTyped<DocumentType::RECEIPT>(doc);
+            break;
+        case DocumentType::INCOME_INVOICE:
+            addTyped<DocumentType::INCOME_INVOICE>(doc);
+            break;
+        case DocumentType::OUTCOME_INVOICE:
+            addTyped<DocumentType::OUTCOME_INVOICE>(doc);
+            break;
+        case DocumentType::INVENTORY:
+            addTyped<DocumentType::INVENTORY>(doc);
+            break;
+    }
+}
+
+bool DocumentRegistry::transition(const DocumentPtr& doc, DocumentStatus next) {
+    if (!doc || !canTransition(doc->getStatus(), next)) return false;
+
+    // Документ ищется среди документов с той же датой в индексе прежнего статуса
+    DateIndex& from = statusDateIndex[static_cast<size_t>(doc->getStatus())];
+    auto range = from.equal_range(doc->getDate());
+    for (auto it = range.first; it != range.second; ++it) {
+        if (it->second == doc) {
+            from.erase(it);
+            break;
+        }
+    }
+    doc->setStatus(next);
+    statusDateIndex[static_cast<size_t>(next)].emplace(doc->getDate(), doc);
+    return true;
+}
+
+DocumentRegistry::DocumentPtr DocumentRegistry::findById(int id) const {
+    auto it = idIndex.find(id);
+    return it == idIndex.end() ? nullptr : documents[it->second];
+}
+
+DocumentRegistry::DocumentPtr DocumentRegistry::findByNumber(const string& number) const {
+    auto it = numberIndex.find(number);
+    return it == numberIndex.end() ? nullptr : findById(it->second);
+}
+
+const vector<DocumentRegistry::DocumentPtr>& DocumentRegistry::byType(DocumentType type) const {
+    return typeLists[static_cast<size_t>(type)];
+}
+
+DocumentRegistry::DateRange DocumentRegistry::byDate(time_t from, time_t to) const {
+    return rangeOf(dateIndex, from, to);
+}
+
+DocumentRegistry::DateRange DocumentRegistry::byTypeAndDate(DocumentType type,
+                                                            time_t from, time_t to) const {
+    return rangeOf(typeDateIndex[static_cast<size_t>(type)], from, to);
+}
+
+DocumentRegistry::DateRange DocumentRegistry::byStatus(DocumentStatus status) const {
+    const DateIndex& index = statusDateIndex[static_cast<size_t>(status)];
+    return DateRange(index.begin(), index.end());
+}
+
+DocumentRegistry::DateRange DocumentRegistry::byStatusAndDate(DocumentStatus status,
+                                                              time_t from, time_t to) const {
+    return rangeOf(statusDateIndex[static_cast<size_t>(status)], from, to);
+}
+
+size_t DocumentRegistry::countByStatus(DocumentStatus status) const {
+    return statusDateIndex[static_cast<size_t>(status)].size();
+}
+
+DocumentRegistry::DateRange DocumentRegistry::rangeOf(const DateIndex& index,
+                                                      time_t from, time_t to) {
+    if (from >= to) return DateRange(index.end(), index.end());
+    return DateRange(index.lower_bound(from), index.lower_bound(to));
+}
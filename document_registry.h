@@ -0,0 +1,157 @@
+#ifndef DOCUMENT_REGISTRY_H
+#define DOCUMENT_REGISTRY_H
+
+#include "document_type.h"
+#include "document_status.h"
+#include <vector>
+#include <array>
+#include <map>
+#include <unordered_map>
+#include <memory>
+#include <string>
+#include <ctime>
+#include <iterator>
+#include <functional>
+#include <tuple>
+#include <variant>
+#include <utility>
+
+class DocumentBase;
+template<DocumentType> class DocumentTemplate;
+
+// Документы одного типа с известным при компиляции классом
+template<DocumentType Type>
+using TypedDocumentList = std::vector<std::shared_ptr<DocumentTemplate<Type>>>;
+
+// Документ любого типа без виртуальной диспетчеризации: std::visit выбирает
+// конкретный класс один раз на документ
+using DocumentVariant = std::variant<DocumentTemplate<DocumentType::RECEIPT>*,
+                                     DocumentTemplate<DocumentType::INCOME_INVOICE>*,
+                                     DocumentTemplate<DocumentType::OUTCOME_INVOICE>*,
+                                     DocumentTemplate<DocumentType::INVENTORY>*>;
+
+// Реестр документов склада с индексами по id, типу, номеру, дате и статусу
+class DocumentRegistry {
+public:
+    using DocumentPtr = std::shared_ptr<DocumentBase>;
+    using DateIndex = std::multimap<time_t, DocumentPtr>;
+
+    // Представление диапазона индекса по дате: документы не копируются,
+    // обход идет прямо по узлам индекса
+    class DateRange {
+    public:
+        class iterator {
+        private:
+            DateIndex::const_iterator it;
+
+        public:
+            using iterator_category = std::bidirectional_iterator_tag;
+            using value_type = DocumentPtr;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const DocumentPtr*;
+            using reference = const DocumentPtr&;
+
+            explicit iterator(DateIndex::const_iterator _it) : it(_it) {}
+
+            const DocumentPtr& operator*() const { return it->second; }
+            const DocumentPtr* operator->() const { return &it->second; }
+            iterator& operator++() { ++it; return *this; }
+            iterator& operator--() { --it; return *this; }
+            bool operator==(const iterator& other) const { return it == other.it; }
+            bool operator!=(const iterator& other) const { return it != other.it; }
+        };
+
+        DateRange(DateIndex::const_iterator _first, DateIndex::const_iterator _last)
+            : first(_first), last(_last) {}
+
+        iterator begin() const { return iterator(first); }
+        iterator end() const { return iterator(last); }
+        bool empty() const { return first == last; }
+        size_t size() const { return static_cast<size_t>(std::distance(first, last)); }
+
+    private:
+        DateIndex::const_iterator first;
+        DateIndex::const_iterator last;
+    };
+
+    // Возвращает false, если документ с таким id или номером уже есть
+    bool add(DocumentPtr doc);
+    // Удаляет документы, для которых predicate вернул true; порядок
+    // остальных сохраняется. Индексы перестраиваются один раз.
+    size_t removeIf(const std::function<bool(const DocumentPtr&)>& predicate);
+    void clear();
+
+    // Переход документа реестра в статус next. false - переход недопустим
+    // (см. canTransition), документ и индексы не меняются.
+    bool transition(const DocumentPtr& doc, DocumentStatus next);
+
+    DocumentPtr findById(int id) const;
+    DocumentPtr findByNumber(const std::string& number) const;
+
+    // Все документы в порядке регистрации
+    const std::vector<DocumentPtr>& all() const { return documents; }
+    const std::vector<DocumentPtr>& byType(DocumentType type) const;
+
+    // Документы с датой в полуинтервале [from, to), по возрастанию даты
+    DateRange byDate(time_t from, time_t to) const;
+    DateRange byTypeAndDate(DocumentType type, time_t from, time_t to) const;
+    // Документы в статусе status, по возрастанию даты, без перебора остальных
+    DateRange byStatus(DocumentStatus status) const;
+    DateRange byStatusAndDate(DocumentStatus status, time_t from, time_t to) const;
+    size_t countByStatus(DocumentStatus status) const;
+
+    // Массовые операции без виртуальных вызовов. visit получает
+    // const DocumentTemplate<Type>& - для каждого типа компилируется своя
+    // копия тела, методы документа вызываются напрямую и встраиваются.
+    // Документы обходятся в порядке регистрации.
+    template<typename Visitor>
+    void forEach(Visitor&& visit) const {
+        for (const DocumentVariant& doc : variants) {
+            std::visit([&visit](const auto* typed) { visit(*typed); }, doc);
+        }
+    }
+
+    // Документы, для которых predicate(const DocumentTemplate<Type>&) вернул true,
+    // в порядке регистрации
+    template<typename Predicate>
+    std::vector<DocumentPtr> filter(Predicate&& predicate) const {
+        std::vector<DocumentPtr> found;
+        for (size_t i = 0; i < variants.size(); i++) {
+            if (std::visit([&predicate](const auto* typed) { return predicate(*typed); }, variants[i])) {
+                found.push_back(documents[i]);
+            }
+        }
+        return found;
+    }
+
+    // Документы одного типа: цикл по ним не ветвится вовсе
+    template<DocumentType Type>
+    const TypedDocumentList<Type>& ofType() const {
+        return std::get<static_cast<size_t>(Type)>(typedLists);
+    }
+
+    size_t size() const { return documents.size(); }
+
+private:
+    std::vector<DocumentPtr> documents;
+    std::unordered_map<int, size_t> idIndex;            // id -> позиция в documents
+    std::unordered_map<std::string, int> numberIndex;   // номер -> id
+    std::array<std::vector<DocumentPtr>, DOCUMENT_TYPE_COUNT> typeLists;
+    DateIndex dateIndex;
+    std::array<DateIndex, DOCUMENT_TYPE_COUNT> typeDateIndex;
+    std::array<DateIndex, DOCUMENT_STATUS_COUNT> statusDateIndex;
+    // Те же документы с конкретным классом: variants - параллельно documents,
+    // typedLists - как typeLists (порядок элементов кортежа - DocumentType)
+    std::vector<DocumentVariant> variants;
+    std::tuple<TypedDocumentList<DocumentType::RECEIPT>,
+               TypedDocumentList<DocumentType::INCOME_INVOICE>,
+               TypedDocumentList<DocumentType::OUTCOME_INVOICE>,
+               TypedDocumentList<DocumentType::INVENTORY>> typedLists;
+
+    static DateRange rangeOf(const DateIndex& index, time_t from, time_t to);
+    void addTyped(const DocumentPtr& doc);
+    template<DocumentType Type>
+    void addTyped(const DocumentPtr& doc);
+};
+
+#endif // DOCUMENT_REGISTRY_H
@@ -0,0 +1,184 @@
+#ifndef DOCUMENT_SCHEMA_H
+#define DOCUMENT_SCHEMA_H
+
+#include "document_type.h"
+#include <string>
+#include <string_view>
+#include <utility>
+#include <iterator>
+#include <cstddef>
+
+// Специфичные поля документов задаются схемой на этапе компиляции:
+// у каждого типа - фиксированный список полей с начальными значениями.
+// Документ хранит значения массивом в порядке схемы и обращается к ним
+// по номеру поля; по этой же схеме строится таблица полей в окне.
+
+struct DocumentFieldSpec {
+    std::string_view name;
+    std::string_view defaultValue;
+};
+
+template<DocumentType Type>
+struct DocumentSchema;
+
+template<>
+struct DocumentSchema<DocumentType::RECEIPT> {
+    static constexpr DocumentFieldSpec fields[] = {
+        {"Сотрудник", ""},
+        {"Смена", ""},
+        {"Номер заказа", ""},
+        {"Тип оплаты", "Наличные"}
+    };
+};
+
+template<>
+struct DocumentSchema<DocumentType::INCOME_INVOICE> {
+    static constexpr DocumentFieldSpec fields[] = {
+        {"Поставщик", ""},
+        {"Договор", ""},
+        {"Счет-фактура", ""},
+        {"Склад приемки", "Основной"}
+    };
+};
+
+template<>
+struct DocumentSchema<DocumentType::OUTCOME_INVOICE> {
+    static constexpr DocumentFieldSpec fields[] = {
+        {"Получатель", ""},
+        {"Основание", ""},
+        {"Склад отгрузки", "Основной"},
+        {"Транспорт", ""}
+    };
+};
+
+template<>
+struct DocumentSchema<DocumentType::INVENTORY> {
+    static constexpr DocumentFieldSpec fields[] = {
+        {"Комиссия", ""},
+        {"Склад", "Основной"},
+        {"Причина", "Плановая инвентаризация"},
+        {"Результат", "Не проведена"}
+    };
+};
+
+// Схема типа, выбранного во время выполнения
+class DocumentSchemaRef {
+private:
+    const DocumentFieldSpec* fields = nullptr;
+    size_t count = 0;
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+    using const_iterator = const DocumentFieldSpec*;
+
+    constexpr DocumentSchemaRef() = default;
+    template<size_t N>
+    constexpr DocumentSchemaRef(const DocumentFieldSpec (&_fields)[N]) : fields(_fields), count(N) {}
+
+    constexpr const_iterator begin() const { return fields; }
+    constexpr const_iterator end() const { return fields + count; }
+    constexpr size_t size() const { return count; }
+    constexpr const DocumentFieldSpec& operator[](size_t slot) const { return fields[slot]; }
+
+    // Номер поля по имени или npos; полей немного, поиск линейный
+    constexpr size_t find(std::string_view name) const {
+        for (size_t slot = 0; slot < count; slot++) {
+            if (fields[slot].name == name) return slot;
+        }
+        return npos;
+    }
+};
+
+template<DocumentType Type>
+constexpr size_t documentFieldCount = std::size(DocumentSchema<Type>::fields);
+
+// Номер поля, известного на этапе компиляции:
+// documentFieldSlot<DocumentType::INVENTORY>("Результат") == 3
+template<DocumentType Type>
+constexpr size_t documentFieldSlot(std::string_view name) {
+    return DocumentSchemaRef(DocumentSchema<Type>::fields).find(name);
+}
+
+constexpr DocumentSchemaRef documentSchema(DocumentType type) {
+    switch(type) {
+        case DocumentType::RECEIPT: return DocumentSchema<DocumentType::RECEIPT>::fields;
+        case DocumentType::INCOME_INVOICE: return DocumentSchema<DocumentType::INCOME_INVOICE>::fields;
+        case DocumentType::OUTCOME_INVOICE: return DocumentSchema<DocumentType::OUTCOME_INVOICE>::fields;
+        case DocumentType::INVENTORY: return DocumentSchema<DocumentType::INVENTORY>::fields;
+    }
+    return DocumentSchemaRef();
+}
+
+// Имена полей внутри схемы не должны повторяться: find() нашел бы только первое
+constexpr bool hasUniqueFieldNames(DocumentSchemaRef schema) {
+    for (size_t slot = 0; slot < schema.size(); slot++) {
+        if (schema.find(schema[slot].name) != slot) return false;
+    }
+    return true;
+}
+
+static_assert(hasUniqueFieldNames(documentSchema(DocumentType::RECEIPT)) &&
+              hasUniqueFieldNames(documentSchema(DocumentType::INCOME_INVOICE)) &&
+              hasUniqueFieldNames(documentSchema(DocumentType::OUTCOME_INVOICE)) &&
+              hasUniqueFieldNames(documentSchema(DocumentType::INVENTORY)),
+              "Повторяющееся имя поля в схеме документа");
+
+// Значения полей документа вместе со схемой: for (auto [name, value] : fields)
+class DocumentFieldsView {
+private:
+    DocumentSchemaRef schema;
+    const std::string* values = nullptr;
+
+public:
+    class const_iterator {
+    private:
+        const DocumentFieldSpec* spec;
+        const std::string* value;
+
+    public:
+        const_iterator(const DocumentFieldSpec* _spec, const std::string* _value)
+            : spec(_spec), value(_value) {}
+        std::pair<std::string_view, const std::string&> operator*() const { return {spec->name, *value}; }
+        const_iterator& operator++() { ++spec; ++value; return *this; }
+        bool operator!=(const const_iterator& other) const { return spec != other.spec; }
+        bool operator==(const const_iterator& other) const { return spec == other.spec; }
+    };
+
+    DocumentFieldsView() = default;
+    DocumentFieldsView(DocumentSchemaRef _schema, const std::string* _values)
+        : schema(_schema), values(_values) {}
+
+    const_iterator begin() const { return const_iterator(schema.begin(), values); }
+    const_iterator end() const { return const_iterator(schema.end(), values + schema.size()); }
+    size_t size() const { return schema.size(); }
+    DocumentSchemaRef getSchema() const { return schema; }
+    const std::string& operator[](size_t slot) const { return values[slot]; }
+
+    // Значение по имени поля; пустая строка, если такого поля нет
+    const std::string& at(std::string_view name) const {
+        static const std::string missing;
+        size_t slot = schema.find(name);
+        return slot == DocumentSchemaRef::npos ? missing : values[slot];
+    }
+};
+
+// Значения полей, заполняемые при загрузке содержимого документа
+class DocumentFieldSlots {
+private:
+    DocumentSchemaRef schema;
+    std::string* values = nullptr;
+
+public:
+    DocumentFieldSlots(DocumentSchemaRef _schema, std::string* _values)
+        : schema(_schema), values(_values) {}
+
+    // false - поля нет в схеме типа, значение пропускается
+    bool set(std::string_view name, std::string_view value) {
+        size_t slot = schema.find(name);
+        if (slot == DocumentSchemaRef::npos) return false;
+        values[slot].assign(value.data(), value.size());
+        return true;
+    }
+};
+
+#endif // DOCUMENT_SCHEMA_H
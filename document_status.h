@@ -0,0 +1,66 @@
+#ifndef DOCUMENT_STATUS_H
+#define DOCUMENT_STATUS_H
+
+#include "document_type.h"
+#include <string_view>
+#include <cstdint>
+
+// Жизненный цикл документа: черновик -> проведен -> отменен.
+// Черновик можно отменить, не проводя; из отмененного переходов нет.
+enum class DocumentStatus : uint8_t {
+    DRAFT,
+    POSTED,
+    CANCELLED
+};
+
+// Количество статусов (для массивов, индексируемых статусом)
+constexpr int DOCUMENT_STATUS_COUNT = 3;
+
+constexpr bool canTransition(DocumentStatus from, DocumentStatus to) {
+    switch(from) {
+        case DocumentStatus::DRAFT:
+            return to == DocumentStatus::POSTED || to == DocumentStatus::CANCELLED;
+        case DocumentStatus::POSTED:
+            return to == DocumentStatus::CANCELLED;
+        case DocumentStatus::CANCELLED:
+            return false;
+    }
+    return false;
+}
+
+// Подпись статуса в печатной форме и в окне; она же хранится в снимке,
+// сегментах документов и журнале
+constexpr std::string_view documentStatusLabel(DocumentType type, DocumentStatus status) {
+    switch(status) {
+        case DocumentStatus::DRAFT:
+            return "Черновик";
+        case DocumentStatus::POSTED:
+            switch(type) {
+                case DocumentType::RECEIPT: return "Продано";
+                case DocumentType::INCOME_INVOICE: return "Принято";
+                case DocumentType::OUTCOME_INVOICE: return "Отгружено";
+                case DocumentType::INVENTORY: return "Проведена";
+            }
+            break;
+        case DocumentStatus::CANCELLED:
+            switch(type) {
+                case DocumentType::RECEIPT: return "Отменен";
+                case DocumentType::INCOME_INVOICE: return "Отменена";
+                case DocumentType::OUTCOME_INVOICE: return "Отменена";
+                case DocumentType::INVENTORY: return "Отменен";
+            }
+            break;
+    }
+    return "";
+}
+
+// Статус по сохраненной подписи. Незнакомая подпись читается как черновик:
+// такой документ можно провести или отменить заново.
+constexpr DocumentStatus parseDocumentStatus(DocumentType type, std::string_view label) {
+    for (DocumentStatus status : {DocumentStatus::POSTED, DocumentStatus::CANCELLED}) {
+        if (documentStatusLabel(type, status) == label) return status;
+    }
+    return DocumentStatus::DRAFT;
+}
+
+#endif // DOCUMENT_STATUS_H
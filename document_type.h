@@ -1,6 +1,8 @@
 #ifndef DOCUMENT_TYPE_H
 #define DOCUMENT_TYPE_H
 
+#include <string_view>
+
 enum class DocumentType {
     RECEIPT,           
     INCOME_INVOICE,    
@@ -8,4 +10,18 @@ enum class DocumentType {
     INVENTORY          
 };
 
-#endif // DOCUMENT_TYPE_H
\ No newline at end of file
+// Количество типов документов (для массивов, индексируемых типом)
+constexpr int DOCUMENT_TYPE_COUNT = 4;
+
+// Название типа в печатной форме и отчетах
+constexpr std::string_view documentTypeName(DocumentType type) {
+    switch(type) {
+        case DocumentType::RECEIPT: return "ЧЕК";
+        case DocumentType::INCOME_INVOICE: return "НАКЛАДНАЯ ПРИХОДА";
+        case DocumentType::OUTCOME_INVOICE: return "НАКЛАДНАЯ РАСХОДА";
+        case DocumentType::INVENTORY: return "АКТ ИНВЕНТАРИЗАЦИИ";
+    }
+    return "ДОКУМЕНТ";
+}
+
+#endif // DOCUMENT_TYPE_H
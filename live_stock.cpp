@@ -0,0 +1,112 @@
+#include "live_stock.h"
+#include <cstring>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+LiveStockReader::~LiveStockReader() {
+    close();
+}
+
+bool LiveStockReader::fail(const string& message) {
+    error = message;
+    return false;
+}
+
+bool LiveStockReader::open(const string& _name) {
+    close();
+    name = _name;
+    return map();
+}
+
+void LiveStockReader::close() {
+    unmap();
+}
+
+#ifndef _WIN32
+
+bool LiveStockReader::map() {
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0) return fail("Витрина остатков " + name + " не опубликована");
+
+    struct stat info;
+    if (fstat(fd, &info) != 0 || static_cast<size_t>(info.st_size) < sizeof(LiveStockHeader)) {
+        ::close(fd);
+        return fail("Сегмент " + name + " еще не размечен");
+    }
+    void* data = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) return fail("Не удалось отобразить сегмент " + name);
+
+    const LiveStockHeader* candidate = static_cast<const LiveStockHeader*>(data);
+    size_t size = static_cast<size_t>(info.st_size);
+    if (memcmp(candidate->magic, LIVE_STOCK_MAGIC, sizeof(LIVE_STOCK_MAGIC)) != 0 ||
+        candidate->version != LIVE_STOCK_VERSION || candidate->fileSize != size ||
+        candidate->namesOffset + candidate->nameCapacity > size) {
+        munmap(data, size);
+        return fail("Сегмент " + name + " не является витриной остатков");
+    }
+
+    mapping = data;
+    mappingSize = size;
+    header = candidate;
+    return true;
+}
+
+void LiveStockReader::unmap() {
+    if (mapping) munmap(mapping, mappingSize);
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+#else
+
+bool LiveStockReader::map() {
+    return fail("Витрина остатков доступна только в POSIX-системах");
+}
+
+void LiveStockReader::unmap() {
+    header = nullptr;
+}
+
+#endif
+
+LiveStockView LiveStockReader::view() const {
+    const char* base = static_cast<const char*>(mapping);
+    LiveStockView result;
+    result.size = static_cast<size_t>(header->productCount);
+    result.ids = reinterpret_cast<const int32_t*>(base + header->idsOffset);
+    result.quantities = reinterpret_cast<const int32_t*>(base + header->quantitiesOffset);
+    result.prices = reinterpret_cast<const double*>(base + header->pricesOffset);
+    result.nameOffsets = reinterpret_cast<const uint32_t*>(base + header->nameOffsetsOffset);
+    result.nameLengths = reinterpret_cast<const uint32_t*>(base + header->nameLengthsOffset);
+    result.names = base + header->namesOffset;
+    result.nameCapacity = static_cast<size_t>(header->nameCapacity);
+    result.version = header->sequence.load(memory_order_relaxed);
+    result.updatedAt = header->updatedAt;
+    return result;
+}
+
+bool LiveStockReader::find(int id, LiveStockRow& row) {
+    bool found = false;
+    bool ok = read([&](const LiveStockView& view) {
+        found = false;
+        for (size_t slot = 0; slot < view.size; slot++) {
+            if (view.ids[slot] != id) continue;
+            row.id = id;
+            row.quantity = view.quantities[slot];
+            row.price = view.prices[slot];
+            row.name.assign(view.nameAt(slot));
+            found = true;
+            break;
+        }
+    });
+    return ok && found;
+}
@@ -0,0 +1,146 @@
+#ifndef LIVE_STOCK_H
+#define LIVE_STOCK_H
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <thread>
+#include <cstdint>
+#include <cstddef>
+
+// Живая витрина остатков в разделяемой памяти (POSIX shm).
+//
+// Склад (LiveStockPublisher) держит в сегменте копию таблицы товаров
+// колонками: id, количество, цена и смещение/длина наименования в общем
+// буфере. Внешние процессы (отчеты, печать этикеток) читают сегмент
+// напрямую, без копирования и без блокировок: согласованность обеспечивает
+// счетчик версий (seqlock). Запись делает счетчик нечетным, по окончании -
+// снова четным; читатель, увидевший нечетное значение или изменение счетчика
+// за время чтения, читает заново. Писатель читателей никогда не ждет.
+//
+// Когда сегмент переполняется, склад создает новый под тем же именем,
+// а старый помечает retired - читатель переоткрывает сегмент сам.
+
+constexpr char LIVE_STOCK_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'L', 'I', 'V'};
+constexpr uint32_t LIVE_STOCK_VERSION = 1;
+constexpr const char* LIVE_STOCK_DEFAULT_NAME = "/warehouse_stock";
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free,
+              "счетчик версий должен работать между процессами без блокировок");
+
+struct LiveStockHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    std::atomic<uint64_t> sequence;     // нечетный - идет запись
+    std::atomic<uint32_t> retired;      // сегмент заменен новым с тем же именем
+    int32_t writerPid;
+    int64_t updatedAt;                  // время последнего изменения (time_t)
+    uint64_t capacity;                  // строк, под которые размечены колонки
+    uint64_t nameCapacity;              // байт в буфере наименований
+    uint64_t productCount;
+    uint64_t nameBytes;                 // занято в буфере наименований
+    uint64_t idsOffset;                 // int32[capacity]
+    uint64_t quantitiesOffset;          // int32[capacity]
+    uint64_t pricesOffset;              // double[capacity]
+    uint64_t nameOffsetsOffset;         // uint32[capacity]
+    uint64_t nameLengthsOffset;         // uint32[capacity]
+    uint64_t namesOffset;               // char[nameCapacity]
+    uint64_t fileSize;
+};
+
+// Таблица товаров внутри сегмента; действительна только внутри LiveStockReader::read
+struct LiveStockView {
+    size_t size = 0;
+    const int32_t* ids = nullptr;
+    const int32_t* quantities = nullptr;
+    const double* prices = nullptr;
+    const uint32_t* nameOffsets = nullptr;
+    const uint32_t* nameLengths = nullptr;
+    const char* names = nullptr;
+    size_t nameCapacity = 0;
+    uint64_t version = 0;
+    int64_t updatedAt = 0;
+
+    // Во время повторяемого чтения смещение может оказаться недописанным:
+    // за границу буфера наименований чтение не выходит
+    std::string_view nameAt(size_t slot) const {
+        uint64_t offset = nameOffsets[slot];
+        uint64_t length = nameLengths[slot];
+        if (offset + length > nameCapacity) return std::string_view();
+        return std::string_view(names + offset, static_cast<size_t>(length));
+    }
+};
+
+// Строка, скопированная из сегмента (LiveStockReader::find)
+struct LiveStockRow {
+    int id = 0;
+    int quantity = 0;
+    double price = 0;
+    std::string name;
+};
+
+// Библиотека для внешних процессов: только чтение сегмента
+class LiveStockReader {
+public:
+    static constexpr int MAX_ATTEMPTS = 10000;
+
+    LiveStockReader() = default;
+    ~LiveStockReader();
+
+    LiveStockReader(const LiveStockReader&) = delete;
+    LiveStockReader& operator=(const LiveStockReader&) = delete;
+
+    bool open(const std::string& name = LIVE_STOCK_DEFAULT_NAME);
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    const std::string& getError() const { return error; }
+
+    // Вызывает visit(const LiveStockView&) над согласованным состоянием
+    // таблицы. Если во время обхода склад изменил таблицу, visit вызывается
+    // снова, поэтому он должен только читать и накапливать результат заново.
+    // false - согласованное состояние прочитать не удалось (склад завершился
+    // посреди записи или сегмент недоступен).
+    template<typename Visitor>
+    bool read(Visitor&& visit);
+
+    // Товар по id (линейный просмотр колонки id)
+    bool find(int id, LiveStockRow& row);
+
+private:
+    std::string name;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    const LiveStockHeader* header = nullptr;
+    std::string error;
+
+    bool map();
+    void unmap();
+    LiveStockView view() const;
+    bool fail(const std::string& message);
+};
+
+template<typename Visitor>
+bool LiveStockReader::read(Visitor&& visit) {
+    for (int attempt = 0; attempt < MAX_ATTEMPTS; attempt++) {
+        if (!header && !map()) return false;
+        if (header->retired.load(std::memory_order_acquire)) {
+            // Склад перешел на новый сегмент с тем же именем
+            unmap();
+            continue;
+        }
+
+        uint64_t before = header->sequence.load(std::memory_order_acquire);
+        if (before & 1) {
+            std::this_thread::yield();
+            continue;
+        }
+        LiveStockView current = view();
+        if (current.size <= header->capacity) visit(static_cast<const LiveStockView&>(current));
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (header->sequence.load(std::memory_order_relaxed) == before) return true;
+    }
+    return fail("Не удалось прочитать согласованное состояние: склад не завершил запись");
+}
+
+#endif // LIVE_STOCK_H
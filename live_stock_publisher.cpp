@@ -0,0 +1,235 @@
+#include "live_stock_publisher.h"
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+#include <ctime>
+#include <new>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+static uint64_t alignUp(uint64_t value, uint64_t alignment) {
+    return (value + alignment - 1) / alignment * alignment;
+}
+
+LiveStockPublisher::~LiveStockPublisher() {
+    close();
+}
+
+bool LiveStockPublisher::fail(const string& message) {
+    error = message;
+    return false;
+}
+
+bool LiveStockPublisher::open(const string& _name, const ProductStore& products) {
+    close();
+    name = _name;
+    error.clear();
+    return publishAll(products);
+}
+
+void LiveStockPublisher::close() {
+    release(true);
+}
+
+void LiveStockPublisher::beginUpdate() {
+    if (depth++ > 0 || !header) return;
+    uint64_t sequence = header->sequence.load(memory_order_relaxed);
+    header->sequence.store(sequence + 1, memory_order_relaxed);
+    // Строки меняются только после того, как читатели увидят нечетный счетчик
+    atomic_thread_fence(memory_order_release);
+}
+
+void LiveStockPublisher::endUpdate() {
+    if (--depth > 0 || !header) return;
+    header->updatedAt = static_cast<int64_t>(time(nullptr));
+    header->sequence.store(header->sequence.load(memory_order_relaxed) + 1, memory_order_release);
+}
+
+#ifndef _WIN32
+
+// Новый сегмент под тем же именем. Прежний остается отображенным: читатели,
+// которые его уже открыли, дочитывают старую таблицу, пока publishAll
+// не заполнит новую и не пометит прежний retired.
+bool LiveStockPublisher::create(size_t capacity, size_t nameCapacity) {
+    uint64_t headerSize = alignUp(sizeof(LiveStockHeader), 64);
+    uint64_t idsOffset = headerSize;
+    uint64_t quantitiesOffset = alignUp(idsOffset + capacity * sizeof(int32_t), 8);
+    uint64_t pricesOffset = alignUp(quantitiesOffset + capacity * sizeof(int32_t), 8);
+    uint64_t nameOffsetsOffset = pricesOffset + capacity * sizeof(double);
+    uint64_t nameLengthsOffset = alignUp(nameOffsetsOffset + capacity * sizeof(uint32_t), 8);
+    uint64_t namesOffset = alignUp(nameLengthsOffset + capacity * sizeof(uint32_t), 8);
+    uint64_t fileSize = namesOffset + nameCapacity;
+
+    shm_unlink(name.c_str());
+    int fd = shm_open(name.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    if (fd < 0) return fail("Не удалось создать сегмент " + name + ": " + strerror(errno));
+    if (ftruncate(fd, static_cast<off_t>(fileSize)) != 0) {
+        ::close(fd);
+        shm_unlink(name.c_str());
+        return fail("Не удалось выделить " + to_string(fileSize) + " байт для сегмента " + name);
+    }
+    void* data = mmap(nullptr, fileSize, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (data == MAP_FAILED) {
+        shm_unlink(name.c_str());
+        return fail("Не удалось отобразить сегмент " + name);
+    }
+
+    LiveStockHeader* created = new (data) LiveStockHeader();
+    created->version = LIVE_STOCK_VERSION;
+    created->headerSize = static_cast<uint32_t>(headerSize);
+    // Внутри beginUpdate новый сегмент сразу открыт для записи
+    created->sequence.store(depth > 0 ? 1 : 0, memory_order_relaxed);
+    created->writerPid = static_cast<int32_t>(getpid());
+    created->updatedAt = static_cast<int64_t>(time(nullptr));
+    created->capacity = capacity;
+    created->nameCapacity = nameCapacity;
+    created->idsOffset = idsOffset;
+    created->quantitiesOffset = quantitiesOffset;
+    created->pricesOffset = pricesOffset;
+    created->nameOffsetsOffset = nameOffsetsOffset;
+    created->nameLengthsOffset = nameLengthsOffset;
+    created->namesOffset = namesOffset;
+    created->fileSize = fileSize;
+    // Признак формата - последним: читатель не примет недоразмеченный сегмент
+    atomic_thread_fence(memory_order_release);
+    memcpy(created->magic, LIVE_STOCK_MAGIC, sizeof(LIVE_STOCK_MAGIC));
+
+    mapping = data;
+    mappingSize = fileSize;
+    header = created;
+    return true;
+}
+
+void LiveStockPublisher::release(bool unlink) {
+    if (!header) return;
+    header->retired.store(1, memory_order_release);
+    munmap(mapping, mappingSize);
+    if (unlink) shm_unlink(name.c_str());
+    mapping = nullptr;
+    mappingSize = 0;
+    header = nullptr;
+}
+
+#else
+
+bool LiveStockPublisher::create(size_t, size_t) {
+    return fail("Витрина остатков доступна только в POSIX-системах");
+}
+
+void LiveStockPublisher::release(bool) {
+    header = nullptr;
+}
+
+#endif
+
+bool LiveStockPublisher::publishAll(const ProductStore& products) {
+    size_t count = products.size();
+    size_t nameBytes = 0;
+    for (size_t slot = 0; slot < count; slot++) nameBytes += products.nameAt(slot).size();
+
+    beginUpdate();
+    void* previousMapping = mapping;
+    size_t previousSize = mappingSize;
+    LiveStockHeader* previous = header;
+    if (!header || count > header->capacity || nameBytes > header->nameCapacity) {
+        // Запас, чтобы добавление товаров не пересоздавало сегмент каждый раз
+        if (!create(max<size_t>(1024, count + count / 2),
+                    max<size_t>(64 * 1024, nameBytes + nameBytes / 2))) {
+            endUpdate();
+            release(false);
+            return false;
+        }
+    }
+
+    copy(products.idColumn().begin(), products.idColumn().end(), column<int32_t>(header->idsOffset));
+    copy(products.quantityColumn().begin(), products.quantityColumn().end(),
+         column<int32_t>(header->quantitiesOffset));
+    copy(products.priceColumn().begin(), products.priceColumn().end(),
+         column<double>(header->pricesOffset));
+    uint32_t* offsets = column<uint32_t>(header->nameOffsetsOffset);
+    uint32_t* lengths = column<uint32_t>(header->nameLengthsOffset);
+    char* names = column<char>(header->namesOffset);
+    uint64_t position = 0;
+    for (size_t slot = 0; slot < count; slot++) {
+        string_view productName = products.nameAt(slot);
+        memcpy(names + position, productName.data(), productName.size());
+        offsets[slot] = static_cast<uint32_t>(position);
+        lengths[slot] = static_cast<uint32_t>(productName.size());
+        position += productName.size();
+    }
+    header->productCount = count;
+    header->nameBytes = position;
+
+#ifndef _WIN32
+    if (previous && previous != header) {
+        previous->retired.store(1, memory_order_release);
+        munmap(previousMapping, previousSize);
+    }
+#endif
+    endUpdate();
+    return true;
+}
+
+void LiveStockPublisher::writeRow(size_t slot, int id, int quantity, double price,
+                                  string_view productName) {
+    column<int32_t>(header->idsOffset)[slot] = id;
+    column<int32_t>(header->quantitiesOffset)[slot] = quantity;
+    column<double>(header->pricesOffset)[slot] = price;
+    memcpy(column<char>(header->namesOffset) + header->nameBytes, productName.data(),
+           productName.size());
+    column<uint32_t>(header->nameOffsetsOffset)[slot] = static_cast<uint32_t>(header->nameBytes);
+    column<uint32_t>(header->nameLengthsOffset)[slot] = static_cast<uint32_t>(productName.size());
+    header->nameBytes += productName.size();
+}
+
+void LiveStockPublisher::setQuantity(size_t slot, int quantity) {
+    if (!header) return;
+    beginUpdate();
+    column<int32_t>(header->quantitiesOffset)[slot] = quantity;
+    endUpdate();
+}
+
+void LiveStockPublisher::append(const ProductStore& products, size_t slot) {
+    if (!header) return;
+    string_view productName = products.nameAt(slot);
+    if (slot != header->productCount || slot >= header->capacity ||
+        header->nameBytes + productName.size() > header->nameCapacity) {
+        // Место кончилось (или в буфере наименований много удаленных) -
+        // публикуем таблицу заново, при необходимости в новом сегменте
+        publishAll(products);
+        return;
+    }
+    beginUpdate();
+    writeRow(slot, products.idAt(slot), products.quantityAt(slot), products.priceAt(slot),
+             productName);
+    header->productCount = slot + 1;
+    endUpdate();
+}
+
+void LiveStockPublisher::remove(size_t slot) {
+    if (!header || slot >= header->productCount) return;
+    beginUpdate();
+    size_t last = header->productCount - 1;
+    if (slot != last) {
+        int32_t* ids = column<int32_t>(header->idsOffset);
+        int32_t* quantities = column<int32_t>(header->quantitiesOffset);
+        double* prices = column<double>(header->pricesOffset);
+        uint32_t* offsets = column<uint32_t>(header->nameOffsetsOffset);
+        uint32_t* lengths = column<uint32_t>(header->nameLengthsOffset);
+        ids[slot] = ids[last];
+        quantities[slot] = quantities[last];
+        prices[slot] = prices[last];
+        offsets[slot] = offsets[last];
+        lengths[slot] = lengths[last];
+    }
+    header->productCount = last;
+    endUpdate();
+}
@@ -0,0 +1,66 @@
+#ifndef LIVE_STOCK_PUBLISHER_H
+#define LIVE_STOCK_PUBLISHER_H
+
+#include "live_stock.h"
+#include "product_store.h"
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+// Сторона склада для живой витрины остатков (см. live_stock.h).
+// Повторяет изменения ProductStore в сегменте разделяемой памяти: позиции
+// строк в сегменте совпадают с позициями в хранилище, удаление так же
+// переносит последнюю строку на место удаленной.
+// Пока витрина не открыта, изменения ничего не делают.
+// Не потокобезопасен: Warehouse вызывает его под stockMutex.
+class LiveStockPublisher {
+public:
+    LiveStockPublisher() = default;
+    ~LiveStockPublisher();
+
+    LiveStockPublisher(const LiveStockPublisher&) = delete;
+    LiveStockPublisher& operator=(const LiveStockPublisher&) = delete;
+
+    // Создает сегмент name (существующий с тем же именем заменяется)
+    // и публикует в нем products целиком
+    bool open(const std::string& name, const ProductStore& products);
+    // Удаляет сегмент; открытые читатели увидят, что витрина снята
+    void close();
+    bool isOpen() const { return header != nullptr; }
+    const std::string& getName() const { return name; }
+    const std::string& getError() const { return error; }
+
+    // Несколько изменений, которые читатели должны увидеть одновременно
+    // (например, проведение документа), заключаются в beginUpdate/endUpdate.
+    // Вложенные пары допустимы. Отдельные изменения ниже сами образуют такую пару.
+    void beginUpdate();
+    void endUpdate();
+
+    // Таблица целиком - после загрузки, импорта или переполнения сегмента
+    bool publishAll(const ProductStore& products);
+    void setQuantity(size_t slot, int quantity);
+    // Строка, только что добавленная в products на позицию slot
+    void append(const ProductStore& products, size_t slot);
+    // Строка, удаленная из хранилища (на ее место перенесена последняя)
+    void remove(size_t slot);
+
+private:
+    std::string name;
+    void* mapping = nullptr;
+    size_t mappingSize = 0;
+    LiveStockHeader* header = nullptr;
+    int depth = 0;
+    std::string error;
+
+    bool create(size_t capacity, size_t nameCapacity);
+    void release(bool unlink);
+    bool fail(const std::string& message);
+
+    template<typename T>
+    T* column(uint64_t offset) {
+        return reinterpret_cast<T*>(static_cast<char*>(mapping) + offset);
+    }
+    void writeRow(size_t slot, int id, int quantity, double price, std::string_view productName);
+};
+
+#endif // LIVE_STOCK_PUBLISHER_H
@@ -1,18 +1,39 @@
 #include "mainwindow.h"
+#include "startup_profile.h"
 #include <QApplication>
 #include <QStyleFactory>
+#include <QTimer>
+#include <iostream>
+#include <cstdlib>
+#include <string>
 
 int main(int argc, char *argv[])
 {
+    // Отсчет времени запуска начинается здесь
+    StartupProfile& profile = StartupProfile::instance();
     QApplication app(argc, argv);
     
     // Устанавливаем стиль Fusion для лучшего вида
     QApplication::setStyle(QStyleFactory::create("Fusion"));
+    profile.mark("app");
     
     MainWindow window;
     window.setWindowTitle("Складская система - Рабочее место");
     window.resize(1200, 800);
     window.show();
     
+    // Первый проход цикла событий: окно отрисовано и принимает ввод.
+    // Замер выводится и пишется в журнал запусков, только если путь
+    // к журналу задан переменной окружения SKLAD_STARTUP_LOG.
+    const char* startupLog = std::getenv("SKLAD_STARTUP_LOG");
+    if (startupLog && *startupLog) {
+        std::string logPath = startupLog;
+        QTimer::singleShot(0, [&profile, logPath]() {
+            profile.mark("show");
+            std::cout << "Запуск: " << profile.summary() << std::endl;
+            profile.appendToLog(logPath);
+        });
+    }
+    
     return app.exec();
 }
\ No newline at end of file
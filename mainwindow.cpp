@@ -2,6 +2,7 @@
 #include "warehouse.h"
 #include "document.h"
 #include "document_type.h"
+#include "startup_profile.h"
 #include <QDateTime>
 #include <QInputDialog>
 #include <QFile>
@@ -12,25 +13,72 @@
 #include <QVBoxLayout>
 #include <QFrame>
 #include <QFont>
+#include <QSignalBlocker>
 #include <QMenuBar>  // Добавьте эту строку
 #include <iostream>
 #include <ctime>
+#include <string_view>
+#include <algorithm>
+
+// Наименования в ProductStore хранятся как UTF-8 без копии в std::string
+static QString toQString(std::string_view text) {
+    return QString::fromUtf8(text.data(), static_cast<int>(text.size()));
+}
 
 MainWindow::MainWindow(QWidget *parent)
     : QMainWindow(parent)
 {
+    StartupProfile& profile = StartupProfile::instance();
     setupUI();
     setupMenu();
     
     setWindowTitle("Складская система управления - Рабочее место складского работника");
     resize(1200, 800);
-    
-    // Инициализация
+    profile.mark("ui");
+    
+    // Уведомления о пересечении порога дозаказа
+    warehouse.subscribeReorder([this](const ReorderEvent& event) {
+        QString message = event.belowThreshold
+            ? QString("Товар ID %1: остаток %2 шт. ниже порога дозаказа (%3 шт.)")
+            : QString("Товар ID %1: остаток %2 шт. восстановлен (порог %3 шт.)");
+        statusBar()->showMessage(message.arg(event.productId)
+                                        .arg(event.newQuantity)
+                                        .arg(event.threshold), 10000);
+    });
+    
+    // Снимок и журнал изменений: состояние на момент закрытия или сбоя
+    if (!warehouse.openStorage()) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось открыть хранилище данных склада");
+    }
+    profile.mark("storage");
+    
+    // Снимок пишется в фоне, окно остается доступным
+    saveController = new AsyncSaveController(warehouse, this);
+    connect(saveController, &AsyncSaveController::started, this, [this]() {
+        saveAction->setEnabled(false);
+        saveProgressBar->setValue(0);
+        saveProgressBar->show();
+    });
+    connect(saveController, &AsyncSaveController::progress, saveProgressBar, &QProgressBar::setValue);
+    connect(saveController, &AsyncSaveController::finished, this, &MainWindow::saveFinished);
+    
+    // Выгрузка остатков тоже идет в фоне; кнопка экспорта на это время - отмена
+    exportController = new StockExportController(warehouse, this);
+    connect(exportController, &StockExportController::started, this, [this]() {
+        exportStockButton->setText("Отменить экспорт");
+        exportProgressBar->setValue(0);
+        exportProgressBar->show();
+    });
+    connect(exportController, &StockExportController::progress, exportProgressBar, &QProgressBar::setValue);
+    connect(exportController, &StockExportController::finished, this, &MainWindow::exportFinished);
+    
+    // Таблицы скрытых вкладок заполняются при первом показе: документы
+    // снимка до этого не разбираются
+    connect(tabWidget, &QTabWidget::currentChanged, this, &MainWindow::onTabChanged);
     refreshStockTable();
+    refreshDocumentsTable();
     updateStatusBar();
-    
-    // Тестовые данные
-    warehouse.printStockReport();
+    profile.mark("tables");
 }
 
 MainWindow::~MainWindow()
@@ -67,6 +115,18 @@ void MainWindow::setupUI() {
     // Статус бар
     statusLabel = new QLabel(this);
     statusBar()->addWidget(statusLabel);
+    saveProgressBar = new QProgressBar(this);
+    saveProgressBar->setRange(0, 100);
+    saveProgressBar->setMaximumWidth(200);
+    saveProgressBar->setFormat("Сохранение: %p%");
+    saveProgressBar->hide();
+    statusBar()->addPermanentWidget(saveProgressBar);
+    exportProgressBar = new QProgressBar(this);
+    exportProgressBar->setRange(0, 100);
+    exportProgressBar->setMaximumWidth(200);
+    exportProgressBar->setFormat("Экспорт: %p%");
+    exportProgressBar->hide();
+    statusBar()->addPermanentWidget(exportProgressBar);
     updateStatusBar();
 }
 
@@ -90,6 +150,37 @@ void MainWindow::setupMenu() {
     
     fileMenu->addSeparator();
     
+    exportCsvAction = new QAction("Экспорт каталога в CSV...", this);
+    connect(exportCsvAction, &QAction::triggered, this, &MainWindow::exportCsv);
+    fileMenu->addAction(exportCsvAction);
+    
+    importCsvAction = new QAction("Импорт каталога из CSV...", this);
+    connect(importCsvAction, &QAction::triggered, this, &MainWindow::importCsv);
+    fileMenu->addAction(importCsvAction);
+    
+    exportDocumentsAction = new QAction("Выгрузить документы в архив...", this);
+    connect(exportDocumentsAction, &QAction::triggered, this, &MainWindow::exportDocuments);
+    fileMenu->addAction(exportDocumentsAction);
+    
+    exportAnalyticsAction = new QAction("Выгрузить для аналитики...", this);
+    connect(exportAnalyticsAction, &QAction::triggered, this, &MainWindow::exportAnalytics);
+    fileMenu->addAction(exportAnalyticsAction);
+    
+    exportChangesAction = new QAction("Выгрузить изменения для зеркала...", this);
+    connect(exportChangesAction, &QAction::triggered, this, &MainWindow::exportChanges);
+    fileMenu->addAction(exportChangesAction);
+    
+    importChangesAction = new QAction("Применить пакет изменений...", this);
+    connect(importChangesAction, &QAction::triggered, this, &MainWindow::importChanges);
+    fileMenu->addAction(importChangesAction);
+    
+    liveViewAction = new QAction("Публиковать остатки для других программ", this);
+    liveViewAction->setCheckable(true);
+    connect(liveViewAction, &QAction::toggled, this, &MainWindow::toggleLiveView);
+    fileMenu->addAction(liveViewAction);
+    
+    fileMenu->addSeparator();
+    
     exitAction = new QAction("Выход", this);
     exitAction->setShortcut(QKeySequence::Quit);
     connect(exitAction, &QAction::triggered, this, &QMainWindow::close);
@@ -180,6 +271,8 @@ void MainWindow::setupDocumentsTab() {
     docTypeFilter->addItem("Накладные прихода");
     docTypeFilter->addItem("Накладные расхода");
     docTypeFilter->addItem("Акты инвентаризации");
+    connect(docTypeFilter, QOverload<int>::of(&QComboBox::currentIndexChanged),
+            this, &MainWindow::refreshDocumentsTable);
     toolbarLayout->addWidget(docTypeFilter);
     
     refreshDocsButton = new QPushButton("Обновить", this);
@@ -384,6 +477,11 @@ void MainWindow::setupReportsTab() {
 }
 
 void MainWindow::refreshStockTable() {
+    if (!tabWidget->currentWidget()->isAncestorOf(stockTable)) {
+        stockTableStale = true;
+        return;
+    }
+    stockTableStale = false;
     stockTable->setRowCount(0);
     const auto& products = warehouse.getAllProducts();
     
@@ -391,13 +489,13 @@ void MainWindow::refreshStockTable() {
         int row = stockTable->rowCount();
         stockTable->insertRow(row);
         
-        stockTable->setItem(row, 0, new QTableWidgetItem(QString::number(product->getId())));
-        stockTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(product->getName())));
-        stockTable->setItem(row, 2, new QTableWidgetItem(QString::number(product->getQuantity())));
+        stockTable->setItem(row, 0, new QTableWidgetItem(QString::number(product.getId())));
+        stockTable->setItem(row, 1, new QTableWidgetItem(toQString(product.getName())));
+        stockTable->setItem(row, 2, new QTableWidgetItem(QString::number(product.getQuantity())));
         stockTable->setItem(row, 3, new QTableWidgetItem("шт."));
-        stockTable->setItem(row, 4, new QTableWidgetItem(QString::number(product->getPrice(), 'f', 2)));
+        stockTable->setItem(row, 4, new QTableWidgetItem(QString::number(product.getPrice(), 'f', 2)));
         
-        double total = product->getPrice() * product->getQuantity();
+        double total = product.getTotalValue();
         stockTable->setItem(row, 5, new QTableWidgetItem(QString::number(total, 'f', 2)));
     }
     
@@ -510,39 +608,71 @@ void MainWindow::updateStockQuantity() {
 }
 
 void MainWindow::showLowStockReport() {
-    warehouse.printLowStockReport();
-    QMessageBox::information(this, "Низкий остаток", 
-        "Отчет сгенерирован. Проверьте консоль для просмотра.");
+    const int threshold = 5;
+    std::vector<int> lowStock = warehouse.getLowStockProductIds(threshold);
+    if (lowStock.empty()) {
+        QMessageBox::information(this, "Низкий остаток", "Нет товаров с низким остатком");
+        return;
+    }
+    
+    QString report = QString("Товары с остатком меньше %1 шт.:\n\n").arg(threshold);
+    for (int id : lowStock) {
+        auto product = warehouse.getProductById(id);
+        report += QString("ID %1 | %2 | %3 шт.\n")
+            .arg(id)
+            .arg(QString::fromStdString(product->getName()))
+            .arg(product->getQuantity());
+    }
+    QMessageBox::information(this, "Низкий остаток", report);
 }
 
 void MainWindow::exportStockReport() {
+    if (exportController->isRunning()) {
+        exportController->cancel();
+        return;
+    }
+    
+    // Порядок фильтров совпадает с StockExportFormat
+    const QStringList filters = {"Текстовый отчет (*.txt)", "CSV файлы (*.csv)",
+                                 "JSON Lines (*.jsonl)"};
+    const StockExportFormat formats[] = {StockExportFormat::FIXED_WIDTH, StockExportFormat::CSV,
+                                         StockExportFormat::JSON_LINES};
+    QString selectedFilter = filters[0];
     QString filename = QFileDialog::getSaveFileName(this, "Экспорт отчета", 
                                                    "stock_report.txt", 
-                                                   "Текстовые файлы (*.txt)");
+                                                   filters.join(";;"), &selectedFilter);
     if (filename.isEmpty()) return;
     
-    QFile file(filename);
-    if (file.open(QIODevice::WriteOnly | QIODevice::Text)) {
-        QTextStream out(&file);
-        out << "ОТЧЕТ ПО СКЛАДУ\n";
-        out << "Дата: " << QDateTime::currentDateTime().toString("dd.MM.yyyy HH:mm") << "\n";
-        out << "========================================\n\n";
-        
-        const auto& products = warehouse.getAllProducts();
-        for (const auto& product : products) {
-            out << QString::fromStdString(product->getName()) << "\t"
-                << product->getQuantity() << " шт.\t"
-                << QString::number(product->getPrice(), 'f', 2) << " руб.\n";
-        }
-        
-        file.close();
-        QMessageBox::information(this, "Успех", "Отчет экспортирован в файл");
+    StockExportFormat format = formats[std::max<qsizetype>(filters.indexOf(selectedFilter), 0)];
+    exportController->start(filename, format);
+}
+
+void MainWindow::exportFinished(bool success, bool cancelled, qint64 rows, qint64 elapsedMs) {
+    exportProgressBar->hide();
+    exportStockButton->setText("Экспорт");
+    if (success) {
+        statusBar()->showMessage(QString("Экспортировано товаров: %1 за %2 мс").arg(rows).arg(elapsedMs), 5000);
+    } else if (cancelled) {
+        statusBar()->showMessage("Экспорт отменен", 5000);
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+                             QString("Не удалось экспортировать отчет:\n%1").arg(exportController->errorString()));
     }
 }
 
 void MainWindow::refreshDocumentsTable() {
+    if (!tabWidget->currentWidget()->isAncestorOf(documentsTable)) {
+        documentsTableStale = true;
+        return;
+    }
+    documentsTableStale = false;
     documentsTable->setRowCount(0);
-    const auto& docs = warehouse.getAllDocuments();
+    
+    // Пункты фильтра идут в порядке DocumentType, 0 - все документы
+    int filterIndex = docTypeFilter->currentIndex();
+    const auto& docs = filterIndex > 0
+        ? warehouse.getDocumentsByType(static_cast<DocumentType>(filterIndex - 1))
+        : warehouse.getAllDocuments();
     
     for (const auto& doc : docs) {
         int row = documentsTable->rowCount();
@@ -559,7 +689,7 @@ void MainWindow::refreshDocumentsTable() {
         std::strftime(dateBuffer, sizeof(dateBuffer), "%d.%m.%Y %H:%M", tm_info);
         documentsTable->setItem(row, 3, new QTableWidgetItem(QString(dateBuffer)));
         
-        documentsTable->setItem(row, 4, new QTableWidgetItem(QString::fromStdString(doc->getStatus())));
+        documentsTable->setItem(row, 4, new QTableWidgetItem(toQString(doc->getStatusLabel())));
         documentsTable->setItem(row, 5, new QTableWidgetItem("Складской работник"));
     }
     
@@ -589,7 +719,7 @@ void MainWindow::showDocumentDetails(int docId) {
     QString details;
     details += "=== " + QString::fromStdString(doc->getTypeName()) + " ===\n";
     details += "Номер: " + QString::fromStdString(doc->getNumber()) + "\n";
-    details += "Статус: " + QString::fromStdString(doc->getStatus()) + "\n";
+    details += "Статус: " + toQString(doc->getStatusLabel()) + "\n";
     
     // Исправляем localtime
     time_t docTime = doc->getDate();
@@ -598,6 +728,26 @@ void MainWindow::showDocumentDetails(int docId) {
     std::strftime(dateBuffer, sizeof(dateBuffer), "%d.%m.%Y %H:%M", tm_info);
     details += "Дата: " + QString(dateBuffer) + "\n";
     
+    // Строки читаются на месте; в окно попадают первые, итог - по всем
+    constexpr size_t shownItems = 50;
+    DocumentItemView items = doc->getItemView();
+    double total = 0.0;
+    details += QString("\nПозиции (%1):\n").arg(items.size());
+    for (size_t i = 0; i < items.size(); i++) {
+        const DocumentLine& item = items[i];
+        total += item.total();
+        if (i >= shownItems) continue;
+        details += QString("  %1 × %2").arg(toQString(item.productName())).arg(item.quantity);
+        if (item.comment != DocumentLine::NO_COMMENT) {
+            details += " (" + toQString(items.commentOf(item)) + ")";
+        }
+        details += "\n";
+    }
+    if (items.size() > shownItems) {
+        details += QString("  ... и еще %1\n").arg(items.size() - shownItems);
+    }
+    details += QString("Итого: %1 руб.\n").arg(total, 0, 'f', 2);
+    
     QMessageBox::information(this, "Просмотр документа", details);
 }
 
@@ -611,11 +761,16 @@ void MainWindow::processDocument() {
     int row = selected.first()->row();
     int docId = documentsTable->item(row, 0)->text().toInt();
     
-    if (warehouse.processDocument(docId)) {
+    PostingResult result = warehouse.postDocument(docId);
+    if (result.success) {
         refreshDocumentsTable();
-        QMessageBox::information(this, "Успех", "Документ проведен");
+        refreshStockTable();
+        updateStatusBar();
+        QMessageBox::information(this, "Успех", 
+            QString("Документ проведен\nИзменено позиций: %1").arg(result.changedProducts));
     } else {
-        QMessageBox::warning(this, "Ошибка", "Не удалось провести документ");
+        QMessageBox::warning(this, "Ошибка", 
+            "Не удалось провести документ:\n" + QString::fromStdString(result.error));
     }
 }
 
@@ -636,9 +791,15 @@ void MainWindow::cancelDocument() {
                                  QMessageBox::Yes | QMessageBox::No);
     
     if (reply == QMessageBox::Yes) {
-        if (warehouse.cancelDocument(docId)) {
+        PostingResult result = warehouse.cancelDocument(docId);
+        if (result.success) {
             refreshDocumentsTable();
+            refreshStockTable();
+            updateStatusBar();
             QMessageBox::information(this, "Успех", "Документ отменен");
+        } else {
+            QMessageBox::warning(this, "Ошибка",
+                "Не удалось отменить документ:\n" + QString::fromStdString(result.error));
         }
     }
 }
@@ -652,56 +813,17 @@ void MainWindow::exportDocumentsReport() {
 }
 
 void MainWindow::onDocumentTypeChanged(int index) {
+    // Поля и начальные значения берутся из схемы типа (порядок в списке = DocumentType)
     specificFieldsTable->setRowCount(0);
-    
-    switch(index) {
-        case 0: // Чек
-            specificFieldsTable->setRowCount(4);
-            specificFieldsTable->setItem(0, 0, new QTableWidgetItem("Сотрудник"));
-            specificFieldsTable->setItem(0, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(1, 0, new QTableWidgetItem("Смена"));
-            specificFieldsTable->setItem(1, 1, new QTableWidgetItem("Дневная"));
-            specificFieldsTable->setItem(2, 0, new QTableWidgetItem("Номер заказа"));
-            specificFieldsTable->setItem(2, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(3, 0, new QTableWidgetItem("Тип оплаты"));
-            specificFieldsTable->setItem(3, 1, new QTableWidgetItem("Наличные"));
-            break;
-            
-        case 1: // Накладная прихода
-            specificFieldsTable->setRowCount(4);
-            specificFieldsTable->setItem(0, 0, new QTableWidgetItem("Поставщик"));
-            specificFieldsTable->setItem(0, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(1, 0, new QTableWidgetItem("Договор"));
-            specificFieldsTable->setItem(1, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(2, 0, new QTableWidgetItem("Счет-фактура"));
-            specificFieldsTable->setItem(2, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(3, 0, new QTableWidgetItem("Склад приемки"));
-            specificFieldsTable->setItem(3, 1, new QTableWidgetItem("Основной"));
-            break;
-            
-        case 2: // Накладная расхода
-            specificFieldsTable->setRowCount(4);
-            specificFieldsTable->setItem(0, 0, new QTableWidgetItem("Получатель"));
-            specificFieldsTable->setItem(0, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(1, 0, new QTableWidgetItem("Основание"));
-            specificFieldsTable->setItem(1, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(2, 0, new QTableWidgetItem("Склад отгрузки"));
-            specificFieldsTable->setItem(2, 1, new QTableWidgetItem("Основной"));
-            specificFieldsTable->setItem(3, 0, new QTableWidgetItem("Транспорт"));
-            specificFieldsTable->setItem(3, 1, new QTableWidgetItem(""));
-            break;
-            
-        case 3: // Акт инвентаризации
-            specificFieldsTable->setRowCount(4);
-            specificFieldsTable->setItem(0, 0, new QTableWidgetItem("Комиссия"));
-            specificFieldsTable->setItem(0, 1, new QTableWidgetItem(""));
-            specificFieldsTable->setItem(1, 0, new QTableWidgetItem("Склад"));
-            specificFieldsTable->setItem(1, 1, new QTableWidgetItem("Основной"));
-            specificFieldsTable->setItem(2, 0, new QTableWidgetItem("Причина"));
-            specificFieldsTable->setItem(2, 1, new QTableWidgetItem("Плановая инвентаризация"));
-            specificFieldsTable->setItem(3, 0, new QTableWidgetItem("Результат"));
-            specificFieldsTable->setItem(3, 1, new QTableWidgetItem("Не проведена"));
-            break;
+    if (index >= 0 && index < DOCUMENT_TYPE_COUNT) {
+        DocumentSchemaRef schema = documentSchema(static_cast<DocumentType>(index));
+        specificFieldsTable->setRowCount(static_cast<int>(schema.size()));
+        for (size_t slot = 0; slot < schema.size(); slot++) {
+            const DocumentFieldSpec& field = schema[slot];
+            int row = static_cast<int>(slot);
+            specificFieldsTable->setItem(row, 0, new QTableWidgetItem(toQString(field.name)));
+            specificFieldsTable->setItem(row, 1, new QTableWidgetItem(toQString(field.defaultValue)));
+        }
     }
     
     // Обновляем таблицу доступных товаров
@@ -712,10 +834,10 @@ void MainWindow::onDocumentTypeChanged(int index) {
         int row = availableProductsTable->rowCount();
         availableProductsTable->insertRow(row);
         
-        availableProductsTable->setItem(row, 0, new QTableWidgetItem(QString::number(product->getId())));
-        availableProductsTable->setItem(row, 1, new QTableWidgetItem(QString::fromStdString(product->getName())));
-        availableProductsTable->setItem(row, 2, new QTableWidgetItem(QString::number(product->getPrice(), 'f', 2)));
-        availableProductsTable->setItem(row, 3, new QTableWidgetItem(QString::number(product->getQuantity())));
+        availableProductsTable->setItem(row, 0, new QTableWidgetItem(QString::number(product.getId())));
+        availableProductsTable->setItem(row, 1, new QTableWidgetItem(toQString(product.getName())));
+        availableProductsTable->setItem(row, 2, new QTableWidgetItem(QString::number(product.getPrice(), 'f', 2)));
+        availableProductsTable->setItem(row, 3, new QTableWidgetItem(QString::number(product.getQuantity())));
     }
     
     availableProductsTable->resizeColumnsToContents();
@@ -745,7 +867,11 @@ void MainWindow::addItemToDocument() {
     int docRow = docItemsTable->rowCount();
     docItemsTable->insertRow(docRow);
     
-    docItemsTable->setItem(docRow, 0, new QTableWidgetItem(productName));
+    // id товара и комментарий строки нужны при сохранении документа
+    QTableWidgetItem *productItem = new QTableWidgetItem(productName);
+    productItem->setData(Qt::UserRole, productId);
+    productItem->setData(Qt::UserRole + 1, itemCommentEdit->text());
+    docItemsTable->setItem(docRow, 0, productItem);
     docItemsTable->setItem(docRow, 1, new QTableWidgetItem(QString::number(quantity)));
     docItemsTable->setItem(docRow, 2, new QTableWidgetItem(QString::number(price, 'f', 2)));
     
@@ -827,7 +953,15 @@ void MainWindow::saveDocument() {
     for (int i = 0; i < specificFieldsTable->rowCount(); i++) {
         QString fieldName = specificFieldsTable->item(i, 0)->text();
         QString fieldValue = specificFieldsTable->item(i, 1)->text();
-        doc->setSpecificField(fieldName.toStdString(), fieldValue.toStdString());
+        warehouse.setDocumentField(doc->getId(), fieldName.toStdString(), fieldValue.toStdString());
+    }
+    
+    // Переносим строки документа
+    for (int i = 0; i < docItemsTable->rowCount(); i++) {
+        QTableWidgetItem *productItem = docItemsTable->item(i, 0);
+        warehouse.addDocumentItem(doc->getId(), productItem->data(Qt::UserRole).toInt(),
+                                  docItemsTable->item(i, 1)->text().toInt(),
+                                  productItem->data(Qt::UserRole + 1).toString().toStdString());
     }
     
     // Сохраняем документ в файл
@@ -855,14 +989,14 @@ void MainWindow::generateStockReport() {
     double totalValue = 0;
     
     for (const auto& product : products) {
-        double value = product->getPrice() * product->getQuantity();
-        totalQty += product->getQuantity();
+        double value = product.getTotalValue();
+        totalQty += product.getQuantity();
         totalValue += value;
         
         report += QString("%1 | %2 шт. | %3 руб. | %4 руб.\n")
-            .arg(QString::fromStdString(product->getName()).left(30))
-            .arg(product->getQuantity(), 6)
-            .arg(product->getPrice(), 10, 'f', 2)
+            .arg(toQString(product.getName()).left(30))
+            .arg(product.getQuantity(), 6)
+            .arg(product.getPrice(), 10, 'f', 2)
             .arg(value, 12, 'f', 2);
     }
     
@@ -881,7 +1015,36 @@ void MainWindow::generateMovementReport() {
     report += "Период: " + QDate::currentDate().addDays(-30).toString("dd.MM.yyyy") + 
               " - " + QDate::currentDate().toString("dd.MM.yyyy") + "\n";
     report += "========================================\n\n";
-    report += "Отчет в разработке...\n";
+    
+    time_t to = QDateTime::currentSecsSinceEpoch() + 1;
+    time_t from = QDateTime(QDate::currentDate().addDays(-30), QTime(0, 0)).toSecsSinceEpoch();
+    std::vector<MovementSummary> movements = warehouse.getMovementSummary(from, to);
+    
+    if (movements.empty()) {
+        report += "За период движений не было\n";
+    }
+    
+    long long totalIncoming = 0;
+    long long totalOutgoing = 0;
+    for (const auto& movement : movements) {
+        auto product = warehouse.getProductById(movement.productId);
+        QString name = product ? QString::fromStdString(product->getName())
+                               : QString("Удаленный товар ID %1").arg(movement.productId);
+        totalIncoming += movement.incoming;
+        totalOutgoing += movement.outgoing;
+        
+        report += QString("%1 | Приход: %2 | Расход: %3 | Итог: %4 | Операций: %5\n")
+            .arg(name.left(30), -30)
+            .arg(movement.incoming, 8)
+            .arg(movement.outgoing, 8)
+            .arg(movement.incoming - movement.outgoing, 8)
+            .arg(movement.operations);
+    }
+    
+    report += "\n========================================\n";
+    report += QString("Всего приход: %1 шт. | Всего расход: %2 шт.\n")
+        .arg(totalIncoming)
+        .arg(totalOutgoing);
     
     reportText->setText(report);
     tabWidget->setCurrentIndex(3);
@@ -893,10 +1056,23 @@ void MainWindow::generateDocumentsReport() {
     report += "Дата: " + QDateTime::currentDateTime().toString("dd.MM.yyyy HH:mm") + "\n";
     report += "========================================\n\n";
     
-    const auto& docs = warehouse.getAllDocuments();
-    report += QString("Всего документов: %1\n\n").arg(docs.size());
+    // Итоги по типам и статусам считаются одним проходом без виртуальных вызовов
+    DocumentSummary summary = warehouse.summarizeDocuments();
+    report += QString("Всего документов: %1\n").arg(summary.documents);
+    for (int type = 0; type < DOCUMENT_TYPE_COUNT; type++) {
+        const DocumentTypeTotals& totals = summary.types[type];
+        if (totals.documents == 0) continue;
+        report += QString("  %1: %2 шт. (черновиков %3, проведено %4, отменено %5), на сумму %6 руб.\n")
+            .arg(toQString(documentTypeName(static_cast<DocumentType>(type))))
+            .arg(totals.documents)
+            .arg(totals.byStatus[static_cast<size_t>(DocumentStatus::DRAFT)])
+            .arg(totals.byStatus[static_cast<size_t>(DocumentStatus::POSTED)])
+            .arg(totals.byStatus[static_cast<size_t>(DocumentStatus::CANCELLED)])
+            .arg(totals.amount, 0, 'f', 2);
+    }
+    report += "\n";
     
-    for (const auto& doc : docs) {
+    for (const auto& doc : warehouse.getAllDocuments()) {
         // Исправляем localtime
         time_t docTime = doc->getDate();
         std::tm* tm_info = std::localtime(&docTime);
@@ -907,16 +1083,23 @@ void MainWindow::generateDocumentsReport() {
             .arg(QString::fromStdString(doc->getTypeName()), 25)
             .arg(QString::fromStdString(doc->getNumber()), 15)
             .arg(QString(dateBuffer), 12)
-            .arg(QString::fromStdString(doc->getStatus()));
+            .arg(toQString(doc->getStatusLabel()));
     }
     
     reportText->setText(report);
     tabWidget->setCurrentIndex(3);
 }
 
+void MainWindow::onTabChanged(int index) {
+    QWidget* tab = tabWidget->widget(index);
+    if (!tab) return;
+    if (stockTableStale && tab->isAncestorOf(stockTable)) refreshStockTable();
+    if (documentsTableStale && tab->isAncestorOf(documentsTable)) refreshDocumentsTable();
+}
+
 void MainWindow::updateStatusBar() {
     int totalProducts = warehouse.getTotalProductsCount();
-    int totalItems = warehouse.getTotalItemsCount();
+    long long totalItems = warehouse.getTotalItemsCount();
     double totalValue = warehouse.getTotalInventoryValue();
     
     QString status = QString("Товаров: %1 | Единиц: %2 | Стоимость: %3 руб. | Пользователь: Складской работник")
@@ -947,15 +1130,32 @@ void MainWindow::about() {
 }
 
 void MainWindow::saveData() {
-    if (warehouse.saveToFile()) {
-        QMessageBox::information(this, "Сохранение", "Данные успешно сохранены");
-    } else {
+    // Изменения уже в журнале - достаточно дождаться их сброса на диск
+    if (!warehouse.commit()) {
         QMessageBox::warning(this, "Ошибка", "Не удалось сохранить данные");
+        return;
+    }
+    // Полный снимок (быстрый запуск без длинного журнала) пишется в фоне;
+    // если запись уже идет, изменения все равно сохранены журналом
+    if (!saveController->start()) {
+        statusBar()->showMessage("Данные сохранены", 5000);
+    }
+}
+
+void MainWindow::saveFinished(bool success, qint64 elapsedMs) {
+    saveProgressBar->hide();
+    saveAction->setEnabled(true);
+    if (success) {
+        statusBar()->showMessage(QString("Снимок склада сохранен за %1 мс").arg(elapsedMs), 5000);
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+                             "Не удалось записать снимок склада. Изменения сохранены в журнале.");
     }
 }
 
 void MainWindow::loadData() {
-    if (warehouse.loadFromFile()) {
+    // Перечитывает снимок и хвост журнала
+    if (warehouse.openStorage()) {
         refreshStockTable();
         refreshDocumentsTable();
         updateStatusBar();
@@ -963,4 +1163,141 @@ void MainWindow::loadData() {
     } else {
         QMessageBox::warning(this, "Ошибка", "Не удалось загрузить данные");
     }
+}
+
+void MainWindow::exportCsv() {
+    QString filename = QFileDialog::getSaveFileName(this, "Экспорт каталога", 
+                                                   "warehouse_data.csv", 
+                                                   "CSV файлы (*.csv *.txt)");
+    if (filename.isEmpty()) return;
+    
+    if (warehouse.exportToCsv(filename.toStdString())) {
+        QMessageBox::information(this, "Экспорт", "Каталог экспортирован в CSV");
+    } else {
+        QMessageBox::warning(this, "Ошибка", "Не удалось экспортировать каталог");
+    }
+}
+
+void MainWindow::importCsv() {
+    QString filename = QFileDialog::getOpenFileName(this, "Импорт каталога", 
+                                                   "", 
+                                                   "CSV файлы (*.csv *.txt)");
+    if (filename.isEmpty()) return;
+    
+    CsvImportResult result = warehouse.importCatalog(filename.toStdString());
+    if (!result.success) {
+        QMessageBox::warning(this, "Ошибка",
+            QString("Не удалось загрузить каталог:\n%1").arg(QString::fromStdString(result.error)));
+        return;
+    }
+    
+    refreshStockTable();
+    updateStatusBar();
+    
+    QString message = QString("Загружено товаров: %1").arg(result.importedRows);
+    if (result.rejectedRows > 0) {
+        message += QString("\nПропущено строк: %1\n").arg(result.rejectedRows);
+        // Первые ошибки - чтобы было понятно, что исправлять в файле
+        const size_t shown = std::min<size_t>(result.errors.size(), 10);
+        for (size_t i = 0; i < shown; i++) {
+            message += QString("\nСтрока %1: %2").arg(result.errors[i].line)
+                           .arg(QString::fromStdString(result.errors[i].message));
+        }
+    }
+    QMessageBox::information(this, "Импорт", message);
+}
+
+void MainWindow::exportDocuments() {
+    QString directory = QFileDialog::getExistingDirectory(this, "Каталог для архива документов", 
+                                                          "documents");
+    if (directory.isEmpty()) return;
+    
+    DocumentExportResult result = warehouse.exportDocuments(directory.toStdString());
+    if (result.success) {
+        QMessageBox::information(this, "Выгрузка документов",
+            QString("Выгружено документов: %1\nФайлов архива: %2")
+                .arg(result.documentCount).arg(result.files.size()));
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+            QString("Не удалось выгрузить документы:\n%1").arg(QString::fromStdString(result.error)));
+    }
+}
+
+void MainWindow::exportAnalytics() {
+    QString directory = QFileDialog::getExistingDirectory(this, "Каталог для выгрузки аналитикам",
+                                                          "analytics");
+    if (directory.isEmpty()) return;
+    
+    AnalyticsExportResult result = warehouse.exportAnalytics(directory.toStdString());
+    if (result.success) {
+        QMessageBox::information(this, "Выгрузка для аналитики",
+            QString("Товаров: %1\nДокументов: %2\nСтрок документов: %3\nДвижений: %4")
+                .arg(result.products).arg(result.documents)
+                .arg(result.documentLines).arg(result.movements));
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+            QString("Не удалось выгрузить данные:\n%1").arg(QString::fromStdString(result.error)));
+    }
+}
+
+void MainWindow::exportChanges() {
+    if (!warehouse.isChangeTrackingEnabled()) {
+        auto answer = QMessageBox::question(this, "Выгрузка изменений",
+            "Выгрузка изменений еще не включена. Включить?\n"
+            "Будет записан снимок склада: скопируйте warehouse_data.bin и файлы "
+            "warehouse_data.cold.* на компьютер зеркала как исходное состояние.");
+        if (answer != QMessageBox::Yes) return;
+        if (!warehouse.startChangeTracking()) {
+            QMessageBox::warning(this, "Ошибка", "Не удалось включить выгрузку изменений");
+        }
+        return;
+    }
+    
+    QString filename = QFileDialog::getSaveFileName(this, "Пакет изменений",
+        QString("changes_%1.delta").arg(QDateTime::currentDateTime().toString("yyyyMMdd_HHmm")),
+        "Пакеты изменений (*.delta)");
+    if (filename.isEmpty()) return;
+    
+    DeltaExportResult result = warehouse.exportChanges(filename.toStdString());
+    if (result.success) {
+        statusBar()->showMessage(QString("Выгружено изменений: %1 (%2 байт)")
+                                     .arg(result.records).arg(result.bytes), 5000);
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+            QString("Не удалось выгрузить изменения:\n%1").arg(QString::fromStdString(result.error)));
+    }
+}
+
+void MainWindow::importChanges() {
+    QString filename = QFileDialog::getOpenFileName(this, "Пакет изменений", "",
+                                                    "Пакеты изменений (*.delta)");
+    if (filename.isEmpty()) return;
+    
+    DeltaImportResult result = warehouse.importChanges(filename.toStdString());
+    refreshStockTable();
+    refreshDocumentsTable();
+    updateStatusBar();
+    if (result.success) {
+        statusBar()->showMessage(QString("Применено изменений: %1, уже были применены: %2")
+                                     .arg(result.appliedRecords).arg(result.skippedRecords), 5000);
+    } else {
+        QMessageBox::warning(this, "Ошибка",
+            QString("Не удалось применить пакет:\n%1").arg(QString::fromStdString(result.error)));
+    }
+}
+
+void MainWindow::toggleLiveView(bool enabled) {
+    if (!enabled) {
+        warehouse.stopLiveView();
+        statusBar()->showMessage("Публикация остатков остановлена", 5000);
+        return;
+    }
+    if (!warehouse.startLiveView()) {
+        QMessageBox::warning(this, "Ошибка", "Не удалось опубликовать остатки в разделяемой памяти");
+        QSignalBlocker blocker(liveViewAction);
+        liveViewAction->setChecked(false);
+        return;
+    }
+    statusBar()->showMessage(QString("Остатки опубликованы: %1 (см. stock_view_reader)")
+                                 .arg(LIVE_STOCK_DEFAULT_NAME), 5000);
 }
\ No newline at end of file
@@ -19,7 +19,10 @@
 #include <QMessageBox>
 #include <QInputDialog>
 #include <QFileDialog>
+#include <QProgressBar>
 #include "warehouse.h"
+#include "async_save_controller.h"
+#include "stock_export_controller.h"
 
 class MainWindow : public QMainWindow
 {
@@ -39,6 +42,7 @@ private slots:
     void updateStockQuantity();
     void showLowStockReport();
     void exportStockReport();
+    void exportFinished(bool success, bool cancelled, qint64 rows, qint64 elapsedMs);
     
     // Вкладка "Документы"
     void refreshDocumentsTable();
@@ -63,15 +67,27 @@ private slots:
     
     // Общие
     void updateStatusBar();
+    void onTabChanged(int index);
     void about();
     void saveData();
+    void saveFinished(bool success, qint64 elapsedMs);
     void loadData();
+    void exportCsv();
+    void importCsv();
+    void exportDocuments();
+    void exportAnalytics();
+    void exportChanges();
+    void importChanges();
+    void toggleLiveView(bool enabled);
 
 private:
     Warehouse warehouse;
     
     // Виджеты
     QTabWidget *tabWidget;
+    // Таблица скрытой вкладки устарела и обновится при ее показе
+    bool stockTableStale = false;
+    bool documentsTableStale = false;
     
     // Вкладка "Склад"
     QTableWidget *stockTable;
@@ -122,6 +138,13 @@ private:
     
     // Статус бар
     QLabel *statusLabel;
+    QProgressBar *saveProgressBar;
+    QProgressBar *exportProgressBar;
+    
+    // Фоновое сохранение снимка
+    AsyncSaveController *saveController;
+    // Фоновая выгрузка остатков
+    StockExportController *exportController;
     
     // Меню
     QMenu *fileMenu;
@@ -130,6 +153,13 @@ private:
     // Действия
     QAction *saveAction;
     QAction *loadAction;
+    QAction *exportCsvAction;
+    QAction *importCsvAction;
+    QAction *exportDocumentsAction;
+    QAction *exportAnalyticsAction;
+    QAction *exportChangesAction;
+    QAction *importChangesAction;
+    QAction *liveViewAction;
     QAction *exitAction;
     QAction *aboutAction;
     
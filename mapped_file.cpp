@@ -0,0 +1,69 @@
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#include <fstream>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+bool MappedFile::open(const string& filename) {
+    close();
+
+#ifdef _WIN32
+    ifstream file(filename, ios::binary | ios::ate);
+    if (!file.is_open()) return false;
+    buffer.resize(static_cast<size_t>(file.tellg()));
+    file.seekg(0);
+    if (!buffer.empty() && !file.read(buffer.data(), buffer.size())) {
+        buffer.clear();
+        return false;
+    }
+    mappedData = buffer.data();
+    mappedSize = buffer.size();
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        ::close(fd);
+        return false;
+    }
+
+    mappedSize = static_cast<size_t>(info.st_size);
+    if (mappedSize > 0) {
+        void* address = mmap(nullptr, mappedSize, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (address == MAP_FAILED) {
+            ::close(fd);
+            mappedSize = 0;
+            return false;
+        }
+        mappedData = static_cast<const char*>(address);
+        // Файл читается последовательно - подсказываем ядру читать с опережением
+        madvise(address, mappedSize, MADV_SEQUENTIAL);
+    }
+    // Отображение остается действительным и после закрытия дескриптора
+    ::close(fd);
+#endif
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    buffer.clear();
+#else
+    if (mappedData && mappedSize > 0) {
+        munmap(const_cast<char*>(mappedData), mappedSize);
+    }
+#endif
+    mappedData = nullptr;
+    mappedSize = 0;
+    opened = false;
+}
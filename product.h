@@ -15,7 +15,7 @@ public:
         : id(_id), name(_name), price(_price), quantity(_quantity) {}
 
     int getId() const { return id; }
-    std::string getName() const { return name; }
+    const std::string& getName() const { return name; }
     double getPrice() const { return price; }
     int getQuantity() const { return quantity; }
     void setQuantity(int qty) { quantity = qty; }
@@ -0,0 +1,384 @@
+#include "product_store.h"
+
+using namespace std;
+
+void ProductIdIndex::clear() {
+    cells.clear();
+    count = 0;
+    mask = 0;
+}
+
+void ProductIdIndex::reserve(size_t expected) {
+    // Заполнение таблицы не выше 3/4
+    size_t needed = expected + expected / 3 + 1;
+    if (needed > cells.size()) grow(needed);
+}
+
+void ProductIdIndex::grow(size_t minCapacity) {
+    size_t capacity = 16;
+    while (capacity < minCapacity) capacity *= 2;
+
+    vector<Cell> old;
+    old.swap(cells);
+    cells.assign(capacity, Cell{0, EMPTY});
+    mask = capacity - 1;
+    count = 0;
+    for (const Cell& cell : old) {
+        if (cell.slot != EMPTY) set(cell.id, cell.slot);
+    }
+}
+
+size_t ProductIdIndex::find(int id) const {
+    if (cells.empty()) return npos;
+    for (size_t i = home(id); ; i = (i + 1) & mask) {
+        const Cell& cell = cells[i];
+        if (cell.slot == EMPTY) return npos;
+        if (cell.id == id) return cell.slot;
+    }
+}
+
+void ProductIdIndex::set(int id, size_t slot) {
+    if ((count + 1) * 4 > cells.size() * 3) grow(cells.size() * 2);
+    for (size_t i = home(id); ; i = (i + 1) & mask) {
+        Cell& cell = cells[i];
+        if (cell.slot == EMPTY) {
+            cell = Cell{id, static_cast<uint32_t>(slot)};
+            count++;
+            return;
+        }
+        if (cell.id == id) {
+            cell.slot = static_cast<uint32_t>(slot);
+            return;
+        }
+    }
+}
+
+bool ProductIdIndex::insert(int id, size_t slot) {
+    if ((count + 1) * 4 > cells.size() * 3) grow(cells.size() * 2);
+    for (size_t i = home(id); ; i = (i + 1) & mask) {
+        Cell& cell = cells[i];
+        if (cell.slot == EMPTY) {
+            cell = Cell{id, static_cast<uint32_t>(slot)};
+            count++;
+            return true;
+        }
+        if (cell.id == id) return false;
+    }
+}
+
+bool ProductIdIndex::erase(int id) {
+    if (cells.empty()) return false;
+    size_t i = home(id);
+    while (true) {
+        if (cells[i].slot == EMPTY) return false;
+        if (cells[i].id == id) break;
+        i = (i + 1) & mask;
+    }
+
+    // Сдвигаем назад элементы цепочки, которым освободившаяся ячейка ближе к "дому"
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; cells[j].slot != EMPTY; j = (j + 1) & mask) {
+        size_t desired = home(cells[j].id);
+        bool movable = hole <= j ? (desired <= hole || desired > j)
+                                 : (desired <= hole && desired > j);
+        if (movable) {
+            cells[hole] = cells[j];
+            hole = j;
+        }
+    }
+    cells[hole].slot = EMPTY;
+    count--;
+    return true;
+}
+
+uint32_t ProductNameIndex::hash(string_view name) {
+    uint64_t value = std::hash<string_view>()(name);
+    return static_cast<uint32_t>((value * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+void ProductNameIndex::clear() {
+    cells.clear();
+    count = 0;
+    mask = 0;
+}
+
+void ProductNameIndex::reserve(size_t expected) {
+    size_t needed = expected + expected / 3 + 1;
+    if (needed > cells.size()) grow(needed);
+}
+
+void ProductNameIndex::grow(size_t minCapacity) {
+    size_t capacity = 16;
+    while (capacity < minCapacity) capacity *= 2;
+
+    vector<Cell> old;
+    old.swap(cells);
+    cells.assign(capacity, Cell{0, EMPTY});
+    mask = capacity - 1;
+    for (const Cell& cell : old) {
+        if (cell.id == EMPTY) continue;
+        size_t i = cell.hash & mask;
+        while (cells[i].id != EMPTY) i = (i + 1) & mask;
+        cells[i] = cell;
+    }
+}
+
+size_t ProductNameIndex::find(const ProductStore& products, string_view name) const {
+    if (cells.empty()) return ProductStore::npos;
+    uint32_t h = hash(name);
+    for (size_t i = h & mask; cells[i].id != EMPTY; i = (i + 1) & mask) {
+        if (cells[i].hash != h) continue;
+        size_t slot = products.find(cells[i].id);
+        if (slot != ProductStore::npos && products.nameAt(slot) == name) return slot;
+    }
+    return ProductStore::npos;
+}
+
+void ProductNameIndex::insert(string_view name, int id) {
+    if ((count + 1) * 4 > cells.size() * 3) grow(cells.size() * 2);
+    uint32_t h = hash(name);
+    size_t i = h & mask;
+    while (cells[i].id != EMPTY) i = (i + 1) & mask;
+    cells[i] = Cell{h, id};
+    count++;
+}
+
+bool ProductNameIndex::erase(string_view name, int id) {
+    if (cells.empty()) return false;
+    uint32_t h = hash(name);
+    size_t i = h & mask;
+    while (true) {
+        if (cells[i].id == EMPTY) return false;
+        if (cells[i].id == id && cells[i].hash == h) break;
+        i = (i + 1) & mask;
+    }
+
+    // Сдвиг хвоста цепочки, как в ProductIdIndex::erase
+    size_t hole = i;
+    for (size_t j = (i + 1) & mask; cells[j].id != EMPTY; j = (j + 1) & mask) {
+        size_t desired = cells[j].hash & mask;
+        bool movable = hole <= j ? (desired <= hole || desired > j)
+                                 : (desired <= hole && desired > j);
+        if (movable) {
+            cells[hole] = cells[j];
+            hole = j;
+        }
+    }
+    cells[hole].id = EMPTY;
+    count--;
+    return true;
+}
+
+void ProductStore::reserve(size_t count, size_t nameBytes) {
+    ids.edit().reserve(count);
+    quantities.edit().reserve(count);
+    prices.edit().reserve(count);
+    nameOffsets.edit().reserve(count);
+    nameLengths.edit().reserve(count);
+    index.reserve(count);
+    if (nameBytes > 0) nameArena.edit().reserve(nameBytes);
+}
+
+void ProductStore::clear() {
+    // Разделенные со снимком колонки не трогаем - заводим новые
+    ids = SharedColumn<vector<int>>();
+    quantities = SharedColumn<vector<int>>();
+    prices = SharedColumn<vector<double>>();
+    nameOffsets = SharedColumn<vector<uint32_t>>();
+    nameLengths = SharedColumn<vector<uint32_t>>();
+    nameArena = SharedColumn<string>();
+    arenaGarbage = 0;
+    index.clear();
+    mappedOwner.reset();
+    mappedNameOffsets = nullptr;
+    mappedNames = nullptr;
+}
+
+size_t ProductStore::append(int id, string_view name, double price, int quantity) {
+    materializeNames();
+    size_t slot = size();
+    string& arena = nameArena.edit();
+    ids.edit().push_back(id);
+    quantities.edit().push_back(quantity);
+    prices.edit().push_back(price);
+    nameOffsets.edit().push_back(static_cast<uint32_t>(arena.size()));
+    nameLengths.edit().push_back(static_cast<uint32_t>(name.size()));
+    arena.append(name.data(), name.size());
+    index.set(id, slot);
+    return slot;
+}
+
+size_t ProductStore::appendUnique(int id, string_view name, double price, int quantity) {
+    size_t slot = size();
+    if (!index.insert(id, slot)) return npos;
+    materializeNames();
+    string& arena = nameArena.edit();
+    ids.edit().push_back(id);
+    quantities.edit().push_back(quantity);
+    prices.edit().push_back(price);
+    nameOffsets.edit().push_back(static_cast<uint32_t>(arena.size()));
+    nameLengths.edit().push_back(static_cast<uint32_t>(name.size()));
+    arena.append(name.data(), name.size());
+    return slot;
+}
+
+bool ProductStore::assign(size_t count, const int* newIds, const int* newQuantities,
+                          const double* newPrices, const uint32_t* newNameOffsets,
+                          const char* names, shared_ptr<const void> namesOwner) {
+    // Индекс строится до замены: при повторном id прежнее содержимое остается
+    ProductIdIndex newIndex;
+    newIndex.reserve(count);
+    for (size_t i = 0; i < count; i++) {
+        if (!newIndex.insert(newIds[i], i)) return false;
+    }
+
+    clear();
+    index = std::move(newIndex);
+    ids.edit().assign(newIds, newIds + count);
+    quantities.edit().assign(newQuantities, newQuantities + count);
+    prices.edit().assign(newPrices, newPrices + count);
+
+    if (namesOwner) {
+        mappedOwner = std::move(namesOwner);
+        mappedNameOffsets = newNameOffsets;
+        mappedNames = names;
+        return true;
+    }
+
+    uint32_t base = count > 0 ? newNameOffsets[0] : 0;
+    uint32_t end = count > 0 ? newNameOffsets[count] : 0;
+    nameArena.edit().assign(names + base, end - base);
+    vector<uint32_t>& offsets = nameOffsets.edit();
+    vector<uint32_t>& lengths = nameLengths.edit();
+    offsets.resize(count);
+    lengths.resize(count);
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = newNameOffsets[i] - base;
+        lengths[i] = newNameOffsets[i + 1] - newNameOffsets[i];
+    }
+    return true;
+}
+
+// Копирует наименования из отображенного снимка в собственный буфер
+void ProductStore::materializeNames() {
+    if (!mappedNames) return;
+    size_t count = size();
+    uint32_t base = mappedNameOffsets[0];
+    string arena(mappedNames + base, mappedNameOffsets[count] - base);
+    vector<uint32_t> offsets(count);
+    vector<uint32_t> lengths(count);
+    for (size_t i = 0; i < count; i++) {
+        offsets[i] = mappedNameOffsets[i] - base;
+        lengths[i] = mappedNameOffsets[i + 1] - mappedNameOffsets[i];
+    }
+    nameArena.replace(std::move(arena));
+    nameOffsets.replace(std::move(offsets));
+    nameLengths.replace(std::move(lengths));
+    arenaGarbage = 0;
+    mappedOwner.reset();
+    mappedNameOffsets = nullptr;
+    mappedNames = nullptr;
+}
+
+bool ProductStore::remove(int id) {
+    size_t slot = index.find(id);
+    if (slot == ProductIdIndex::npos) return false;
+    materializeNames();
+
+    vector<int>& idData = ids.edit();
+    vector<int>& quantityData = quantities.edit();
+    vector<double>& priceData = prices.edit();
+    vector<uint32_t>& offsets = nameOffsets.edit();
+    vector<uint32_t>& lengths = nameLengths.edit();
+
+    size_t last = idData.size() - 1;
+    index.erase(id);
+    arenaGarbage += lengths[slot];
+
+    // Переносим последний товар на место удаляемого
+    if (slot != last) {
+        idData[slot] = idData[last];
+        quantityData[slot] = quantityData[last];
+        priceData[slot] = priceData[last];
+        offsets[slot] = offsets[last];
+        lengths[slot] = lengths[last];
+        index.set(idData[slot], slot);
+    }
+    idData.pop_back();
+    quantityData.pop_back();
+    priceData.pop_back();
+    offsets.pop_back();
+    lengths.pop_back();
+
+    // Сжимаем буфер наименований, когда мусора в нем больше половины
+    if (arenaGarbage > nameArena.get().size() / 2) {
+        compactNames();
+    }
+    return true;
+}
+
+size_t ProductStore::find(int id) const {
+    return index.find(id);
+}
+
+void ProductStore::compactNames() {
+    const string& arena = nameArena.get();
+    vector<uint32_t>& offsets = nameOffsets.edit();
+    const vector<uint32_t>& lengths = nameLengths.get();
+    string compacted;
+    compacted.reserve(arena.size() - arenaGarbage);
+    for (size_t i = 0; i < offsets.size(); i++) {
+        uint32_t offset = static_cast<uint32_t>(compacted.size());
+        compacted.append(arena, offsets[i], lengths[i]);
+        offsets[i] = offset;
+    }
+    nameArena.replace(std::move(compacted));
+    arenaGarbage = 0;
+}
+
+ProductColumns ProductStore::shareColumns() const {
+    return ProductColumns{ids.share(), quantities.share(), prices.share(),
+                          nameOffsets.share(), nameLengths.share(), nameArena.share(),
+                          mappedOwner, mappedNameOffsets, mappedNames};
+}
+
+long long ProductStore::sumQuantities() const {
+    const int* q = quantities.get().data();
+    size_t n = quantities.get().size();
+    long long total = 0;
+    for (size_t i = 0; i < n; i++) {
+        total += q[i];
+    }
+    return total;
+}
+
+double ProductStore::sumValues() const {
+    // Четыре независимых аккумулятора позволяют компилятору
+    // развернуть цикл в векторные инструкции без -ffast-math
+    const double* p = prices.get().data();
+    const int* q = quantities.get().data();
+    size_t n = prices.get().size();
+    double acc0 = 0, acc1 = 0, acc2 = 0, acc3 = 0;
+    size_t i = 0;
+    for (; i + 4 <= n; i += 4) {
+        acc0 += p[i] * q[i];
+        acc1 += p[i + 1] * q[i + 1];
+        acc2 += p[i + 2] * q[i + 2];
+        acc3 += p[i + 3] * q[i + 3];
+    }
+    for (; i < n; i++) {
+        acc0 += p[i] * q[i];
+    }
+    return (acc0 + acc1) + (acc2 + acc3);
+}
+
+size_t ProductStore::memoryUsage() const {
+    size_t bytes = ids.get().capacity() * sizeof(int)
+                 + quantities.get().capacity() * sizeof(int)
+                 + prices.get().capacity() * sizeof(double)
+                 + nameOffsets.get().capacity() * sizeof(uint32_t)
+                 + nameLengths.get().capacity() * sizeof(uint32_t)
+                 + nameArena.get().capacity();
+    bytes += index.memoryUsage();
+    return bytes;
+}
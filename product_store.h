@@ -0,0 +1,287 @@
+#ifndef PRODUCT_STORE_H
+#define PRODUCT_STORE_H
+
+#include <vector>
+#include <string>
+#include <string_view>
+#include <iterator>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include <climits>
+
+class ProductStore;
+
+// Индекс id товара -> позиция в хранилище: открытая адресация с линейным
+// пробированием в одном непрерывном массиве (8 байт на ячейку, без узлов в куче).
+// Удаление сдвигает хвост цепочки назад, поэтому "надгробий" не остается.
+class ProductIdIndex {
+private:
+    struct Cell {
+        int32_t id;
+        uint32_t slot;
+    };
+
+    static constexpr uint32_t EMPTY = UINT32_MAX;
+
+    std::vector<Cell> cells;
+    size_t count = 0;
+    size_t mask = 0;
+
+    size_t home(int id) const {
+        // Мультипликативное хеширование: соседние id расходятся по таблице
+        return static_cast<size_t>((static_cast<uint64_t>(static_cast<uint32_t>(id)) *
+                                    0x9E3779B97F4A7C15ULL) >> 32) & mask;
+    }
+    void grow(size_t minCapacity);
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    size_t size() const { return count; }
+    void clear();
+    void reserve(size_t expected);
+
+    size_t find(int id) const;
+    // Вставляет или обновляет позицию товара
+    void set(int id, size_t slot);
+    // Вставляет позицию, только если id еще нет; один проход по цепочке
+    bool insert(int id, size_t slot);
+    bool erase(int id);
+
+    size_t memoryUsage() const { return cells.capacity() * sizeof(Cell); }
+};
+
+// Индекс наименование -> id товара: та же открытая адресация, в ячейке
+// 32 бита хеша наименования и id. Сами строки не хранятся - совпадение хеша
+// проверяется сравнением с наименованием в ProductStore. Одинаковые
+// наименования у разных товаров допустимы: find находит любой из них.
+class ProductNameIndex {
+private:
+    struct Cell {
+        uint32_t hash;
+        int32_t id;
+    };
+
+    static constexpr int32_t EMPTY = 0;     // id товара всегда положительный
+
+    std::vector<Cell> cells;
+    size_t count = 0;
+    size_t mask = 0;
+
+    void grow(size_t minCapacity);
+
+public:
+    static uint32_t hash(std::string_view name);
+
+    size_t size() const { return count; }
+    void clear();
+    void reserve(size_t expected);
+
+    // Позиция товара с таким наименованием или ProductStore::npos
+    size_t find(const ProductStore& products, std::string_view name) const;
+    void insert(std::string_view name, int id);
+    bool erase(std::string_view name, int id);
+
+    size_t memoryUsage() const { return cells.capacity() * sizeof(Cell); }
+};
+
+// Легкая ссылка на строку хранилища товаров (данные не копируются)
+class ProductRef {
+private:
+    const ProductStore* store;
+    size_t slot;
+
+public:
+    ProductRef(const ProductStore* _store, size_t _slot) : store(_store), slot(_slot) {}
+
+    size_t getSlot() const { return slot; }
+    inline int getId() const;
+    inline std::string_view getName() const;
+    inline double getPrice() const;
+    inline int getQuantity() const;
+    double getTotalValue() const { return getPrice() * getQuantity(); }
+};
+
+// Колонка с копированием при записи. Копия колонки (например, в снимке
+// для фоновой записи) разделяет с хранилищем те же данные; первое изменение
+// после этого копирует колонку, а копия продолжает видеть прежнее содержимое.
+//
+// Розданные копии считает readers: поток, отпустивший последнюю ссылку на
+// копию, уменьшает счетчик с release, edit() читает его с acquire. Поэтому
+// все чтения копии в другом потоке завершаются до того, как edit() начнет
+// менять данные на месте (use_count() такого упорядочивания не дает).
+template<typename Container>
+class SharedColumn {
+private:
+    std::shared_ptr<Container> data = std::make_shared<Container>();
+    std::shared_ptr<std::atomic<int>> readers = std::make_shared<std::atomic<int>>(0);
+
+public:
+    SharedColumn() = default;
+    SharedColumn(const SharedColumn&) = delete;
+    SharedColumn& operator=(const SharedColumn&) = delete;
+    SharedColumn(SharedColumn&&) = default;
+    SharedColumn& operator=(SharedColumn&&) = default;
+
+    const Container& get() const { return *data; }
+    Container& edit() {
+        if (readers->load(std::memory_order_acquire) > 0) {
+            data = std::make_shared<Container>(*data);
+            readers = std::make_shared<std::atomic<int>>(0);
+        }
+        return *data;
+    }
+    // Подменяет содержимое, не копируя прежнее
+    void replace(Container&& value) {
+        data = std::make_shared<Container>(std::move(value));
+        readers = std::make_shared<std::atomic<int>>(0);
+    }
+    std::shared_ptr<const Container> share() const {
+        readers->fetch_add(1, std::memory_order_relaxed);
+        return std::shared_ptr<const Container>(
+            data.get(), [owner = data, counter = readers](const Container*) {
+                counter->fetch_sub(1, std::memory_order_release);
+            });
+    }
+};
+
+// Колонки хранилища на момент вызова ProductStore::shareColumns().
+// Не меняются при последующих изменениях хранилища.
+struct ProductColumns {
+    std::shared_ptr<const std::vector<int>> ids;
+    std::shared_ptr<const std::vector<int>> quantities;
+    std::shared_ptr<const std::vector<double>> prices;
+    std::shared_ptr<const std::vector<uint32_t>> nameOffsets;
+    std::shared_ptr<const std::vector<uint32_t>> nameLengths;
+    std::shared_ptr<const std::string> nameArena;
+    // Наименования, еще не скопированные из отображенного снимка
+    std::shared_ptr<const void> mappedOwner;
+    const uint32_t* mappedNameOffsets = nullptr;
+    const char* mappedNames = nullptr;
+
+    size_t size() const { return ids ? ids->size() : 0; }
+    std::string_view nameAt(size_t slot) const {
+        if (mappedNames) {
+            return std::string_view(mappedNames + mappedNameOffsets[slot],
+                                    mappedNameOffsets[slot + 1] - mappedNameOffsets[slot]);
+        }
+        return std::string_view(nameArena->data() + (*nameOffsets)[slot], (*nameLengths)[slot]);
+    }
+};
+
+// Колоночное хранилище товаров: id, количество и цена лежат в отдельных
+// непрерывных массивах, наименования - в общем буфере (arena).
+// Позиции (slot) не стабильны: при удалении на место товара переносится последний.
+// Колонки копируются при записи (SharedColumn), поэтому shareColumns() дешев.
+class ProductStore {
+private:
+    SharedColumn<std::vector<int>> ids;
+    SharedColumn<std::vector<int>> quantities;
+    SharedColumn<std::vector<double>> prices;
+    SharedColumn<std::vector<uint32_t>> nameOffsets;
+    SharedColumn<std::vector<uint32_t>> nameLengths;
+    SharedColumn<std::string> nameArena;
+    size_t arenaGarbage = 0;                // байты удаленных наименований в nameArena
+    ProductIdIndex index;                   // id товара -> позиция
+
+    // Наименования могут оставаться в отображенном снимке (см. assign с namesOwner):
+    // они копируются в nameArena только перед первым изменением состава каталога
+    std::shared_ptr<const void> mappedOwner;
+    const uint32_t* mappedNameOffsets = nullptr;
+    const char* mappedNames = nullptr;
+
+    void compactNames();
+    void materializeNames();
+
+public:
+    static constexpr size_t npos = static_cast<size_t>(-1);
+
+    class const_iterator {
+    private:
+        const ProductStore* store;
+        size_t slot;
+
+    public:
+        using iterator_category = std::random_access_iterator_tag;
+        using value_type = ProductRef;
+        using difference_type = std::ptrdiff_t;
+        using pointer = void;
+        using reference = ProductRef;
+
+        const_iterator(const ProductStore* _store, size_t _slot) : store(_store), slot(_slot) {}
+
+        ProductRef operator*() const { return ProductRef(store, slot); }
+        const_iterator& operator++() { ++slot; return *this; }
+        const_iterator operator++(int) { const_iterator tmp = *this; ++slot; return tmp; }
+        bool operator==(const const_iterator& other) const { return slot == other.slot; }
+        bool operator!=(const const_iterator& other) const { return slot != other.slot; }
+        difference_type operator-(const const_iterator& other) const {
+            return static_cast<difference_type>(slot) - static_cast<difference_type>(other.slot);
+        }
+    };
+
+    size_t size() const { return ids.get().size(); }
+    bool empty() const { return ids.get().empty(); }
+    void reserve(size_t count, size_t nameBytes = 0);
+    void clear();
+
+    // Добавляет товар и возвращает его позицию
+    size_t append(int id, std::string_view name, double price, int quantity);
+    // То же, но товар с уже существующим id не добавляется (возвращает npos)
+    size_t appendUnique(int id, std::string_view name, double price, int quantity);
+
+    // Заменяет содержимое готовыми колонками (например, из снимка на диске).
+    // nameOffsets содержит count + 1 смещений в names. Если передан namesOwner,
+    // наименования не копируются: хранилище читает их из names, пока держит
+    // namesOwner (например, отображенный файл снимка).
+    // Повторный id - false, содержимое хранилища при этом не меняется.
+    bool assign(size_t count, const int* newIds, const int* newQuantities,
+                const double* newPrices, const uint32_t* newNameOffsets, const char* names,
+                std::shared_ptr<const void> namesOwner = nullptr);
+
+    bool remove(int id);
+    size_t find(int id) const;
+    bool contains(int id) const { return find(id) != npos; }
+
+    // Доступ по позиции
+    int idAt(size_t slot) const { return ids.get()[slot]; }
+    int quantityAt(size_t slot) const { return quantities.get()[slot]; }
+    double priceAt(size_t slot) const { return prices.get()[slot]; }
+    std::string_view nameAt(size_t slot) const {
+        if (mappedNames) {
+            return std::string_view(mappedNames + mappedNameOffsets[slot],
+                                    mappedNameOffsets[slot + 1] - mappedNameOffsets[slot]);
+        }
+        return std::string_view(nameArena.get().data() + nameOffsets.get()[slot],
+                                nameLengths.get()[slot]);
+    }
+    void setQuantityAt(size_t slot, int quantity) { quantities.edit()[slot] = quantity; }
+
+    ProductRef operator[](size_t slot) const { return ProductRef(this, slot); }
+    const_iterator begin() const { return const_iterator(this, 0); }
+    const_iterator end() const { return const_iterator(this, size()); }
+
+    // Колонки целиком - для сканирующих операций
+    const std::vector<int>& idColumn() const { return ids.get(); }
+    const std::vector<int>& quantityColumn() const { return quantities.get(); }
+    const std::vector<double>& priceColumn() const { return prices.get(); }
+
+    // Неизменяемая копия всех колонок без копирования данных (O(1))
+    ProductColumns shareColumns() const;
+
+    // Агрегаты по всему каталогу
+    long long sumQuantities() const;
+    double sumValues() const;
+
+    // Примерный объем памяти, занимаемый хранилищем, в байтах
+    size_t memoryUsage() const;
+};
+
+int ProductRef::getId() const { return store->idAt(slot); }
+std::string_view ProductRef::getName() const { return store->nameAt(slot); }
+double ProductRef::getPrice() const { return store->priceAt(slot); }
+int ProductRef::getQuantity() const { return store->quantityAt(slot); }
+
+#endif // PRODUCT_STORE_H
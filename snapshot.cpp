@@ -0,0 +1,581 @@
+#include "snapshot.h"
+#include <cstdio>
+#include <cstring>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+uint64_t alignTo8(uint64_t value) {
+    return (value + 7) & ~uint64_t(7);
+}
+
+// Буферизованная запись секций с подсчетом контрольной суммы
+class SectionWriter {
+private:
+    // Ход записи сообщается не чаще, чем раз на столько байт
+    static constexpr size_t PROGRESS_STEP = 4 << 20;
+
+    FILE* file;
+    SnapshotChecksum& checksum;
+    uint64_t position;
+    uint64_t total;
+    const SnapshotProgress& progress;
+    uint64_t reported = 0;
+    bool ok = true;
+
+public:
+    SectionWriter(FILE* _file, SnapshotChecksum& _checksum, uint64_t start, uint64_t _total,
+                  const SnapshotProgress& _progress)
+        : file(_file), checksum(_checksum), position(start), total(_total), progress(_progress) {}
+
+    void write(const void* data, size_t size) {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            size_t chunk = min(size, PROGRESS_STEP);
+            checksum.update(bytes, chunk);
+            if (fwrite(bytes, 1, chunk, file) != chunk) ok = false;
+            position += chunk;
+            bytes += chunk;
+            size -= chunk;
+            if (progress && position - reported >= PROGRESS_STEP) {
+                reported = position;
+                progress(position, total);
+            }
+        }
+    }
+
+    // Дописывает нули до начала следующей секции
+    void padTo(uint64_t offset) {
+        static const char zeros[8] = {0};
+        while (position < offset) {
+            size_t chunk = static_cast<size_t>(min<uint64_t>(offset - position, sizeof(zeros)));
+            write(zeros, chunk);
+        }
+    }
+
+    bool good() const { return ok; }
+};
+
+// Строки документов: уникальные (номер, комментарий) дописываются как есть,
+// повторяющиеся (автор, подразделение, ключи и значения полей, наименования
+// в строках) хранятся один раз
+class StringPool {
+private:
+    string& blob;
+    unordered_map<string, SnapshotStringRef> interned;
+    // Строки прежнего снимка уже без повторов: их достаточно сопоставлять по ссылке
+    const SnapshotReader* remapSource = nullptr;
+    unordered_map<uint64_t, SnapshotStringRef> remapped;
+
+public:
+    explicit StringPool(string& _blob) : blob(_blob) {}
+
+    SnapshotStringRef append(string_view value) {
+        SnapshotStringRef ref{static_cast<uint32_t>(blob.size()), static_cast<uint32_t>(value.size())};
+        blob.append(value.data(), value.size());
+        return ref;
+    }
+
+    SnapshotStringRef intern(string_view value) {
+        if (value.empty()) return SnapshotStringRef{0, 0};
+        auto it = interned.find(string(value));
+        if (it != interned.end()) return it->second;
+        SnapshotStringRef ref = append(value);
+        interned.emplace(string(value), ref);
+        return ref;
+    }
+
+    SnapshotStringRef remap(const SnapshotReader& reader, SnapshotStringRef old) {
+        if (old.length == 0) return SnapshotStringRef{0, 0};
+        if (remapSource != &reader) {
+            remapSource = &reader;
+            remapped.clear();
+        }
+        uint64_t key = uint64_t(old.offset) << 32 | old.length;
+        auto it = remapped.find(key);
+        if (it != remapped.end()) return it->second;
+        SnapshotStringRef ref = append(reader.documentString(old));
+        remapped.emplace(key, ref);
+        return ref;
+    }
+};
+
+// Секции документов, собранные из SnapshotImage при записи
+struct DocumentSections {
+    vector<SnapshotDocumentRecord> documents;
+    vector<SnapshotDocumentContent> contents;
+    vector<SnapshotItemRecord> items;
+    vector<SnapshotFieldRecord> fields;
+    string strings;
+};
+
+// Переносит еще не загруженное содержимое документа из прежнего снимка
+// без создания строк документа
+void copyContent(const SnapshotReader& reader, uint32_t index, DocumentSections& sections,
+                 StringPool& strings) {
+    if (!reader.hasDocumentContents()) return;
+    const SnapshotDocumentContent& content =
+        reader.section<SnapshotDocumentContent>(SECTION_DOCUMENT_CONTENTS)[index];
+    const SnapshotItemRecord* items = reader.section<SnapshotItemRecord>(SECTION_DOCUMENT_ITEMS);
+    const SnapshotFieldRecord* fields = reader.section<SnapshotFieldRecord>(SECTION_DOCUMENT_FIELDS);
+
+    for (uint32_t i = 0; i < content.itemCount; i++) {
+        SnapshotItemRecord item = items[content.firstItem + i];
+        item.name = strings.remap(reader, item.name);
+        item.comment = strings.remap(reader, item.comment);
+        sections.items.push_back(item);
+    }
+    for (uint32_t i = 0; i < content.fieldCount; i++) {
+        const SnapshotFieldRecord& field = fields[content.firstField + i];
+        sections.fields.push_back({strings.remap(reader, field.key), strings.remap(reader, field.value)});
+    }
+}
+
+void appendContent(DocumentItemView items, DocumentFieldsView fields,
+                   DocumentSections& sections, StringPool& strings) {
+    for (const auto& item : items) {
+        SnapshotItemRecord record;
+        record.productId = item.productId;
+        record.quantity = item.quantity;
+        record.price = item.price;
+        record.name = strings.intern(item.productName());
+        record.comment = strings.intern(items.commentOf(item));
+        sections.items.push_back(record);
+    }
+    for (const auto& [key, value] : fields) {
+        sections.fields.push_back({strings.intern(key), strings.intern(value)});
+    }
+}
+
+// Сериализует документы копии; выполняется в потоке записи, без блокировки склада
+void serializeDocuments(const SnapshotImage& image, DocumentSections& sections) {
+    size_t unloadedCount = image.unloadedDocuments ? image.unloadedDocuments->documentCount() : 0;
+    sections.documents.reserve(unloadedCount + image.documents.size());
+    sections.contents.reserve(unloadedCount + image.documents.size());
+    StringPool strings(sections.strings);
+
+    // Незагруженные документы переносятся секциями целиком: их строки
+    // уже без повторов, ссылки остаются прежними
+    if (image.unloadedDocuments) {
+        const SnapshotReader& reader = *image.unloadedDocuments;
+        const SnapshotHeader& header = reader.getHeader();
+        const SnapshotDocumentRecord* records = reader.section<SnapshotDocumentRecord>(SECTION_DOCUMENTS);
+        sections.documents.assign(records, records + unloadedCount);
+        sections.strings.assign(reader.section<char>(SECTION_DOCUMENT_STRINGS),
+                                header.sections[SECTION_DOCUMENT_STRINGS].size);
+        if (reader.hasDocumentContents()) {
+            const SnapshotDocumentContent* contents =
+                reader.section<SnapshotDocumentContent>(SECTION_DOCUMENT_CONTENTS);
+            const SnapshotItemRecord* items = reader.section<SnapshotItemRecord>(SECTION_DOCUMENT_ITEMS);
+            const SnapshotFieldRecord* fields = reader.section<SnapshotFieldRecord>(SECTION_DOCUMENT_FIELDS);
+            sections.contents.assign(contents, contents + unloadedCount);
+            sections.items.assign(items, items + header.sections[SECTION_DOCUMENT_ITEMS].size /
+                                                     sizeof(SnapshotItemRecord));
+            sections.fields.assign(fields, fields + header.sections[SECTION_DOCUMENT_FIELDS].size /
+                                                        sizeof(SnapshotFieldRecord));
+        } else {
+            sections.contents.assign(unloadedCount, SnapshotDocumentContent{0, 0, 0, 0});
+        }
+    }
+
+    for (const auto& captured : image.documents) {
+        const DocumentBase& doc = *captured.document;
+        SnapshotDocumentRecord record;
+        record.id = doc.getId();
+        record.type = static_cast<int32_t>(doc.getType());
+        record.date = static_cast<int64_t>(doc.getDate());
+        record.number = strings.append(doc.getNumber());
+        record.status = strings.intern(documentStatusLabel(doc.getType(), captured.status));
+        record.createdBy = strings.intern(doc.getCreatedBy());
+        record.department = strings.intern(doc.getDepartment());
+        record.comment = strings.append(doc.getComment());
+        sections.documents.push_back(record);
+
+        SnapshotDocumentContent content;
+        content.firstItem = static_cast<uint32_t>(sections.items.size());
+        content.firstField = static_cast<uint32_t>(sections.fields.size());
+        if (captured.contentReader) {
+            copyContent(*captured.contentReader, captured.contentIndex, sections, strings);
+        } else {
+            appendContent(captured.content.items, captured.content.fields, sections, strings);
+        }
+        content.itemCount = static_cast<uint32_t>(sections.items.size()) - content.firstItem;
+        content.fieldCount = static_cast<uint32_t>(sections.fields.size()) - content.firstField;
+        sections.contents.push_back(content);
+    }
+}
+
+} // namespace
+
+void SnapshotChecksum::update(const void* data, size_t size) {
+    const unsigned char* bytes = static_cast<const unsigned char*>(data);
+
+    // Дополняем хвост предыдущего вызова до целого слова
+    while (tailSize > 0 && tailSize < 8 && size > 0) {
+        tail[tailSize++] = *bytes++;
+        size--;
+    }
+    if (tailSize == 8) {
+        uint64_t word;
+        memcpy(&word, tail, 8);
+        mix(word);
+        tailSize = 0;
+    }
+
+    for (; size >= 8; size -= 8, bytes += 8) {
+        uint64_t word;
+        memcpy(&word, bytes, 8);
+        mix(word);
+    }
+
+    while (size > 0) {
+        tail[tailSize++] = *bytes++;
+        size--;
+    }
+}
+
+uint64_t SnapshotChecksum::finish() const {
+    SnapshotChecksum copy = *this;
+    if (copy.tailSize > 0) {
+        uint64_t word = 0;
+        memcpy(&word, copy.tail, copy.tailSize);
+        copy.mix(word ^ (uint64_t(copy.tailSize) << 56));
+    }
+    return copy.hash;
+}
+
+SnapshotImage SnapshotWriter::capture(const ProductStore& products,
+                                      const vector<shared_ptr<DocumentBase>>& documents,
+                                      int nextProductId, int nextDocumentId,
+                                      uint64_t logGeneration,
+                                      shared_ptr<const SnapshotReader> unloadedDocuments) {
+    SnapshotImage image;
+    image.products = products.shareColumns();
+    image.unloadedDocuments = move(unloadedDocuments);
+
+    // Под блокировкой склада документы только запоминаются; содержимое
+    // сериализуется при записи (serializeDocuments)
+    image.documents.resize(documents.size());
+    for (size_t i = 0; i < documents.size(); i++) {
+        const auto& doc = documents[i];
+        SnapshotDocumentCapture& captured = image.documents[i];
+        captured.document = doc;
+        captured.status = doc->getStatus();
+
+        uint32_t sourceIndex;
+        const DocumentContentSource* source = doc->getContentSource(sourceIndex);
+        if (auto snapshotSource = dynamic_cast<const SnapshotContentSource*>(source)) {
+            captured.contentReader = &snapshotSource->getReader();
+            captured.contentIndex = sourceIndex;
+        } else {
+            // Загруженное содержимое или содержимое из холодного сегмента:
+            // сегмент может смениться до записи, поэтому оно загружается сейчас
+            captured.content = doc->shareContent();
+        }
+    }
+
+    image.nextProductId = nextProductId;
+    image.nextDocumentId = nextDocumentId;
+    image.logGeneration = logGeneration;
+    return image;
+}
+
+bool SnapshotWriter::write(const string& filename, const SnapshotImage& image,
+                           const SnapshotProgress& progress) {
+    const ProductColumns& products = image.products;
+    size_t productCount = products.size();
+
+    // Наименования пишутся подряд, без мусора удаленных товаров
+    vector<uint32_t> nameOffsets(productCount + 1);
+    uint64_t nameBytes = 0;
+    for (size_t i = 0; i < productCount; i++) {
+        nameOffsets[i] = static_cast<uint32_t>(nameBytes);
+        nameBytes += products.nameAt(i).size();
+    }
+    nameOffsets[productCount] = static_cast<uint32_t>(nameBytes);
+
+    DocumentSections sections;
+    serializeDocuments(image, sections);
+
+    SnapshotHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, SNAPSHOT_MAGIC, sizeof(header.magic));
+    header.version = SNAPSHOT_VERSION;
+    header.headerSize = sizeof(SnapshotHeader);
+    header.productCount = productCount;
+    header.documentCount = sections.documents.size();
+    header.nextProductId = image.nextProductId;
+    header.nextDocumentId = image.nextDocumentId;
+    header.logGeneration = image.logGeneration;
+    header.syncSource = image.syncSource;
+    header.syncGeneration = image.syncGeneration;
+    header.syncOffset = image.syncOffset;
+
+    uint64_t sizes[SECTION_COUNT] = {
+        productCount * sizeof(int32_t),
+        productCount * sizeof(int32_t),
+        productCount * sizeof(double),
+        (productCount + 1) * sizeof(uint32_t),
+        nameBytes,
+        sections.documents.size() * sizeof(SnapshotDocumentRecord),
+        sections.strings.size(),
+        sections.contents.size() * sizeof(SnapshotDocumentContent),
+        sections.items.size() * sizeof(SnapshotItemRecord),
+        sections.fields.size() * sizeof(SnapshotFieldRecord),
+        image.ledger.size() * sizeof(SnapshotLedgerRecord)
+    };
+    uint64_t offset = alignTo8(sizeof(SnapshotHeader));
+    for (uint32_t i = 0; i < SECTION_COUNT; i++) {
+        header.sections[i] = {offset, sizes[i]};
+        offset = alignTo8(offset + sizes[i]);
+    }
+    header.fileSize = offset;
+
+    string tempFilename = filename + ".tmp";
+    FILE* file = fopen(tempFilename.c_str(), "wb");
+    if (!file) return false;
+    vector<char> buffer(1 << 20);
+    setvbuf(file, buffer.data(), _IOFBF, buffer.size());
+
+    // Заголовок пишется последним, когда известна контрольная сумма;
+    // в сумму он входит с нулевым полем checksum
+    SnapshotChecksum checksum;
+    checksum.update(&header, sizeof(header));
+    fwrite(&header, 1, sizeof(header), file);
+    SectionWriter out(file, checksum, sizeof(header), header.fileSize, progress);
+
+    if (productCount > 0) {
+        out.padTo(header.sections[SECTION_PRODUCT_IDS].offset);
+        out.write(products.ids->data(), sizes[SECTION_PRODUCT_IDS]);
+        out.padTo(header.sections[SECTION_PRODUCT_QUANTITIES].offset);
+        out.write(products.quantities->data(), sizes[SECTION_PRODUCT_QUANTITIES]);
+        out.padTo(header.sections[SECTION_PRODUCT_PRICES].offset);
+        out.write(products.prices->data(), sizes[SECTION_PRODUCT_PRICES]);
+    }
+    out.padTo(header.sections[SECTION_PRODUCT_NAME_OFFSETS].offset);
+    out.write(nameOffsets.data(), sizes[SECTION_PRODUCT_NAME_OFFSETS]);
+    out.padTo(header.sections[SECTION_PRODUCT_NAMES].offset);
+    string names;
+    names.reserve(1 << 20);
+    for (size_t i = 0; i < productCount; i++) {
+        string_view name = products.nameAt(i);
+        names.append(name.data(), name.size());
+        if (names.size() >= (1 << 20)) {
+            out.write(names.data(), names.size());
+            names.clear();
+        }
+    }
+    out.write(names.data(), names.size());
+    out.padTo(header.sections[SECTION_DOCUMENTS].offset);
+    out.write(sections.documents.data(), sizes[SECTION_DOCUMENTS]);
+    out.padTo(header.sections[SECTION_DOCUMENT_STRINGS].offset);
+    out.write(sections.strings.data(), sizes[SECTION_DOCUMENT_STRINGS]);
+    out.padTo(header.sections[SECTION_DOCUMENT_CONTENTS].offset);
+    out.write(sections.contents.data(), sizes[SECTION_DOCUMENT_CONTENTS]);
+    out.padTo(header.sections[SECTION_DOCUMENT_ITEMS].offset);
+    out.write(sections.items.data(), sizes[SECTION_DOCUMENT_ITEMS]);
+    out.padTo(header.sections[SECTION_DOCUMENT_FIELDS].offset);
+    out.write(sections.fields.data(), sizes[SECTION_DOCUMENT_FIELDS]);
+    out.padTo(header.sections[SECTION_LEDGER].offset);
+    vector<SnapshotLedgerRecord> ledger;
+    ledger.reserve(1 << 14);
+    image.ledger.forEach([&](const LedgerEntry& entry) {
+        ledger.push_back({static_cast<int64_t>(entry.timestamp), entry.productId, entry.delta,
+                          entry.documentId, static_cast<uint32_t>(entry.operation)});
+        if (ledger.size() == ledger.capacity()) {
+            out.write(ledger.data(), ledger.size() * sizeof(SnapshotLedgerRecord));
+            ledger.clear();
+        }
+    });
+    out.write(ledger.data(), ledger.size() * sizeof(SnapshotLedgerRecord));
+    out.padTo(header.fileSize);
+
+    if (progress) progress(header.fileSize, header.fileSize);
+
+    header.checksum = checksum.finish();
+    bool ok = out.good() &&
+              fseek(file, 0, SEEK_SET) == 0 &&
+              fwrite(&header, 1, sizeof(header), file) == sizeof(header) &&
+              fflush(file) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(file)) == 0;
+#endif
+    ok = fclose(file) == 0 && ok;
+
+    if (!ok) {
+        remove(tempFilename.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    remove(filename.c_str());
+#endif
+    return rename(tempFilename.c_str(), filename.c_str()) == 0;
+}
+
+bool SnapshotReader::fail(const string& message) {
+    error = message;
+    header = nullptr;
+    file.close();
+    return false;
+}
+
+bool SnapshotReader::open(const string& filename, bool verifyChecksum) {
+    error.clear();
+    header = nullptr;
+    if (!file.open(filename)) return fail("Не удалось открыть файл " + filename);
+    if (file.size() < sizeof(SnapshotHeader)) return fail("Файл слишком мал для снимка");
+
+    header = reinterpret_cast<const SnapshotHeader*>(file.data());
+    if (memcmp(header->magic, SNAPSHOT_MAGIC, sizeof(SNAPSHOT_MAGIC)) != 0) {
+        return fail("Файл не является снимком склада");
+    }
+    if (header->version == 0 || header->version > SNAPSHOT_VERSION) {
+        return fail("Неподдерживаемая версия снимка: " + to_string(header->version));
+    }
+    if (header->headerSize < sizeof(SnapshotHeader) || header->fileSize != file.size()) {
+        return fail("Поврежденный заголовок снимка");
+    }
+
+    uint64_t productCount = header->productCount;
+    uint64_t expected[SECTION_COUNT] = {
+        productCount * sizeof(int32_t),
+        productCount * sizeof(int32_t),
+        productCount * sizeof(double),
+        (productCount + 1) * sizeof(uint32_t),
+        header->sections[SECTION_PRODUCT_NAMES].size,
+        header->documentCount * sizeof(SnapshotDocumentRecord),
+        header->sections[SECTION_DOCUMENT_STRINGS].size,
+        header->documentCount * sizeof(SnapshotDocumentContent),
+        header->sections[SECTION_DOCUMENT_ITEMS].size,
+        header->sections[SECTION_DOCUMENT_FIELDS].size,
+        header->sections[SECTION_LEDGER].size
+    };
+    // В версии 1 секций содержимого документов еще не было, до версии 4 -
+    // секции журнала движения
+    uint32_t sectionCount = header->version >= 4 ? uint32_t(SECTION_COUNT)
+                          : header->version >= 2 ? uint32_t(SECTION_LEDGER)
+                                                 : uint32_t(SECTION_DOCUMENT_CONTENTS);
+    for (uint32_t i = 0; i < sectionCount; i++) {
+        const SnapshotSection& section = header->sections[i];
+        if (section.size != expected[i] || section.offset % 8 != 0 ||
+            section.offset < header->headerSize || section.offset + section.size > file.size()) {
+            return fail("Поврежденная таблица секций снимка");
+        }
+    }
+
+    if (verifyChecksum) {
+        SnapshotChecksum checksum;
+        if (header->version >= 3) {
+            SnapshotHeader copy = *header;
+            copy.checksum = 0;
+            checksum.update(&copy, sizeof(copy));
+            checksum.update(file.data() + sizeof(copy), file.size() - sizeof(copy));
+        } else {
+            checksum.update(file.data() + header->headerSize, file.size() - header->headerSize);
+        }
+        if (checksum.finish() != header->checksum) {
+            return fail("Контрольная сумма снимка не совпадает");
+        }
+    }
+
+    // Смещения наименований должны быть монотонны и не выходить за секцию
+    const uint32_t* nameOffsets = section<uint32_t>(SECTION_PRODUCT_NAME_OFFSETS);
+    uint64_t nameBytes = header->sections[SECTION_PRODUCT_NAMES].size;
+    if (nameOffsets[0] != 0 || nameOffsets[productCount] != nameBytes) {
+        return fail("Поврежденные наименования товаров");
+    }
+    for (uint64_t i = 0; i < productCount; i++) {
+        if (nameOffsets[i] > nameOffsets[i + 1]) return fail("Поврежденные наименования товаров");
+    }
+
+    const SnapshotDocumentRecord* records = section<SnapshotDocumentRecord>(SECTION_DOCUMENTS);
+    uint64_t stringBytes = header->sections[SECTION_DOCUMENT_STRINGS].size;
+    for (uint64_t i = 0; i < header->documentCount; i++) {
+        const SnapshotDocumentRecord& record = records[i];
+        for (const SnapshotStringRef* ref : {&record.number, &record.status, &record.createdBy,
+                                             &record.department, &record.comment}) {
+            if (uint64_t(ref->offset) + ref->length > stringBytes) {
+                return fail("Поврежденные строки документов");
+            }
+        }
+        if (record.type < 0 || record.type >= DOCUMENT_TYPE_COUNT) {
+            return fail("Неизвестный тип документа в снимке");
+        }
+    }
+    if (header->version >= 4) {
+        if (header->sections[SECTION_LEDGER].size % sizeof(SnapshotLedgerRecord) != 0) {
+            return fail("Поврежденный журнал движения");
+        }
+        const SnapshotLedgerRecord* ledger = section<SnapshotLedgerRecord>(SECTION_LEDGER);
+        for (size_t i = 0; i < ledgerCount(); i++) {
+            if (ledger[i].operation > static_cast<uint32_t>(StockOperation::DOCUMENT_CANCEL)) {
+                return fail("Поврежденный журнал движения");
+            }
+        }
+    }
+    if (!hasDocumentContents()) return true;
+
+    if (header->sections[SECTION_DOCUMENT_ITEMS].size % sizeof(SnapshotItemRecord) != 0 ||
+        header->sections[SECTION_DOCUMENT_FIELDS].size % sizeof(SnapshotFieldRecord) != 0) {
+        return fail("Поврежденное содержимое документов");
+    }
+    uint64_t itemCount = header->sections[SECTION_DOCUMENT_ITEMS].size / sizeof(SnapshotItemRecord);
+    uint64_t fieldCount = header->sections[SECTION_DOCUMENT_FIELDS].size / sizeof(SnapshotFieldRecord);
+    auto validRef = [stringBytes](const SnapshotStringRef& ref) {
+        return uint64_t(ref.offset) + ref.length <= stringBytes;
+    };
+
+    const SnapshotDocumentContent* contents =
+        section<SnapshotDocumentContent>(SECTION_DOCUMENT_CONTENTS);
+    for (uint64_t i = 0; i < header->documentCount; i++) {
+        if (uint64_t(contents[i].firstItem) + contents[i].itemCount > itemCount ||
+            uint64_t(contents[i].firstField) + contents[i].fieldCount > fieldCount) {
+            return fail("Поврежденное содержимое документов");
+        }
+    }
+    const SnapshotItemRecord* items = section<SnapshotItemRecord>(SECTION_DOCUMENT_ITEMS);
+    for (uint64_t i = 0; i < itemCount; i++) {
+        if (!validRef(items[i].name) || !validRef(items[i].comment)) {
+            return fail("Поврежденные строки документов");
+        }
+    }
+    const SnapshotFieldRecord* fields = section<SnapshotFieldRecord>(SECTION_DOCUMENT_FIELDS);
+    for (uint64_t i = 0; i < fieldCount; i++) {
+        if (!validRef(fields[i].key) || !validRef(fields[i].value)) {
+            return fail("Поврежденные строки документов");
+        }
+    }
+    return true;
+}
+
+void SnapshotContentSource::load(uint32_t index, vector<DocumentLine>& items,
+                                 vector<string>& comments, DocumentFieldSlots fields) const {
+    if (!reader->hasDocumentContents()) return;
+
+    const SnapshotDocumentContent& content =
+        reader->section<SnapshotDocumentContent>(SECTION_DOCUMENT_CONTENTS)[index];
+    const SnapshotItemRecord* records = reader->section<SnapshotItemRecord>(SECTION_DOCUMENT_ITEMS);
+    DocumentStringPool& pool = DocumentStringPool::instance();
+    items.reserve(content.itemCount);
+    for (uint32_t i = 0; i < content.itemCount; i++) {
+        const SnapshotItemRecord& record = records[content.firstItem + i];
+        uint32_t comment = DocumentLine::NO_COMMENT;
+        if (record.comment.length > 0) {
+            comments.emplace_back(reader->documentString(record.comment));
+            comment = static_cast<uint32_t>(comments.size());
+        }
+        items.push_back(DocumentLine{record.productId, record.quantity, record.price,
+                                     pool.intern(reader->documentString(record.name)), comment});
+    }
+
+    const SnapshotFieldRecord* fieldRecords = reader->section<SnapshotFieldRecord>(SECTION_DOCUMENT_FIELDS);
+    for (uint32_t i = 0; i < content.fieldCount; i++) {
+        const SnapshotFieldRecord& field = fieldRecords[content.firstField + i];
+        fields.set(reader->documentString(field.key), reader->documentString(field.value));
+    }
+}
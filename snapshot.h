@@ -0,0 +1,246 @@
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include "mapped_file.h"
+#include "document.h"
+#include "product_store.h"
+#include "stock_ledger.h"
+#include <string>
+#include <string_view>
+#include <vector>
+#include <memory>
+#include <unordered_map>
+#include <functional>
+#include <cstdint>
+#include <cstddef>
+
+// Двоичный снимок склада.
+//
+// Файл состоит из заголовка SnapshotHeader и секций, выровненных по 8 байт.
+// Колонки товаров записаны в том же виде, в каком лежат в ProductStore,
+// поэтому при загрузке файл отображается в память и колонки копируются
+// без разбора. Порядок байт - порядок машины, записавшей файл (little-endian
+// на всех поддерживаемых платформах). Контрольная сумма покрывает весь
+// файл, включая заголовок (поле checksum считается нулевым).
+//
+// Версия 2 добавляет содержимое документов: строки (DocumentLine) и
+// специфичные поля. Повторяющиеся строки (ключи полей, подразделения,
+// авторы, наименования товаров в строках) хранятся в секции строк один раз.
+// Файлы версии 1 читаются как документы без содержимого.
+//
+// В версии 3 контрольная сумма покрывает и заголовок; в файлах версий 1 и 2
+// она проверяется только по секциям.
+//
+// Версия 4 добавляет журнал движения товаров (StockLedger); в файлах
+// прежних версий его нет, и после загрузки журнал движения пуст.
+
+constexpr char SNAPSHOT_MAGIC[8] = {'S', 'K', 'L', 'A', 'D', 'S', 'N', 'P'};
+constexpr uint32_t SNAPSHOT_VERSION = 4;
+
+enum SnapshotSectionId : uint32_t {
+    SECTION_PRODUCT_IDS,           // int32[productCount]
+    SECTION_PRODUCT_QUANTITIES,    // int32[productCount]
+    SECTION_PRODUCT_PRICES,        // double[productCount]
+    SECTION_PRODUCT_NAME_OFFSETS,  // uint32[productCount + 1]
+    SECTION_PRODUCT_NAMES,         // байты наименований подряд
+    SECTION_DOCUMENTS,             // SnapshotDocumentRecord[documentCount]
+    SECTION_DOCUMENT_STRINGS,      // строки документов подряд
+    SECTION_DOCUMENT_CONTENTS,     // SnapshotDocumentContent[documentCount] (с версии 2)
+    SECTION_DOCUMENT_ITEMS,        // SnapshotItemRecord[...]
+    SECTION_DOCUMENT_FIELDS,       // SnapshotFieldRecord[...]
+    SECTION_LEDGER,                // SnapshotLedgerRecord[...] (с версии 4)
+    SECTION_COUNT
+};
+
+// Место под секции будущих версий формата
+constexpr uint32_t SNAPSHOT_SECTION_SLOTS = 16;
+
+struct SnapshotSection {
+    uint64_t offset;
+    uint64_t size;
+};
+
+struct SnapshotHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize;
+    uint64_t checksum;
+    uint64_t fileSize;
+    uint64_t productCount;
+    uint64_t documentCount;
+    int32_t nextProductId;
+    int32_t nextDocumentId;
+    uint64_t logGeneration;        // первое поколение журнала, не вошедшее в снимок
+    // Чьему состоянию соответствует снимок при обмене пакетами изменений
+    // (см. change_delta.h): склад-источник и позиция его журнала; 0 - обмена нет
+    uint64_t syncSource;
+    uint64_t syncGeneration;
+    uint64_t syncOffset;
+    SnapshotSection sections[SNAPSHOT_SECTION_SLOTS];
+};
+
+struct SnapshotStringRef {
+    uint32_t offset;
+    uint32_t length;
+};
+
+struct SnapshotDocumentRecord {
+    int32_t id;
+    int32_t type;
+    int64_t date;
+    SnapshotStringRef number;
+    SnapshotStringRef status;
+    SnapshotStringRef createdBy;
+    SnapshotStringRef department;
+    SnapshotStringRef comment;
+};
+
+// Диапазоны строк и полей документа в секциях ITEMS и FIELDS
+struct SnapshotDocumentContent {
+    uint32_t firstItem;
+    uint32_t itemCount;
+    uint32_t firstField;
+    uint32_t fieldCount;
+};
+
+struct SnapshotItemRecord {
+    int32_t productId;
+    int32_t quantity;
+    double price;                  // цена товара на момент добавления строки
+    SnapshotStringRef name;
+    SnapshotStringRef comment;
+};
+
+struct SnapshotFieldRecord {
+    SnapshotStringRef key;
+    SnapshotStringRef value;
+};
+
+// Запись журнала движения (см. LedgerEntry)
+struct SnapshotLedgerRecord {
+    int64_t timestamp;
+    int32_t productId;
+    int32_t delta;
+    int32_t documentId;
+    uint32_t operation;
+};
+
+// Потоковая контрольная сумма (FNV-1a по 8-байтовым словам)
+class SnapshotChecksum {
+private:
+    uint64_t hash = 0xcbf29ce484222325ULL;
+    unsigned char tail[8];
+    size_t tailSize = 0;
+
+    void mix(uint64_t word) { hash = (hash ^ word) * 0x100000001b3ULL; }
+
+public:
+    void update(const void* data, size_t size);
+    uint64_t finish() const;
+};
+
+class SnapshotReader;
+
+// Документ на момент снятия копии. Заголовок документа, кроме статуса,
+// после создания не меняется и читается из самого документа.
+struct SnapshotDocumentCapture {
+    std::shared_ptr<const DocumentBase> document;
+    DocumentStatus status = DocumentStatus::DRAFT;
+    // Содержимое, еще не загруженное из прежнего снимка (его держит сам
+    // документ), или разделенное с документом (DocumentBase::shareContent)
+    const SnapshotReader* contentReader = nullptr;
+    uint32_t contentIndex = 0;
+    DocumentContentShare content;
+};
+
+// Копия состояния склада, готовая к записи. Снимается под блокировкой
+// склада, а записывается на диск уже без нее (в том числе в фоновом потоке).
+// Под блокировкой ничего не сериализуется: колонки товаров и содержимое
+// документов разделяются с ProductStore и документами до первого изменения,
+// журнал движения - с StockLedger по блокам, а документы, еще не загруженные
+// из прежнего снимка, остаются в его отображенном файле.
+struct SnapshotImage {
+    ProductColumns products;
+    StockLedger::Shared ledger;
+    std::shared_ptr<const SnapshotReader> unloadedDocuments;
+    std::vector<SnapshotDocumentCapture> documents;
+    int32_t nextProductId = 0;
+    int32_t nextDocumentId = 0;
+    uint64_t logGeneration = 0;
+    uint64_t syncSource = 0;
+    uint64_t syncGeneration = 0;
+    uint64_t syncOffset = 0;
+};
+
+// Ход записи снимка: записано байт из общего размера файла.
+// Вызывается из потока, который пишет снимок.
+using SnapshotProgress = std::function<void(uint64_t written, uint64_t total)>;
+
+class SnapshotWriter {
+public:
+    // unloadedDocuments - снимок, документы которого еще не загружены в реестр:
+    // их записи переносятся в новый снимок без создания объектов
+    static SnapshotImage capture(const ProductStore& products,
+                                 const std::vector<std::shared_ptr<DocumentBase>>& documents,
+                                 int nextProductId, int nextDocumentId,
+                                 uint64_t logGeneration = 0,
+                                 std::shared_ptr<const SnapshotReader> unloadedDocuments = nullptr);
+
+    // Записывает снимок во временный файл и атомарно переименовывает его в filename
+    static bool write(const std::string& filename, const SnapshotImage& image,
+                      const SnapshotProgress& progress = nullptr);
+};
+
+// Чтение снимка прямо из отображенного в память файла
+class SnapshotReader {
+private:
+    MappedFile file;
+    const SnapshotHeader* header = nullptr;
+    std::string error;
+
+    bool fail(const std::string& message);
+
+public:
+    bool open(const std::string& filename, bool verifyChecksum = true);
+    const std::string& getError() const { return error; }
+
+    const SnapshotHeader& getHeader() const { return *header; }
+    size_t productCount() const { return static_cast<size_t>(header->productCount); }
+    size_t documentCount() const { return static_cast<size_t>(header->documentCount); }
+
+    template<typename T>
+    const T* section(SnapshotSectionId id) const {
+        return reinterpret_cast<const T*>(file.data() + header->sections[id].offset);
+    }
+
+    std::string_view documentString(const SnapshotStringRef& ref) const {
+        return std::string_view(section<char>(SECTION_DOCUMENT_STRINGS) + ref.offset, ref.length);
+    }
+
+    // Есть ли в файле строки и поля документов (версия 2 и выше)
+    bool hasDocumentContents() const { return header->version >= 2; }
+
+    // Записи журнала движения (версия 4 и выше, иначе 0)
+    size_t ledgerCount() const {
+        if (header->version < 4) return 0;
+        return static_cast<size_t>(header->sections[SECTION_LEDGER].size / sizeof(SnapshotLedgerRecord));
+    }
+};
+
+// Содержимое документов, которое остается в отображенном снимке до первого
+// обращения к документу. Держит файл открытым, пока на него ссылаются документы.
+class SnapshotContentSource : public DocumentContentSource {
+private:
+    std::shared_ptr<const SnapshotReader> reader;
+
+public:
+    explicit SnapshotContentSource(std::shared_ptr<const SnapshotReader> _reader)
+        : reader(std::move(_reader)) {}
+
+    void load(uint32_t index, std::vector<DocumentLine>& items, std::vector<std::string>& comments,
+              DocumentFieldSlots fields) const override;
+
+    const SnapshotReader& getReader() const { return *reader; }
+};
+
+#endif // SNAPSHOT_H
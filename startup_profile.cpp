@@ -0,0 +1,60 @@
+#include "startup_profile.h"
+#include <fstream>
+#include <sstream>
+#include <iomanip>
+#include <ctime>
+
+// Номер версии приходит из CMake (project VERSION)
+#ifndef WAREHOUSE_VERSION
+#define WAREHOUSE_VERSION "dev"
+#endif
+
+using namespace std;
+
+StartupProfile& StartupProfile::instance() {
+    static StartupProfile profile;
+    return profile;
+}
+
+StartupProfile::StartupProfile() : start(Clock::now()), last(start) {}
+
+void StartupProfile::mark(const string& phase) {
+    Clock::time_point now = Clock::now();
+    phases.emplace_back(phase, chrono::duration<double, milli>(now - last).count());
+    last = now;
+}
+
+double StartupProfile::elapsedMs() const {
+    return chrono::duration<double, milli>(last - start).count();
+}
+
+string StartupProfile::summary() const {
+    ostringstream out;
+    out << fixed << setprecision(1);
+    for (const auto& phase : phases) {
+        out << phase.first << " " << phase.second << " мс, ";
+    }
+    out << "всего " << elapsedMs() << " мс";
+    return out.str();
+}
+
+bool StartupProfile::appendToLog(const string& filename) const {
+    ofstream file(filename, ios::app);
+    if (!file.is_open()) return false;
+
+    time_t now = time(nullptr);
+    char dateBuffer[32];
+    strftime(dateBuffer, sizeof(dateBuffer), "%Y-%m-%d %H:%M:%S", localtime(&now));
+
+    file << fixed << setprecision(1);
+    file << dateBuffer << " " << version() << " total=" << elapsedMs();
+    for (const auto& phase : phases) {
+        file << " " << phase.first << "=" << phase.second;
+    }
+    file << "\n";
+    return file.good();
+}
+
+const char* StartupProfile::version() {
+    return WAREHOUSE_VERSION;
+}
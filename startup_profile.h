@@ -0,0 +1,37 @@
+#ifndef STARTUP_PROFILE_H
+#define STARTUP_PROFILE_H
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+// Замер времени запуска по этапам: от старта процесса до окна, готового
+// к работе. Итог дописывается строкой в журнал запусков, чтобы сравнивать
+// время старта между версиями (main.cpp делает это, только если задан
+// SKLAD_STARTUP_LOG).
+class StartupProfile {
+public:
+    static StartupProfile& instance();
+
+    // Закрывает этап: время с предыдущей отметки
+    void mark(const std::string& phase);
+    double elapsedMs() const;
+
+    // "этап 12.3 мс, ..., всего 45.6 мс"
+    std::string summary() const;
+    // Строка "дата версия всего этап=мс ..." в конец файла
+    bool appendToLog(const std::string& filename) const;
+
+    static const char* version();
+
+private:
+    using Clock = std::chrono::steady_clock;
+
+    StartupProfile();
+
+    Clock::time_point start;
+    Clock::time_point last;
+    std::vector<std::pair<std::string, double>> phases;
+};
+
+#endif // STARTUP_PROFILE_H
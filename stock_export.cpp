@@ -0,0 +1,251 @@
+#include "stock_export.h"
+#include <cstdio>
+#include <ctime>
+#include <charconv>
+#include <filesystem>
+
+using namespace std;
+
+namespace {
+
+void appendInt(string& out, long long value) {
+    char digits[24];
+    auto end = to_chars(digits, digits + sizeof(digits), value).ptr;
+    out.append(digits, end);
+}
+
+void appendMoney(string& out, double value) {
+    char digits[64];
+    auto result = to_chars(digits, digits + sizeof(digits), value, chars_format::fixed, 2);
+    if (result.ec == errc()) out.append(digits, result.ptr);
+    else out += '0';
+}
+
+// Дополняет или обрезает текст до width символов, не разрывая символ UTF-8
+void appendPadded(string& out, string_view text, size_t width, bool alignRight) {
+    size_t length = 0;
+    size_t characters = 0;
+    while (length < text.size()) {
+        size_t next = length + 1;
+        while (next < text.size() && (static_cast<unsigned char>(text[next]) & 0xC0) == 0x80) next++;
+        if (characters == width) break;
+        length = next;
+        characters++;
+    }
+    if (alignRight) out.append(width - characters, ' ');
+    out.append(text.data(), length);
+    if (!alignRight) out.append(width - characters, ' ');
+}
+
+void appendCsvField(string& out, string_view value) {
+    if (value.find_first_of(",\"\r\n") == string_view::npos) {
+        out.append(value.data(), value.size());
+        return;
+    }
+    out += '"';
+    for (char c : value) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    out += '"';
+}
+
+void appendJsonString(string& out, string_view value) {
+    static const char hex[] = "0123456789abcdef";
+    out += '"';
+    for (char c : value) {
+        unsigned char byte = static_cast<unsigned char>(c);
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (c == '\n') {
+            out += "\\n";
+        } else if (c == '\r') {
+            out += "\\r";
+        } else if (c == '\t') {
+            out += "\\t";
+        } else if (byte < 0x20) {
+            out += "\\u00";
+            out += hex[byte >> 4];
+            out += hex[byte & 15];
+        } else {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+// Ширина колонок текстового отчета
+const size_t ID_WIDTH = 8;
+const size_t NAME_WIDTH = 40;
+const size_t QUANTITY_WIDTH = 10;
+const size_t PRICE_WIDTH = 14;
+const size_t TOTAL_WIDTH = 16;
+
+} // namespace
+
+const char* StockExporter::extension(StockExportFormat format) {
+    switch (format) {
+        case StockExportFormat::CSV: return ".csv";
+        case StockExportFormat::JSON_LINES: return ".jsonl";
+        case StockExportFormat::FIXED_WIDTH: return ".txt";
+    }
+    return "";
+}
+
+void StockExporter::appendHeader(StockExportFormat format, size_t rows) {
+    switch (format) {
+        case StockExportFormat::CSV:
+            buffer += "id,name,quantity,price,total\n";
+            break;
+        case StockExportFormat::JSON_LINES:
+            break;
+        case StockExportFormat::FIXED_WIDTH: {
+            time_t now = time(nullptr);
+            char dateBuffer[32];
+            strftime(dateBuffer, sizeof(dateBuffer), "%d.%m.%Y %H:%M", localtime(&now));
+            buffer += "ОТЧЕТ ПО СКЛАДУ\n";
+            buffer += "Дата: ";
+            buffer += dateBuffer;
+            buffer += "\nТоваров: ";
+            appendInt(buffer, static_cast<long long>(rows));
+            buffer += "\n\n";
+            appendPadded(buffer, "ID", ID_WIDTH, true);
+            buffer += ' ';
+            appendPadded(buffer, "Наименование", NAME_WIDTH, false);
+            appendPadded(buffer, "Кол-во, шт.", QUANTITY_WIDTH + 1, true);
+            appendPadded(buffer, "Цена, руб.", PRICE_WIDTH + 1, true);
+            appendPadded(buffer, "Стоимость, руб.", TOTAL_WIDTH + 1, true);
+            buffer += '\n';
+            buffer.append(ID_WIDTH + NAME_WIDTH + QUANTITY_WIDTH + PRICE_WIDTH + TOTAL_WIDTH + 4, '-');
+            buffer += '\n';
+            break;
+        }
+    }
+}
+
+void StockExporter::appendRow(StockExportFormat format, int id, string_view name,
+                              int quantity, double price) {
+    double total = price * quantity;
+    switch (format) {
+        case StockExportFormat::CSV:
+            appendInt(buffer, id);
+            buffer += ',';
+            appendCsvField(buffer, name);
+            buffer += ',';
+            appendInt(buffer, quantity);
+            buffer += ',';
+            appendMoney(buffer, price);
+            buffer += ',';
+            appendMoney(buffer, total);
+            buffer += '\n';
+            break;
+        case StockExportFormat::JSON_LINES:
+            buffer += "{\"id\":";
+            appendInt(buffer, id);
+            buffer += ",\"name\":";
+            appendJsonString(buffer, name);
+            buffer += ",\"quantity\":";
+            appendInt(buffer, quantity);
+            buffer += ",\"price\":";
+            appendMoney(buffer, price);
+            buffer += ",\"total\":";
+            appendMoney(buffer, total);
+            buffer += "}\n";
+            break;
+        case StockExportFormat::FIXED_WIDTH: {
+            string digits;
+            appendInt(digits, id);
+            appendPadded(buffer, digits, ID_WIDTH, true);
+            buffer += ' ';
+            appendPadded(buffer, name, NAME_WIDTH, false);
+            buffer += ' ';
+            digits.clear();
+            appendInt(digits, quantity);
+            appendPadded(buffer, digits, QUANTITY_WIDTH, true);
+            buffer += ' ';
+            digits.clear();
+            appendMoney(digits, price);
+            appendPadded(buffer, digits, PRICE_WIDTH, true);
+            buffer += ' ';
+            digits.clear();
+            appendMoney(digits, total);
+            appendPadded(buffer, digits, TOTAL_WIDTH, true);
+            buffer += '\n';
+            break;
+        }
+    }
+}
+
+StockExportResult StockExporter::write(const ProductColumns& products, const string& filename,
+                                       StockExportFormat format, const atomic<bool>* cancel,
+                                       const StockExportProgress& progress) {
+    StockExportResult result;
+    string partPath = filename + ".part";
+    FILE* file = fopen(partPath.c_str(), "wb");
+    if (!file) {
+        result.error = "Не удалось создать файл " + partPath;
+        return result;
+    }
+
+    size_t total = products.size();
+    const int* ids = total > 0 ? products.ids->data() : nullptr;
+    const int* quantities = total > 0 ? products.quantities->data() : nullptr;
+    const double* prices = total > 0 ? products.prices->data() : nullptr;
+
+    // Запас сверх BUFFER_SIZE - под строку, на которой буфер переполнился
+    buffer.clear();
+    buffer.reserve(BUFFER_SIZE + 64 * 1024);
+
+    auto flush = [&]() {
+        if (fwrite(buffer.data(), 1, buffer.size(), file) != buffer.size()) {
+            result.error = "Ошибка записи в файл " + partPath;
+            return false;
+        }
+        result.bytes += buffer.size();
+        buffer.clear();
+        return true;
+    };
+
+    bool ok = true;
+    appendHeader(format, total);
+    for (size_t slot = 0; slot < total; slot++) {
+        appendRow(format, ids[slot], products.nameAt(slot), quantities[slot], prices[slot]);
+        if (buffer.size() < BUFFER_SIZE) continue;
+
+        if (!flush()) {
+            ok = false;
+            break;
+        }
+        result.rows = slot + 1;
+        if (progress) progress(result.rows, total);
+        if (cancel && cancel->load(memory_order_relaxed)) {
+            result.cancelled = true;
+            ok = false;
+            break;
+        }
+    }
+    if (ok && flush()) result.rows = total;
+    else ok = false;
+
+    if (fclose(file) != 0 && ok) {
+        result.error = "Ошибка записи в файл " + partPath;
+        ok = false;
+    }
+
+    error_code code;
+    if (ok) {
+        filesystem::rename(partPath, filename, code);
+        if (code) {
+            result.error = "Не удалось переименовать " + partPath + ": " + code.message();
+            ok = false;
+        }
+    }
+    if (!ok) {
+        filesystem::remove(partPath, code);
+        return result;
+    }
+    if (progress) progress(total, total);
+    result.success = true;
+    return result;
+}
@@ -0,0 +1,57 @@
+#ifndef STOCK_EXPORT_H
+#define STOCK_EXPORT_H
+
+#include "product_store.h"
+#include <string>
+#include <functional>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+enum class StockExportFormat {
+    CSV,            // id,name,quantity,price,total с заголовком
+    JSON_LINES,     // один JSON-объект на строку
+    FIXED_WIDTH     // текстовый отчет с колонками фиксированной ширины
+};
+
+struct StockExportResult {
+    bool success = false;
+    bool cancelled = false;
+    std::string error;
+    size_t rows = 0;
+    uint64_t bytes = 0;
+};
+
+// (записано строк, всего строк)
+using StockExportProgress = std::function<void(size_t written, size_t total)>;
+
+// Потоковая выгрузка остатков.
+//
+// Работает по неизменяемой копии колонок (ProductStore::shareColumns),
+// поэтому может идти в любом потоке, пока склад меняется. Строки
+// форматируются в буфер на BUFFER_SIZE байт, который сбрасывается в файл
+// целиком и переиспользуется: файл любого размера не собирается в памяти.
+// Пишется во временный <filename>.part, переименовываемый по завершении;
+// при отмене или ошибке он удаляется, прежний файл остается нетронутым.
+class StockExporter {
+public:
+    static constexpr size_t BUFFER_SIZE = 4 * 1024 * 1024;
+
+    // cancel проверяется при каждом сбросе буфера; progress вызывается
+    // из потока выгрузки после каждого сброса
+    StockExportResult write(const ProductColumns& products, const std::string& filename,
+                            StockExportFormat format,
+                            const std::atomic<bool>* cancel = nullptr,
+                            const StockExportProgress& progress = nullptr);
+
+    static const char* extension(StockExportFormat format);
+
+private:
+    std::string buffer;
+
+    void appendHeader(StockExportFormat format, size_t rows);
+    void appendRow(StockExportFormat format, int id, std::string_view name,
+                   int quantity, double price);
+};
+
+#endif // STOCK_EXPORT_H
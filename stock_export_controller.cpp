@@ -0,0 +1,54 @@
+#include "stock_export_controller.h"
+#include "warehouse.h"
+#include <QMetaObject>
+
+using namespace std;
+
+StockExportController::StockExportController(Warehouse& _warehouse, QObject* parent)
+    : QObject(parent), warehouse(_warehouse) {}
+
+StockExportController::~StockExportController() {
+    cancelRequested = true;
+    if (task.valid()) task.wait();
+}
+
+bool StockExportController::start(const QString& filename, StockExportFormat format) {
+    if (running) return false;
+
+    ProductColumns products = warehouse.shareProductColumns();
+    string path = filename.toStdString();
+    cancelRequested = false;
+    error.clear();
+    running = true;
+    timer.start();
+
+    // Как и в AsyncSaveController, обратные вызовы уходят в поток интерфейса
+    // очередью событий
+    task = async(launch::async, [this, products, path, format]() {
+        int lastPercent = -1;
+        auto onProgress = [this, &lastPercent](size_t written, size_t total) {
+            int percent = total > 0 ? static_cast<int>(written * 100 / total) : 100;
+            if (percent == lastPercent) return;
+            lastPercent = percent;
+            QMetaObject::invokeMethod(this, [this, percent] { emit progress(percent); },
+                                      Qt::QueuedConnection);
+        };
+        StockExportResult result = exporter.write(products, path, format,
+                                                  &cancelRequested, onProgress);
+        QMetaObject::invokeMethod(this, [this, result] { complete(result); },
+                                  Qt::QueuedConnection);
+    });
+    emit started();
+    return true;
+}
+
+void StockExportController::cancel() {
+    cancelRequested = true;
+}
+
+void StockExportController::complete(const StockExportResult& result) {
+    task.get();
+    running = false;
+    error = QString::fromStdString(result.error);
+    emit finished(result.success, result.cancelled, static_cast<qint64>(result.rows), timer.elapsed());
+}
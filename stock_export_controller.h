@@ -0,0 +1,49 @@
+#ifndef STOCK_EXPORT_CONTROLLER_H
+#define STOCK_EXPORT_CONTROLLER_H
+
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+#include <atomic>
+#include <future>
+#include "stock_export.h"
+
+class Warehouse;
+
+// Выгрузка остатков в фоновом потоке (StockExporter).
+//
+// Колонки каталога снимаются в потоке интерфейса без копирования данных,
+// дальше поток выгрузки работает только с ними - склад можно менять.
+// Ход и результат передаются сигналами в поток интерфейса.
+class StockExportController : public QObject {
+    Q_OBJECT
+
+public:
+    explicit StockExportController(Warehouse& warehouse, QObject* parent = nullptr);
+    // Прерывает незавершенную выгрузку и ждет поток
+    ~StockExportController();
+
+    // false - выгрузка уже идет
+    bool start(const QString& filename, StockExportFormat format);
+    void cancel();
+    bool isRunning() const { return running; }
+    const QString& errorString() const { return error; }
+
+signals:
+    void started();
+    void progress(int percent);
+    void finished(bool success, bool cancelled, qint64 rows, qint64 elapsedMs);
+
+private:
+    Warehouse& warehouse;
+    StockExporter exporter;
+    std::future<void> task;
+    std::atomic<bool> cancelRequested{false};
+    bool running = false;
+    QString error;
+    QElapsedTimer timer;
+
+    void complete(const StockExportResult& result);
+};
+
+#endif // STOCK_EXPORT_CONTROLLER_H
@@ -0,0 +1,97 @@
+#include "stock_ledger.h"
+#include <unordered_map>
+#include <algorithm>
+
+using namespace std;
+
+long long StockLedger::partitionOf(time_t timestamp) {
+    // Деление с округлением вниз, чтобы время до 1970 года не попадало в нулевые сутки
+    long long seconds = static_cast<long long>(timestamp);
+    long long day = seconds / PARTITION_SECONDS;
+    if (seconds % PARTITION_SECONDS < 0) day--;
+    return day;
+}
+
+void StockLedger::append(time_t timestamp, int productId, int delta, int documentId,
+                         StockOperation operation) {
+    long long day = partitionOf(timestamp);
+    Partition& partition = partitions[day];
+    if (partition.blocks.empty() || partition.blocks.back()->count == BLOCK_SIZE) {
+        partition.blocks.push_back(make_shared<Block>());
+    }
+
+    Block& block = *partition.blocks.back();
+    size_t i = block.count++;
+    block.offsets[i] = static_cast<uint32_t>(timestamp - static_cast<time_t>(day) * PARTITION_SECONDS);
+    block.productIds[i] = productId;
+    block.deltas[i] = delta;
+    block.documentIds[i] = documentId;
+    block.operations[i] = static_cast<uint8_t>(operation);
+
+    if (i == 0 || timestamp < block.minTime) block.minTime = timestamp;
+    if (i == 0 || timestamp > block.maxTime) block.maxTime = timestamp;
+    entryCount++;
+}
+
+void StockLedger::clear() {
+    partitions.clear();
+    entryCount = 0;
+}
+
+StockLedger::Shared StockLedger::share() const {
+    Shared shared;
+    for (const auto& [day, partition] : partitions) {
+        time_t partitionStart = static_cast<time_t>(day) * PARTITION_SECONDS;
+        for (const auto& block : partition.blocks) {
+            shared.parts.push_back({partitionStart, block, block->count});
+        }
+    }
+    shared.entryCount = entryCount;
+    return shared;
+}
+
+vector<MovementSummary> StockLedger::summarize(time_t from, time_t to) const {
+    unordered_map<int, MovementSummary> byProduct;
+    if (from < to) {
+        auto first = partitions.lower_bound(partitionOf(from));
+        auto last = partitions.upper_bound(partitionOf(to - 1));
+        for (auto it = first; it != last; ++it) {
+            time_t partitionStart = static_cast<time_t>(it->first) * PARTITION_SECONDS;
+            for (const auto& block : it->second.blocks) {
+                if (block->maxTime < from || block->minTime >= to) continue;
+
+                // Границы периода переводим в смещения блока, чтобы сравнивать
+                // прямо колонку offsets без пересчета времени каждой записи
+                long long lowOffset = max<long long>(0, from - partitionStart);
+                long long highOffset = static_cast<long long>(to - partitionStart);
+                const uint32_t* offsets = block->offsets.data();
+                const int32_t* productIds = block->productIds.data();
+                const int32_t* deltas = block->deltas.data();
+                for (size_t i = 0; i < block->count; i++) {
+                    long long offset = offsets[i];
+                    if (offset < lowOffset || offset >= highOffset) continue;
+                    MovementSummary& summary = byProduct[productIds[i]];
+                    if (deltas[i] >= 0) summary.incoming += deltas[i];
+                    else summary.outgoing -= deltas[i];
+                    summary.operations++;
+                }
+            }
+        }
+    }
+
+    vector<MovementSummary> result;
+    result.reserve(byProduct.size());
+    for (auto& [productId, summary] : byProduct) {
+        summary.productId = productId;
+        result.push_back(summary);
+    }
+    sort(result.begin(), result.end(),
+         [](const MovementSummary& a, const MovementSummary& b) { return a.productId < b.productId; });
+    return result;
+}
+
+vector<LedgerEntry> StockLedger::entries(time_t from, time_t to) const {
+    vector<LedgerEntry> result;
+    forEach(from, to, [&result](const LedgerEntry& entry) { result.push_back(entry); });
+    return result;
+}
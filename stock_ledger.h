@@ -0,0 +1,142 @@
+#ifndef STOCK_LEDGER_H
+#define STOCK_LEDGER_H
+
+#include <vector>
+#include <array>
+#include <map>
+#include <memory>
+#include <ctime>
+#include <cstdint>
+#include <cstddef>
+
+// Вид операции, изменившей остаток
+enum class StockOperation : uint8_t {
+    PRODUCT_CREATED,
+    PRODUCT_REMOVED,
+    MANUAL_SET,
+    MANUAL_ADD,
+    MANUAL_REMOVE,
+    DOCUMENT_POSTING,
+    DOCUMENT_CANCEL
+};
+
+struct LedgerEntry {
+    time_t timestamp;
+    int productId;
+    int delta;
+    int documentId;     // 0, если изменение не связано с документом
+    StockOperation operation;
+};
+
+// Движение одного товара за период
+struct MovementSummary {
+    int productId = 0;
+    long long incoming = 0;
+    long long outgoing = 0;
+    size_t operations = 0;
+};
+
+// Журнал движения товаров: только добавление записей.
+// Записи лежат в разделах по суткам, раздел - в блоках фиксированного размера,
+// каждый блок хранит поля колонками, чтобы сканирование периода читало
+// только нужные данные и пропускало целые разделы и блоки вне периода.
+class StockLedger {
+    struct Block;
+
+public:
+    static constexpr size_t BLOCK_SIZE = 1024;
+    static constexpr time_t PARTITION_SECONDS = 24 * 60 * 60;
+
+    void append(time_t timestamp, int productId, int delta, int documentId,
+                StockOperation operation);
+    void clear();
+    size_t size() const { return entryCount; }
+
+    // Сводка по товарам за [from, to), отсортированная по id товара
+    std::vector<MovementSummary> summarize(time_t from, time_t to) const;
+
+    // Все записи периода [from, to) в порядке добавления внутри суток
+    std::vector<LedgerEntry> entries(time_t from, time_t to) const;
+
+    // Обход записей периода без промежуточных контейнеров
+    template<typename Visitor>
+    void forEach(time_t from, time_t to, Visitor&& visit) const;
+
+    // Записи журнала на момент share(). Блоки разделяются с журналом, а не
+    // копируются: добавленные записи не меняются, а дописанные после share()
+    // в копию не попадают, поэтому ее можно читать из другого потока.
+    class Shared {
+    public:
+        size_t size() const { return entryCount; }
+        // Обход всех записей копии в порядке хранения
+        template<typename Visitor>
+        void forEach(Visitor&& visit) const;
+
+    private:
+        friend class StockLedger;
+        struct Part {
+            time_t partitionStart;
+            std::shared_ptr<const Block> block;
+            size_t count;
+        };
+        std::vector<Part> parts;
+        size_t entryCount = 0;
+    };
+    Shared share() const;
+
+private:
+    struct Block {
+        size_t count = 0;
+        time_t minTime = 0;
+        time_t maxTime = 0;
+        std::array<uint32_t, BLOCK_SIZE> offsets;   // секунды от начала раздела
+        std::array<int32_t, BLOCK_SIZE> productIds;
+        std::array<int32_t, BLOCK_SIZE> deltas;
+        std::array<int32_t, BLOCK_SIZE> documentIds;
+        std::array<uint8_t, BLOCK_SIZE> operations;
+    };
+
+    struct Partition {
+        std::vector<std::shared_ptr<Block>> blocks;
+    };
+
+    std::map<long long, Partition> partitions;  // номер суток -> раздел
+    size_t entryCount = 0;
+
+    static long long partitionOf(time_t timestamp);
+};
+
+template<typename Visitor>
+void StockLedger::forEach(time_t from, time_t to, Visitor&& visit) const {
+    if (from >= to) return;
+    auto first = partitions.lower_bound(partitionOf(from));
+    auto last = partitions.upper_bound(partitionOf(to - 1));
+    for (auto it = first; it != last; ++it) {
+        time_t partitionStart = static_cast<time_t>(it->first) * PARTITION_SECONDS;
+        for (const auto& block : it->second.blocks) {
+            if (block->maxTime < from || block->minTime >= to) continue;
+            bool wholeBlock = block->minTime >= from && block->maxTime < to;
+            for (size_t i = 0; i < block->count; i++) {
+                time_t timestamp = partitionStart + block->offsets[i];
+                if (!wholeBlock && (timestamp < from || timestamp >= to)) continue;
+                visit(LedgerEntry{timestamp, block->productIds[i], block->deltas[i],
+                                  block->documentIds[i],
+                                  static_cast<StockOperation>(block->operations[i])});
+            }
+        }
+    }
+}
+
+template<typename Visitor>
+void StockLedger::Shared::forEach(Visitor&& visit) const {
+    for (const auto& part : parts) {
+        const Block& block = *part.block;
+        for (size_t i = 0; i < part.count; i++) {
+            visit(LedgerEntry{part.partitionStart + block.offsets[i], block.productIds[i],
+                              block.deltas[i], block.documentIds[i],
+                              static_cast<StockOperation>(block.operations[i])});
+        }
+    }
+}
+
+#endif // STOCK_LEDGER_H
@@ -0,0 +1,93 @@
+#include "stock_posting.h"
+#include "document.h"
+#include <unordered_map>
+
+using namespace std;
+
+int PostingEngine::directionOf(DocumentType type) {
+    switch(type) {
+        case DocumentType::INCOME_INVOICE: return 1;
+        case DocumentType::OUTCOME_INVOICE: return -1;
+        case DocumentType::RECEIPT: return -1;
+        case DocumentType::INVENTORY: return 0;
+    }
+    return 0;
+}
+
+PostingResult PostingEngine::prepare(const DocumentBase& doc, const ProductStore& products,
+                                     vector<StockChange>& changes) {
+    return prepare(doc, products, directionOf(doc.getType()), changes);
+}
+
+PostingResult PostingEngine::prepareReversal(const DocumentBase& doc, const ProductStore& products,
+                                             vector<StockChange>& changes) {
+    if (doc.getType() == DocumentType::INVENTORY) {
+        changes.clear();
+        PostingResult result;
+        result.error = "Проведенную инвентаризацию нельзя отменить";
+        return result;
+    }
+    return prepare(doc, products, -directionOf(doc.getType()), changes);
+}
+
+PostingResult PostingEngine::prepare(const DocumentBase& doc, const ProductStore& products,
+                                     int direction, vector<StockChange>& changes) {
+    PostingResult result;
+    changes.clear();
+
+    bool isInventory = doc.getType() == DocumentType::INVENTORY;
+    DocumentItemView items = doc.getItemView();
+
+    // Сводим строки по товару: один поиск в каталоге на товар, а не на строку
+    unordered_map<int, size_t> positions;
+    positions.reserve(items.size());
+    for (const auto& item : items) {
+        if (item.productId <= 0) {
+            result.error = "Строка документа без товара";
+            changes.clear();
+            return result;
+        }
+        if (item.quantity < 0 || (!isInventory && item.quantity == 0)) {
+            result.error = "Недопустимое количество для товара ID " +
+                           to_string(item.productId);
+            changes.clear();
+            return result;
+        }
+
+        int productId = item.productId;
+        auto it = positions.find(productId);
+        if (it == positions.end()) {
+            size_t slot = products.find(productId);
+            if (slot == ProductStore::npos) {
+                result.error = "Товар ID " + to_string(productId) + " не найден на складе";
+                changes.clear();
+                return result;
+            }
+            it = positions.emplace(productId, changes.size()).first;
+            changes.push_back({slot, productId, 0, 0});
+        }
+        // Для инвентаризации копим фактическое количество, для остальных - движение
+        changes[it->second].delta += isInventory ? item.quantity : direction * item.quantity;
+    }
+
+    for (auto& change : changes) {
+        int current = products.quantityAt(change.slot);
+        if (isInventory) {
+            change.newQuantity = change.delta;
+            change.delta = change.newQuantity - current;
+        } else {
+            change.newQuantity = current + change.delta;
+        }
+        if (change.newQuantity < 0) {
+            result.error = "Недостаточно товара ID " + to_string(change.productId) +
+                           ": остаток " + to_string(current) +
+                           ", требуется " + to_string(-change.delta);
+            changes.clear();
+            return result;
+        }
+    }
+
+    result.success = true;
+    result.changedProducts = changes.size();
+    return result;
+}
@@ -0,0 +1,47 @@
+#ifndef STOCK_POSTING_H
+#define STOCK_POSTING_H
+
+#include "product_store.h"
+#include "document_type.h"
+#include <vector>
+#include <string>
+
+class DocumentBase;
+
+// Итоговое изменение остатка одного товара при проведении документа
+struct StockChange {
+    size_t slot;        // позиция товара в ProductStore
+    int productId;
+    int delta;
+    int newQuantity;
+};
+
+struct PostingResult {
+    bool success = false;
+    std::string error;
+    size_t changedProducts = 0;
+};
+
+// Превращает документ в пакет изменений остатков и проверяет его целиком
+// до применения: пакет либо применяется полностью, либо не применяется вовсе.
+class PostingEngine {
+public:
+    // Знак движения для типа документа: +1 приход, -1 расход, 0 - пересчет (инвентаризация)
+    static int directionOf(DocumentType type);
+
+    // Сводит строки документа по товарам и проверяет, что все товары существуют
+    // и ни один остаток не станет отрицательным. Вызывается под блокировкой склада:
+    // позиции в changes действительны, пока блокировка не снята.
+    static PostingResult prepare(const DocumentBase& doc, const ProductStore& products,
+                                 std::vector<StockChange>& changes);
+    // То же для отмены проведенного документа: движение с обратным знаком.
+    // Инвентаризацию так отменить нельзя - ее строки не хранят прежних остатков.
+    static PostingResult prepareReversal(const DocumentBase& doc, const ProductStore& products,
+                                         std::vector<StockChange>& changes);
+
+private:
+    static PostingResult prepare(const DocumentBase& doc, const ProductStore& products,
+                                 int direction, std::vector<StockChange>& changes);
+};
+
+#endif // STOCK_POSTING_H
@@ -0,0 +1,96 @@
+// Пример внешней программы: читает остатки, опубликованные складом
+// (Warehouse::startLiveView), напрямую из разделяемой памяти.
+//
+//   stock_view_reader                 итоги по складу
+//   stock_view_reader 42              товар с id 42
+//   stock_view_reader --watch [сек]   итоги каждые N секунд (по умолчанию 1)
+//   --name /имя                       другой сегмент вместо /warehouse_stock
+
+#include "live_stock.h"
+#include <iostream>
+#include <iomanip>
+#include <string>
+#include <cstdlib>
+#include <chrono>
+#include <thread>
+
+using namespace std;
+
+struct StockSummary {
+    size_t products = 0;
+    long long items = 0;
+    double value = 0;
+    uint64_t version = 0;
+};
+
+static bool readSummary(LiveStockReader& reader, StockSummary& summary) {
+    return reader.read([&summary](const LiveStockView& view) {
+        summary = StockSummary();
+        summary.products = view.size;
+        summary.version = view.version;
+        for (size_t slot = 0; slot < view.size; slot++) {
+            summary.items += view.quantities[slot];
+            summary.value += view.prices[slot] * view.quantities[slot];
+        }
+    });
+}
+
+static void printSummary(const StockSummary& summary) {
+    cout << "Товаров: " << summary.products
+         << ", единиц: " << summary.items
+         << ", стоимость: " << fixed << setprecision(2) << summary.value << " руб."
+         << " (версия " << summary.version << ")" << endl;
+}
+
+int main(int argc, char* argv[]) {
+    string name = LIVE_STOCK_DEFAULT_NAME;
+    bool watch = false;
+    int interval = 1;
+    int productId = 0;
+
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc) {
+            name = argv[++i];
+        } else if (arg == "--watch") {
+            watch = true;
+            if (i + 1 < argc && atoi(argv[i + 1]) > 0) interval = atoi(argv[++i]);
+        } else {
+            productId = atoi(arg.c_str());
+            if (productId <= 0) {
+                cerr << "Неизвестный аргумент: " << arg << endl;
+                return 2;
+            }
+        }
+    }
+
+    LiveStockReader reader;
+    if (!reader.open(name)) {
+        cerr << reader.getError() << endl;
+        return 1;
+    }
+
+    if (productId > 0) {
+        LiveStockRow row;
+        if (!reader.find(productId, row)) {
+            cerr << (reader.getError().empty() ? "Товар ID " + to_string(productId) + " не найден"
+                                               : reader.getError()) << endl;
+            return 1;
+        }
+        cout << row.id << " | " << row.name << " | " << fixed << setprecision(2) << row.price
+             << " руб. | " << row.quantity << " шт." << endl;
+        return 0;
+    }
+
+    do {
+        StockSummary summary;
+        if (!readSummary(reader, summary)) {
+            cerr << reader.getError() << endl;
+            if (!watch) return 1;
+        } else {
+            printSummary(summary);
+        }
+        if (watch) this_thread::sleep_for(chrono::seconds(interval));
+    } while (watch);
+    return 0;
+}
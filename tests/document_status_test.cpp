@@ -0,0 +1,60 @@
+// Переходы статуса документа: проведенный и отмененный документы не меняются,
+// а отмена возвращает остатки ровно к состоянию до проведения
+#include "warehouse.h"
+#include <cstdio>
+#include <cstdlib>
+
+using namespace std;
+
+static int failures = 0;
+
+static void check(bool condition, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "ОШИБКА: %s\n", what);
+        failures++;
+    }
+}
+
+static int quantityOf(Warehouse& warehouse, int productId) {
+    auto product = warehouse.getProductById(productId);
+    return product ? product->getQuantity() : -1;
+}
+
+int main() {
+    Warehouse warehouse;
+    int productId = warehouse.addProduct("Товар", 100.0, 50)->getId();
+
+    auto doc = warehouse.createOutcomeInvoice("Р-1", "Тест");
+    check(doc != nullptr, "документ создан");
+    if (!doc) return EXIT_FAILURE;
+    int docId = doc->getId();
+    check(warehouse.addDocumentItem(docId, productId, 10), "строка черновика добавлена");
+    check(warehouse.setDocumentField(docId, "Получатель", "ООО Ромашка"), "поле черновика изменено");
+
+    check(warehouse.postDocument(docId).success, "черновик проведен");
+    check(quantityOf(warehouse, productId) == 40, "проведение списало 10 шт.");
+
+    // Проведенный документ не меняется: иначе отмена сторнировала бы
+    // строки, которые не проводились
+    check(!warehouse.addDocumentItem(docId, productId, 5), "строка проведенного документа отклонена");
+    check(!warehouse.setDocumentField(docId, "Получатель", "Другой"), "поле проведенного документа отклонено");
+    check(doc->getItemView().size() == 1, "у проведенного документа одна строка");
+    check(doc->getSpecificFields().at("Получатель") == "ООО Ромашка", "поле проведенного документа прежнее");
+    check(!warehouse.postDocument(docId).success, "повторное проведение отклонено");
+
+    check(warehouse.cancelDocument(docId).success, "проведенный документ отменен");
+    check(quantityOf(warehouse, productId) == 50, "отмена вернула остаток к исходному");
+    check(doc->getStatus() == DocumentStatus::CANCELLED, "статус - отменен");
+
+    check(!warehouse.addDocumentItem(docId, productId, 5), "строка отмененного документа отклонена");
+    check(!warehouse.cancelDocument(docId).success, "повторная отмена отклонена");
+    check(!warehouse.postDocument(docId).success, "отмененный документ не проводится");
+    check(quantityOf(warehouse, productId) == 50, "остаток не изменился");
+
+    if (failures > 0) {
+        fprintf(stderr, "Провалено проверок: %d\n", failures);
+        return EXIT_FAILURE;
+    }
+    printf("document_status_test: ok\n");
+    return EXIT_SUCCESS;
+}
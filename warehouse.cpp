@@ -1,19 +1,31 @@
 #include "warehouse.h"
 #include "document.h"
+#include "snapshot.h"
 #include <fstream>
 #include <sstream>
 #include <iomanip>
 #include <algorithm>
 #include <ctime>
+#include <cmath>
+#include <cassert>
+#include <climits>
+#include <filesystem>
+#include <chrono>
+#include <random>
 
 using namespace std;
 
-Warehouse::Warehouse() {
-    initializeProducts();
+static const char* const MIRROR_READ_ONLY_ERROR =
+    "Зеркало склада меняется только пакетами изменений источника";
+
+Warehouse::Warehouse() = default;
+
+Warehouse::~Warehouse() {
+    closeStorage();
 }
 
+// Демонстрационный каталог нового хранилища (см. openStorage)
 void Warehouse::initializeProducts() {
-    // Инициализируем склад с тестовыми данными
     addProduct("Ноутбук Lenovo IdeaPad", 45000.0, 15);
     addProduct("Мышь Logitech MX Master", 5500.0, 42);
     addProduct("Клавиатура механическая", 8500.0, 28);
@@ -31,66 +43,362 @@ void Warehouse::initializeProducts() {
     addProduct("ИБП 1500VA", 12000.0, 15);
 }
 
-shared_ptr<Product> Warehouse::addProduct(const string& name, double price, int quantity) {
-    auto product = make_shared<Product>(nextProductId++, name, price, quantity);
-    products.push_back(product);
-    return product;
+shared_ptr<const Product> Warehouse::addProduct(const string& name, double price, int quantity) {
+    int id;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return nullptr;
+        id = nextProductId++;
+        size_t slot = products.append(id, name, price, quantity);
+        liveView.append(products, slot);
+        if (quantityIndexReady) quantityIndex.emplace(quantity, id);
+        if (nameIndexReady) nameIndex.insert(name, id);
+        totalItems += quantity;
+        totalValue += price * quantity;
+        time_t now = time(nullptr);
+        if (quantity != 0) {
+            ledger.append(now, id, quantity, 0, StockOperation::PRODUCT_CREATED);
+        }
+        logRecord(WalRecordBuilder(WalRecordType::PRODUCT_ADD)
+                      .putInt(id).putDouble(price).putInt(quantity).putString(name)
+                      .putInt64(static_cast<int64_t>(now)));
+    }
+    maybeCheckpoint();
+    return make_shared<Product>(id, name, price, quantity);
 }
 
 bool Warehouse::removeProduct(int id) {
-    auto it = find_if(products.begin(), products.end(),
-        [id](const shared_ptr<Product>& p) { return p->getId() == id; });
-    
-    if (it != products.end()) {
-        products.erase(it);
-        return true;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        size_t slot = products.find(id);
+        if (slot == ProductStore::npos) return false;
+        
+        totalItems -= products.quantityAt(slot);
+        totalValue -= products.priceAt(slot) * products.quantityAt(slot);
+        if (quantityIndexReady) quantityIndex.erase({products.quantityAt(slot), id});
+        if (nameIndexReady) nameIndex.erase(products.nameAt(slot), id);
+        reorderThresholds.erase(id);
+        time_t now = time(nullptr);
+        if (products.quantityAt(slot) != 0) {
+            ledger.append(now, id, -products.quantityAt(slot), 0, StockOperation::PRODUCT_REMOVED);
+        }
+        products.remove(id);
+        liveView.remove(slot);
+        logRecord(WalRecordBuilder(WalRecordType::PRODUCT_REMOVE)
+                      .putInt(id).putInt64(static_cast<int64_t>(now)));
     }
-    return false;
+    maybeCheckpoint();
+    return true;
 }
 
-shared_ptr<Product> Warehouse::getProductById(int id) {
-    for (const auto& product : products) {
-        if (product->getId() == id) return product;
-    }
-    return nullptr;
+shared_ptr<const Product> Warehouse::getProductById(int id) const {
+    lock_guard<mutex> lock(stockMutex);
+    size_t slot = products.find(id);
+    if (slot == ProductStore::npos) return nullptr;
+    return make_shared<Product>(id, string(products.nameAt(slot)),
+                                products.priceAt(slot), products.quantityAt(slot));
 }
 
-shared_ptr<Product> Warehouse::getProductByName(const string& name) {
-    for (const auto& product : products) {
-        if (product->getName() == name) return product;
+shared_ptr<const Product> Warehouse::getProductByName(const string& name) const {
+    lock_guard<mutex> lock(stockMutex);
+    ensureNameIndex();
+    size_t slot = nameIndex.find(products, name);
+    if (slot == ProductStore::npos) return nullptr;
+    return make_shared<Product>(products.idAt(slot), name,
+                                products.priceAt(slot), products.quantityAt(slot));
+}
+
+BulkAddResult Warehouse::addProducts(const vector<ProductDraft>& batch) {
+    BulkAddResult result;
+    result.rows.reserve(batch.size());
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) {
+            result.rows.assign(batch.size(), {BulkAddStatus::INVALID, 0});
+            result.rejected = batch.size();
+            return result;
+        }
+        ensureNameIndex();
+        products.reserve(products.size() + batch.size());
+        nameIndex.reserve(products.size() + batch.size());
+        
+        // Товары пакета получают id подряд: все, что не меньше firstId, - из этого пакета
+        int firstId = nextProductId;
+        time_t now = time(nullptr);
+        size_t nameBytes = 0;
+        liveView.beginUpdate();
+        for (const ProductDraft& draft : batch) {
+            if (draft.name.empty() || !(draft.price >= 0) || draft.quantity < 0) {
+                result.rows.push_back({BulkAddStatus::INVALID, 0});
+                result.rejected++;
+                continue;
+            }
+            size_t existing = nameIndex.find(products, draft.name);
+            if (existing != ProductStore::npos) {
+                int id = products.idAt(existing);
+                result.rows.push_back({id >= firstId ? BulkAddStatus::DUPLICATE_IN_BATCH
+                                                     : BulkAddStatus::EXISTING_NAME, id});
+                result.duplicates++;
+                continue;
+            }
+            
+            int id = nextProductId++;
+            size_t slot = products.append(id, draft.name, draft.price, draft.quantity);
+            liveView.append(products, slot);
+            nameIndex.insert(draft.name, id);
+            if (quantityIndexReady) quantityIndex.emplace(draft.quantity, id);
+            totalItems += draft.quantity;
+            totalValue += draft.price * draft.quantity;
+            if (draft.quantity != 0) {
+                ledger.append(now, id, draft.quantity, 0, StockOperation::PRODUCT_CREATED);
+            }
+            nameBytes += draft.name.size();
+            result.rows.push_back({BulkAddStatus::ADDED, id});
+            result.added++;
+        }
+        liveView.endUpdate();
+        
+        // Одна запись на весь пакет: при восстановлении он применяется целиком или никак
+        if (result.added > 0 && wal.isOpen()) {
+            WalRecordBuilder record(WalRecordType::PRODUCT_BATCH_ADD);
+            record.reserve(sizeof(int32_t) + result.added * (2 * sizeof(int32_t) + sizeof(double) +
+                                                             sizeof(int32_t)) + nameBytes +
+                           sizeof(int64_t));
+            record.putInt(static_cast<int32_t>(result.added));
+            for (size_t i = 0; i < batch.size(); i++) {
+                if (result.rows[i].status != BulkAddStatus::ADDED) continue;
+                record.putInt(result.rows[i].productId).putDouble(batch[i].price)
+                      .putInt(batch[i].quantity).putString(batch[i].name);
+            }
+            record.putInt64(static_cast<int64_t>(now));
+            logRecord(record);
+        }
     }
-    return nullptr;
+    maybeCheckpoint();
+    return result;
 }
 
-const vector<shared_ptr<Product>>& Warehouse::getAllProducts() const {
+const ProductStore& Warehouse::getAllProducts() const {
     return products;
 }
 
+ProductColumns Warehouse::shareProductColumns() const {
+    lock_guard<mutex> lock(stockMutex);
+    return products.shareColumns();
+}
+
 bool Warehouse::updateProductQuantity(int id, int newQuantity) {
-    auto product = getProductById(id);
-    if (product) {
-        product->setQuantity(newQuantity);
-        return true;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        size_t slot = products.find(id);
+        if (slot == ProductStore::npos) return false;
+        time_t now = time(nullptr);
+        setQuantityAt(slot, newQuantity, StockOperation::MANUAL_SET, 0, now);
+        logRecord(WalRecordBuilder(WalRecordType::QUANTITY_SET)
+                      .putInt(id).putInt(products.quantityAt(slot))
+                      .putInt64(static_cast<int64_t>(now))
+                      .putInt(static_cast<int32_t>(StockOperation::MANUAL_SET)));
     }
-    return false;
+    dispatchReorderEvents();
+    maybeCheckpoint();
+    return true;
 }
 
 bool Warehouse::addProductQuantity(int id, int amount) {
-    auto product = getProductById(id);
-    if (product && amount > 0) {
-        product->addQuantity(amount);
-        return true;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        size_t slot = products.find(id);
+        if (slot == ProductStore::npos || amount <= 0) return false;
+        time_t now = time(nullptr);
+        setQuantityAt(slot, products.quantityAt(slot) + amount, StockOperation::MANUAL_ADD, 0, now);
+        logRecord(WalRecordBuilder(WalRecordType::QUANTITY_SET)
+                      .putInt(id).putInt(products.quantityAt(slot))
+                      .putInt64(static_cast<int64_t>(now))
+                      .putInt(static_cast<int32_t>(StockOperation::MANUAL_ADD)));
     }
-    return false;
+    dispatchReorderEvents();
+    maybeCheckpoint();
+    return true;
 }
 
 bool Warehouse::removeProductQuantity(int id, int amount) {
-    auto product = getProductById(id);
-    if (product && product->getQuantity() >= amount) {
-        product->removeQuantity(amount);
-        return true;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        size_t slot = products.find(id);
+        if (slot == ProductStore::npos || products.quantityAt(slot) < amount) return false;
+        time_t now = time(nullptr);
+        setQuantityAt(slot, products.quantityAt(slot) - amount, StockOperation::MANUAL_REMOVE, 0, now);
+        logRecord(WalRecordBuilder(WalRecordType::QUANTITY_SET)
+                      .putInt(id).putInt(products.quantityAt(slot))
+                      .putInt64(static_cast<int64_t>(now))
+                      .putInt(static_cast<int32_t>(StockOperation::MANUAL_REMOVE)));
     }
-    return false;
+    dispatchReorderEvents();
+    maybeCheckpoint();
+    return true;
+}
+
+// Единая точка изменения остатка: поддерживает итоги склада, индекс
+// по остатку, журнал движения и уведомления о пороге дозаказа.
+// Вызывается под stockMutex.
+void Warehouse::setQuantityAt(size_t slot, int newQuantity, StockOperation operation,
+                              int documentId, time_t timestamp) {
+    int id = products.idAt(slot);
+    int oldQuantity = products.quantityAt(slot);
+    if (oldQuantity == newQuantity) return;
+    
+    int delta = newQuantity - oldQuantity;
+    totalItems += delta;
+    totalValue += products.priceAt(slot) * delta;
+    products.setQuantityAt(slot, newQuantity);
+    liveView.setQuantity(slot, newQuantity);
+    
+    if (quantityIndexReady) {
+        quantityIndex.erase({oldQuantity, id});
+        quantityIndex.emplace(newQuantity, id);
+    }
+    
+    ledger.append(timestamp ? timestamp : time(nullptr), id, delta, documentId, operation);
+    
+    queueReorderEvent(id, oldQuantity, newQuantity);
+}
+
+void Warehouse::invalidateIndexes() {
+    quantityIndex.clear();
+    quantityIndexReady = false;
+    nameIndex.clear();
+    nameIndexReady = false;
+}
+
+// Строит индекс по остатку; вызывается под stockMutex
+void Warehouse::ensureQuantityIndex() const {
+    if (quantityIndexReady) return;
+    
+    // Вставка отсортированных пар с подсказкой end() - линейное построение дерева
+    vector<pair<int, int>> entries;
+    entries.reserve(products.size());
+    for (const auto& product : products) {
+        entries.emplace_back(product.getQuantity(), product.getId());
+    }
+    sort(entries.begin(), entries.end());
+    quantityIndex.clear();
+    for (const auto& entry : entries) {
+        quantityIndex.emplace_hint(quantityIndex.end(), entry);
+    }
+    quantityIndexReady = true;
+}
+
+// Строит индекс по наименованию; вызывается под stockMutex
+void Warehouse::ensureNameIndex() const {
+    if (nameIndexReady) return;
+    nameIndex.clear();
+    nameIndex.reserve(products.size());
+    for (size_t slot = 0; slot < products.size(); slot++) {
+        nameIndex.insert(products.nameAt(slot), products.idAt(slot));
+    }
+    nameIndexReady = true;
+}
+
+vector<int> Warehouse::getLowStockProductIds(int threshold) const {
+    lock_guard<mutex> lock(stockMutex);
+    ensureQuantityIndex();
+    
+    vector<int> result;
+    // Все пары (количество, id) с количеством < threshold лежат до этой границы
+    auto end = quantityIndex.lower_bound({threshold, INT_MIN});
+    for (auto it = quantityIndex.begin(); it != end; ++it) {
+        result.push_back(it->second);
+    }
+    return result;
+}
+
+void Warehouse::setReorderThreshold(int threshold) {
+    lock_guard<mutex> lock(stockMutex);
+    defaultReorderThreshold = threshold;
+}
+
+void Warehouse::setReorderThreshold(int productId, int threshold) {
+    lock_guard<mutex> lock(stockMutex);
+    reorderThresholds[productId] = threshold;
+}
+
+int Warehouse::getReorderThreshold(int productId) const {
+    lock_guard<mutex> lock(stockMutex);
+    return reorderThresholdLocked(productId);
+}
+
+// Порог товара; вызывается под stockMutex
+int Warehouse::reorderThresholdLocked(int productId) const {
+    auto it = reorderThresholds.find(productId);
+    return it != reorderThresholds.end() ? it->second : defaultReorderThreshold;
+}
+
+int Warehouse::subscribeReorder(ReorderCallback callback) {
+    lock_guard<mutex> lock(stockMutex);
+    int subscriptionId = nextSubscriptionId++;
+    reorderSubscribers[subscriptionId] = std::move(callback);
+    return subscriptionId;
+}
+
+void Warehouse::unsubscribeReorder(int subscriptionId) {
+    lock_guard<mutex> lock(stockMutex);
+    reorderSubscribers.erase(subscriptionId);
+}
+
+// Подписчики получают событие только при пересечении порога, а не при каждом изменении
+void Warehouse::queueReorderEvent(int productId, int oldQuantity, int newQuantity) {
+    if (reorderSubscribers.empty()) return;
+    
+    int threshold = reorderThresholdLocked(productId);
+    bool wasBelow = oldQuantity < threshold;
+    bool isBelow = newQuantity < threshold;
+    if (wasBelow == isBelow) return;
+    
+    pendingReorderEvents.push_back({productId, oldQuantity, newQuantity, threshold, isBelow});
+}
+
+// Рассылает накопленные события вне критической секции, чтобы
+// обработчик мог снова обращаться к складу
+void Warehouse::dispatchReorderEvents() {
+    vector<ReorderEvent> events;
+    // Копия позволяет подписчику отписаться прямо из обработчика
+    map<int, ReorderCallback> subscribers;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        events.swap(pendingReorderEvents);
+        if (events.empty()) return;
+        subscribers = reorderSubscribers;
+    }
+    
+    for (const auto& event : events) {
+        for (const auto& [subscriptionId, callback] : subscribers) {
+            callback(event);
+        }
+    }
+}
+
+void Warehouse::recalculateTotals() {
+    totalItems = products.sumQuantities();
+    totalValue = products.sumValues();
+}
+
+// Сверяет инкрементальные итоги с полным пересчетом; вызывается под
+// stockMutex. Пересчет - два прохода по каталогу, поэтому он есть только
+// в сборке с WAREHOUSE_CHECK_TOTALS (CMake задает его для Debug)
+void Warehouse::checkTotals() const {
+#ifdef WAREHOUSE_CHECK_TOTALS
+    long long items = products.sumQuantities();
+    double value = products.sumValues();
+    assert(items == totalItems && "Итог по количеству разошелся с пересчетом");
+    assert(fabs(value - totalValue) <= 1e-6 * max(1.0, fabs(value)) &&
+           "Итог по стоимости разошелся с пересчетом");
+    (void)items;
+    (void)value;
+#endif
 }
 
 // Упрощенные методы создания документов
@@ -98,9 +406,9 @@ shared_ptr<DocumentBase> Warehouse::createReceipt(
     const string& number, const string& createdBy,
     const string& department, const string& comment) {
     
-    auto doc = make_shared<DocumentTemplate<DocumentType::RECEIPT>>(
-        nextDocumentId++, number, createdBy, department, comment);
-    documents.push_back(doc);
+    auto doc = makeDocument<DocumentType::RECEIPT>(
+        nextDocumentId, number, createdBy, department, comment);
+    if (!registerDocument(doc)) return nullptr;
     cout << "Создан ЧЕК №" << number << endl;
     return doc;
 }
@@ -109,9 +417,9 @@ shared_ptr<DocumentBase> Warehouse::createIncomeInvoice(
     const string& number, const string& createdBy,
     const string& department, const string& comment) {
     
-    auto doc = make_shared<DocumentTemplate<DocumentType::INCOME_INVOICE>>(
-        nextDocumentId++, number, createdBy, department, comment);
-    documents.push_back(doc);
+    auto doc = makeDocument<DocumentType::INCOME_INVOICE>(
+        nextDocumentId, number, createdBy, department, comment);
+    if (!registerDocument(doc)) return nullptr;
     cout << "Создана НАКЛАДНАЯ ПРИХОДА №" << number << endl;
     return doc;
 }
@@ -120,9 +428,9 @@ shared_ptr<DocumentBase> Warehouse::createOutcomeInvoice(
     const string& number, const string& createdBy,
     const string& department, const string& comment) {
     
-    auto doc = make_shared<DocumentTemplate<DocumentType::OUTCOME_INVOICE>>(
-        nextDocumentId++, number, createdBy, department, comment);
-    documents.push_back(doc);
+    auto doc = makeDocument<DocumentType::OUTCOME_INVOICE>(
+        nextDocumentId, number, createdBy, department, comment);
+    if (!registerDocument(doc)) return nullptr;
     cout << "Создана НАКЛАДНАЯ РАСХОДА №" << number << endl;
     return doc;
 }
@@ -131,13 +439,38 @@ shared_ptr<DocumentBase> Warehouse::createInventory(
     const string& number, const string& createdBy,
     const string& department, const string& comment) {
     
-    auto doc = make_shared<DocumentTemplate<DocumentType::INVENTORY>>(
-        nextDocumentId++, number, createdBy, department, comment);
-    documents.push_back(doc);
+    auto doc = makeDocument<DocumentType::INVENTORY>(
+        nextDocumentId, number, createdBy, department, comment);
+    if (!registerDocument(doc)) return nullptr;
     cout << "Создан АКТ ИНВЕНТАРИЗАЦИИ №" << number << endl;
     return doc;
 }
 
+// Регистрирует документ в реестре; номер документа должен быть уникальным
+bool Warehouse::registerDocument(const shared_ptr<DocumentBase>& doc) {
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        // Номер вытесненного в холодный сегмент документа тоже занят
+        if ((coldDocuments.isOpen() && coldDocuments.findNumber(doc->getNumber()) != 0) ||
+            !loadedDocuments().add(doc)) {
+            cout << "Документ с номером " << doc->getNumber() << " уже существует" << endl;
+            return false;
+        }
+        nextDocumentId = max(nextDocumentId, doc->getId() + 1);
+        logRecord(WalRecordBuilder(WalRecordType::DOCUMENT_CREATE)
+                      .putInt(doc->getId())
+                      .putInt(static_cast<int32_t>(doc->getType()))
+                      .putInt64(static_cast<int64_t>(doc->getDate()))
+                      .putString(doc->getNumber())
+                      .putString(doc->getCreatedBy())
+                      .putString(doc->getDepartment())
+                      .putString(doc->getComment()));
+    }
+    maybeCheckpoint();
+    return true;
+}
+
 // Общий метод создания документа
 shared_ptr<DocumentBase> Warehouse::createDocument(DocumentType type,
                                                  const string& number, 
@@ -159,45 +492,468 @@ shared_ptr<DocumentBase> Warehouse::createDocument(DocumentType type,
     }
 }
 
-bool Warehouse::processDocument(int docId) {
-    auto doc = getDocumentById(docId);
-    if (doc) {
+PostingResult Warehouse::postDocument(int docId) {
+    PostingResult result;
+    {
+        // Поиск документа, проверка статуса, проверка и применение всего
+        // пакета - одна критическая секция: документ не проведется дважды
+        // из разных потоков
+        lock_guard<mutex> lock(stockMutex);
+        if (mirrorSource != 0) {
+            result.error = MIRROR_READ_ONLY_ERROR;
+            return result;
+        }
+        auto doc = findModifiedDocument(docId);
+        if (!doc) {
+            result.error = "Документ ID " + to_string(docId) + " не найден";
+            return result;
+        }
+        if (!canTransition(doc->getStatus(), DocumentStatus::POSTED)) {
+            result.error = "Документ №" + doc->getNumber() + " уже " +
+                           (doc->getStatus() == DocumentStatus::POSTED ? "проведен" : "отменен");
+            return result;
+        }
+        vector<StockChange> changes;
+        result = PostingEngine::prepare(*doc, products, changes);
+        if (!result.success) return result;
+        // Статус меняется до остатков: если перехода нет, ничего не применено
+        if (!documents.transition(doc, DocumentStatus::POSTED)) {
+            result.success = false;
+            result.error = "Документ №" + doc->getNumber() + " нельзя провести";
+            return result;
+        }
+        
+        // Внешние читатели видят проведение целиком, а не построчно
+        time_t postedAt = time(nullptr);
+        liveView.beginUpdate();
+        for (const auto& change : changes) {
+            setQuantityAt(change.slot, change.newQuantity, StockOperation::DOCUMENT_POSTING,
+                          docId, postedAt);
+        }
+        liveView.endUpdate();
         doc->process();
-        return true;
+        
+        // Проведение - одна запись журнала: при восстановлении оно либо
+        // применяется целиком, либо не применяется вовсе
+        WalRecordBuilder record(WalRecordType::DOCUMENT_POSTED);
+        record.putInt(docId).putString(string(doc->getStatusLabel()))
+              .putInt(static_cast<int32_t>(changes.size()));
+        for (const auto& change : changes) {
+            record.putInt(change.productId).putInt(change.newQuantity);
+        }
+        record.putInt64(static_cast<int64_t>(postedAt));
+        logRecord(record);
     }
-    return false;
+    dispatchReorderEvents();
+    maybeCheckpoint();
+    return result;
 }
 
-bool Warehouse::cancelDocument(int docId) {
-    auto doc = getDocumentById(docId);
-    if (doc) {
-        // Не можем вызвать setStatus, так как это метод DocumentTemplate, а не DocumentBase
-        // Вместо этого обработаем документ как отмененный
-        // Для простоты оставим как есть или добавим новую логику
-        cout << "Документ ID " << docId << " отменен" << endl;
-        return true;
+bool Warehouse::processDocument(int docId) {
+    PostingResult result = postDocument(docId);
+    if (!result.success) {
+        cout << "Документ не проведен: " << result.error << endl;
     }
-    return false;
+    return result.success;
+}
+
+PostingResult Warehouse::cancelDocument(int docId) {
+    PostingResult result;
+    {
+        // Как и проведение: поиск и проверка статуса, сторно остатков, смена
+        // статуса и запись журнала - одна критическая секция
+        lock_guard<mutex> lock(stockMutex);
+        if (mirrorSource != 0) {
+            result.error = MIRROR_READ_ONLY_ERROR;
+            return result;
+        }
+        auto doc = findModifiedDocument(docId);
+        if (!doc) {
+            result.error = "Документ ID " + to_string(docId) + " не найден";
+            return result;
+        }
+        if (!canTransition(doc->getStatus(), DocumentStatus::CANCELLED)) {
+            result.error = "Документ №" + doc->getNumber() + " уже отменен";
+            return result;
+        }
+        vector<StockChange> changes;
+        if (doc->getStatus() == DocumentStatus::POSTED) {
+            result = PostingEngine::prepareReversal(*doc, products, changes);
+            if (!result.success) return result;
+        } else {
+            result.success = true;
+        }
+        if (!documents.transition(doc, DocumentStatus::CANCELLED)) {
+            result.success = false;
+            result.error = "Документ №" + doc->getNumber() + " нельзя отменить";
+            return result;
+        }
+        
+        time_t cancelledAt = time(nullptr);
+        liveView.beginUpdate();
+        for (const auto& change : changes) {
+            setQuantityAt(change.slot, change.newQuantity, StockOperation::DOCUMENT_CANCEL,
+                          docId, cancelledAt);
+        }
+        liveView.endUpdate();
+        
+        WalRecordBuilder record(WalRecordType::DOCUMENT_CANCELLED);
+        record.putInt(docId).putInt(static_cast<int32_t>(changes.size()));
+        for (const auto& change : changes) {
+            record.putInt(change.productId).putInt(change.newQuantity);
+        }
+        record.putInt64(static_cast<int64_t>(cancelledAt));
+        logRecord(record);
+    }
+    cout << "Документ ID " << docId << " отменен" << endl;
+    dispatchReorderEvents();
+    maybeCheckpoint();
+    return result;
+}
+
+bool Warehouse::addDocumentItem(int docId, int productId, int quantity, const string& comment) {
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        auto doc = findEditableDocument(docId);
+        if (!doc) return false;
+        size_t slot = products.find(productId);
+        if (slot == ProductStore::npos) return false;
+        doc->addLine(productId, products.nameAt(slot), products.priceAt(slot), quantity, comment);
+        logRecord(WalRecordBuilder(WalRecordType::DOCUMENT_ITEM)
+                      .putInt(docId).putInt(productId).putInt(quantity).putString(comment));
+    }
+    maybeCheckpoint();
+    return true;
+}
+
+bool Warehouse::setDocumentField(int docId, const string& fieldName, const string& value) {
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (rejectOnMirror()) return false;
+        auto doc = findEditableDocument(docId);
+        if (!doc) return false;
+        if (!doc->setSpecificField(fieldName, value)) return false;
+        logRecord(WalRecordBuilder(WalRecordType::DOCUMENT_FIELD)
+                      .putInt(docId).putString(fieldName).putString(value));
+    }
+    maybeCheckpoint();
+    return true;
 }
 
 shared_ptr<DocumentBase> Warehouse::getDocumentById(int id) {
-    for (const auto& doc : documents) {
-        if (doc->getId() == id) return doc;
+    lock_guard<mutex> lock(stockMutex);
+    return findDocumentLocked(id);
+}
+
+// Документ реестра или холодного сегмента; вызывается под stockMutex
+shared_ptr<DocumentBase> Warehouse::findDocumentLocked(int id) {
+    if (auto doc = loadedDocuments().findById(id)) return doc;
+    if (!coldDocuments.isOpen()) return nullptr;
+    
+    // Документ из холодного сегмента возвращается в реестр до следующего
+    // прохода tierDocuments; пока его не меняли, повторно он не пишется
+    auto doc = coldDocuments.load(id);
+    if (!doc) return nullptr;
+    // Номер вытесненного документа остается занятым (см. registerDocument);
+    // конфликт возможен только в данных, созданных до индекса номеров
+    if (!documents.add(doc)) {
+        cout << "Документ " << id << " из холодного сегмента конфликтует по номеру "
+             << doc->getNumber() << endl;
+        return nullptr;
+    }
+    faultedDocuments.insert(id);
+    return doc;
+}
+
+// Документ, который сейчас будет изменен: его копия в холодном сегменте
+// устаревает; вызывается под stockMutex
+shared_ptr<DocumentBase> Warehouse::findModifiedDocument(int id) {
+    auto doc = findDocumentLocked(id);
+    faultedDocuments.erase(id);
+    return doc;
+}
+
+// Черновик, строки или поля которого сейчас будут изменены. Проведенный и
+// отмененный документы не меняются: отмена сторнирует именно те строки,
+// которые были проведены. Вызывается под stockMutex
+shared_ptr<DocumentBase> Warehouse::findEditableDocument(int id) {
+    auto doc = findDocumentLocked(id);
+    if (!doc) return nullptr;
+    if (doc->getStatus() != DocumentStatus::DRAFT) {
+        cout << "Документ №" << doc->getNumber() << " не черновик (" << doc->getStatusLabel()
+             << "): строки и поля не меняются" << endl;
+        return nullptr;
+    }
+    faultedDocuments.erase(id);
+    return doc;
+}
+
+// Есть ли в реестре документы, которые пора вытеснить в холодные сегменты
+bool Warehouse::hasColdCandidates() const {
+    lock_guard<mutex> lock(stockMutex);
+    // Незагруженные документы проверяются при первом проходе после загрузки
+    if (!coldDocuments.isOpen() || documentTierAge <= 0 ||
+        documentsPending.load(memory_order_acquire)) return false;
+    time_t cutoff = time(nullptr) - documentTierAge + 1;
+    return !documents.byStatusAndDate(DocumentStatus::POSTED, numeric_limits<time_t>::min(), cutoff).empty() ||
+           !documents.byStatusAndDate(DocumentStatus::CANCELLED, numeric_limits<time_t>::min(), cutoff).empty();
+}
+
+void Warehouse::setDocumentTierAge(time_t seconds) {
+    documentTierAge = seconds;
+}
+
+size_t Warehouse::tierDocuments(time_t now) {
+    // Документ не должен измениться между записью сегмента и удалением из реестра
+    lock_guard<mutex> lock(stockMutex);
+    if (!coldDocuments.isOpen() || documentTierAge <= 0 ||
+        documentsPending.load(memory_order_acquire)) return 0;
+    
+    unordered_set<int> coldIds;
+    vector<shared_ptr<DocumentBase>> changed;
+    // Вытесняются завершенные документы: проведенные и отмененные
+    for (DocumentStatus status : {DocumentStatus::POSTED, DocumentStatus::CANCELLED}) {
+        for (const auto& doc : documents.byStatusAndDate(status, numeric_limits<time_t>::min(),
+                                                         now - documentTierAge + 1)) {
+            coldIds.insert(doc->getId());
+            // Неизмененная копия уже лежит в сегменте
+            if (!faultedDocuments.count(doc->getId())) changed.push_back(doc);
+        }
+    }
+    if (coldIds.empty()) return 0;
+    
+    // Документы покидают реестр только после того, как сегмент на диске
+    if (!coldDocuments.writeSegment(changed)) {
+        cout << "Ошибка записи холодного сегмента: " << coldDocuments.getError() << endl;
+        return 0;
+    }
+    size_t removed = documents.removeIf([&coldIds](const shared_ptr<DocumentBase>& doc) {
+        return coldIds.count(doc->getId()) > 0;
+    });
+    for (int id : coldIds) faultedDocuments.erase(id);
+    
+    // Устаревшие версии документов в старых сегментах убираются слиянием
+    if (coldDocuments.segmentCount() >= COLD_COMPACT_SEGMENTS && !coldDocuments.compact()) {
+        cout << "Ошибка слияния холодных сегментов: " << coldDocuments.getError() << endl;
     }
-    return nullptr;
+    return removed;
+}
+
+shared_ptr<DocumentBase> Warehouse::getDocumentByNumber(const string& number) {
+    lock_guard<mutex> lock(stockMutex);
+    if (auto doc = loadedDocuments().findByNumber(number)) return doc;
+    int id = coldDocuments.isOpen() ? coldDocuments.findNumber(number) : 0;
+    return id != 0 ? findDocumentLocked(id) : nullptr;
 }
 
 const vector<shared_ptr<DocumentBase>>& Warehouse::getAllDocuments() const {
-    return documents;
+    return loadedDocuments().all();
+}
+
+const vector<shared_ptr<DocumentBase>>& Warehouse::getDocumentsByType(DocumentType type) const {
+    return loadedDocuments().byType(type);
+}
+
+DocumentRegistry::DateRange Warehouse::getDocumentsByDate(time_t from, time_t to) const {
+    return loadedDocuments().byDate(from, to);
+}
+
+DocumentRegistry::DateRange Warehouse::getDocumentsByDate(DocumentType type,
+                                                          time_t from, time_t to) const {
+    return loadedDocuments().byTypeAndDate(type, from, to);
+}
+
+DocumentRegistry::DateRange Warehouse::getDocumentsByStatus(DocumentStatus status) const {
+    return loadedDocuments().byStatus(status);
+}
+
+DocumentRegistry::DateRange Warehouse::getDocumentsByStatus(DocumentStatus status,
+                                                            time_t from, time_t to) const {
+    return loadedDocuments().byStatusAndDate(status, from, to);
+}
+
+const DocumentRegistry& Warehouse::getDocumentRegistry() const {
+    return loadedDocuments();
+}
+
+DocumentSummary Warehouse::summarizeDocuments(time_t from, time_t to) const {
+    DocumentSummary summary;
+    loadedDocuments().forEach([&summary, from, to](const auto& doc) {
+        if (doc.getDate() < from || doc.getDate() >= to) return;
+        DocumentTypeTotals& totals = summary.types[static_cast<size_t>(doc.getType())];
+        totals.documents++;
+        totals.byStatus[static_cast<size_t>(doc.getStatus())]++;
+        DocumentItemView items = doc.getItemView();
+        totals.lines += items.size();
+        for (const DocumentLine& line : items) totals.amount += line.total();
+    });
+    for (const auto& totals : summary.types) summary.documents += totals.documents;
+    return summary;
+}
+
+DocumentExportResult Warehouse::exportDocuments(const string& directory, DocumentExportFormat format,
+                                                time_t from, time_t to) const {
+    DocumentExportResult result;
+    
+    if (format == DocumentExportFormat::TEXT_FILES) {
+        // Прежняя печатная форма: отдельный файл на каждый документ
+        error_code error;
+        filesystem::create_directories(directory, error);
+        for (const auto& doc : loadedDocuments().byDate(from, to)) {
+            string filename = (filesystem::path(directory) / (doc->getNumber() + ".txt")).string();
+            doc->saveToFile(filename);
+            result.files.push_back(filename);
+            result.documentCount++;
+        }
+        result.success = true;
+        return result;
+    }
+    
+    char stamp[32];
+    time_t now = time(nullptr);
+    strftime(stamp, sizeof(stamp), "%Y%m%d_%H%M%S", localtime(&now));
+    DocumentArchiveWriter archive(directory, string("documents_") + stamp);
+    for (const auto& doc : loadedDocuments().byDate(from, to)) {
+        if (!archive.add(*doc)) break;
+    }
+    result.success = archive.finish();
+    result.error = archive.getError();
+    result.documentCount = archive.documentCount();
+    result.files = archive.segmentFiles();
+    return result;
+}
+
+static const char* stockOperationName(StockOperation operation) {
+    switch (operation) {
+        case StockOperation::PRODUCT_CREATED: return "Создание товара";
+        case StockOperation::PRODUCT_REMOVED: return "Удаление товара";
+        case StockOperation::MANUAL_SET: return "Установка остатка";
+        case StockOperation::MANUAL_ADD: return "Поступление";
+        case StockOperation::MANUAL_REMOVE: return "Списание";
+        case StockOperation::DOCUMENT_POSTING: return "Проведение документа";
+        case StockOperation::DOCUMENT_CANCEL: return "Отмена документа";
+    }
+    return "";
 }
 
-vector<shared_ptr<DocumentBase>> Warehouse::getDocumentsByType(DocumentType type) const {
-    vector<shared_ptr<DocumentBase>> result;
-    for (const auto& doc : documents) {
-        if (doc->getType() == type) {
-            result.push_back(doc);
+AnalyticsExportResult Warehouse::exportAnalytics(const string& directory, const string& prefix) const {
+    AnalyticsExportResult result;
+    error_code ignored;
+    filesystem::create_directories(directory, ignored);
+    auto path = [&](const char* table) {
+        return (filesystem::path(directory) / (prefix + "_" + table + ".col")).string();
+    };
+    auto finish = [&result](ColumnarWriter& writer, const string& filename) {
+        if (!writer.finish()) {
+            result.error = writer.getError();
+            return false;
+        }
+        result.files.push_back(filename);
+        return true;
+    };
+    
+    // Товары - из неизменяемой копии колонок, склад во время записи не блокируется
+    {
+        ProductColumns columns = shareProductColumns();
+        string filename = path("products");
+        ColumnarWriter writer({{"id", ColumnarType::INT32},
+                               {"name", ColumnarType::STRING},
+                               {"price", ColumnarType::DOUBLE},
+                               {"quantity", ColumnarType::INT32}});
+        bool ok = writer.open(filename);
+        for (size_t slot = 0; ok && slot < columns.size(); slot++) {
+            writer.setInt(0, (*columns.ids)[slot]);
+            writer.setString(1, columns.nameAt(slot));
+            writer.setDouble(2, (*columns.prices)[slot]);
+            writer.setInt(3, (*columns.quantities)[slot]);
+            ok = writer.endRow();
+        }
+        result.products = writer.rowCount();
+        if (!finish(writer, filename) || !ok) return result;
+    }
+    
+    // Заголовки и строки документов - за один проход по реестру
+    {
+        string documentsFilename = path("documents");
+        string linesFilename = path("document_lines");
+        ColumnarWriter documentsWriter({{"id", ColumnarType::INT32},
+                                        {"number", ColumnarType::STRING},
+                                        {"type", ColumnarType::STRING},
+                                        {"date", ColumnarType::INT64},
+                                        {"status", ColumnarType::STRING},
+                                        {"created_by", ColumnarType::STRING},
+                                        {"department", ColumnarType::STRING},
+                                        {"comment", ColumnarType::STRING},
+                                        {"line_count", ColumnarType::INT32}});
+        ColumnarWriter linesWriter({{"document_id", ColumnarType::INT32},
+                                    {"document_date", ColumnarType::INT64},
+                                    {"line", ColumnarType::INT32},
+                                    {"product_id", ColumnarType::INT32},
+                                    {"product_name", ColumnarType::STRING},
+                                    {"price", ColumnarType::DOUBLE},
+                                    {"quantity", ColumnarType::INT32},
+                                    {"comment", ColumnarType::STRING}});
+        bool ok = documentsWriter.open(documentsFilename) && linesWriter.open(linesFilename);
+        for (const auto& doc : loadedDocuments().all()) {
+            if (!ok) break;
+            DocumentItemView items = doc->getItemView();
+            documentsWriter.setInt(0, doc->getId());
+            documentsWriter.setString(1, doc->getNumber());
+            documentsWriter.setString(2, doc->getTypeName());
+            documentsWriter.setInt(3, static_cast<int64_t>(doc->getDate()));
+            documentsWriter.setString(4, doc->getStatusLabel());
+            documentsWriter.setString(5, doc->getCreatedBy());
+            documentsWriter.setString(6, doc->getDepartment());
+            documentsWriter.setString(7, doc->getComment());
+            documentsWriter.setInt(8, static_cast<int64_t>(items.size()));
+            ok = documentsWriter.endRow();
+            
+            for (size_t line = 0; ok && line < items.size(); line++) {
+                const DocumentLine& item = items[line];
+                linesWriter.setInt(0, doc->getId());
+                linesWriter.setInt(1, static_cast<int64_t>(doc->getDate()));
+                linesWriter.setInt(2, static_cast<int64_t>(line + 1));
+                linesWriter.setInt(3, item.productId);
+                linesWriter.setString(4, item.productName());
+                linesWriter.setDouble(5, item.price);
+                linesWriter.setInt(6, item.quantity);
+                linesWriter.setString(7, items.commentOf(item));
+                ok = linesWriter.endRow();
+            }
+        }
+        result.documents = documentsWriter.rowCount();
+        result.documentLines = linesWriter.rowCount();
+        if (!finish(documentsWriter, documentsFilename) || !finish(linesWriter, linesFilename) || !ok) {
+            return result;
         }
     }
+    
+    // Движение товаров - по суткам, как их хранит журнал движения:
+    // по min/max времени в группах читатель пропускает ненужные периоды
+    {
+        string filename = path("movements");
+        ColumnarWriter writer({{"timestamp", ColumnarType::INT64},
+                               {"product_id", ColumnarType::INT32},
+                               {"delta", ColumnarType::INT32},
+                               {"document_id", ColumnarType::INT32},
+                               {"operation", ColumnarType::STRING}});
+        bool ok = writer.open(filename);
+        ledger.forEach(numeric_limits<time_t>::min(), numeric_limits<time_t>::max(),
+            [&](const LedgerEntry& entry) {
+                if (!ok) return;
+                writer.setInt(0, static_cast<int64_t>(entry.timestamp));
+                writer.setInt(1, entry.productId);
+                writer.setInt(2, entry.delta);
+                writer.setInt(3, entry.documentId);
+                writer.setString(4, stockOperationName(entry.operation));
+                ok = writer.endRow();
+            });
+        result.movements = writer.rowCount();
+        if (!finish(writer, filename) || !ok) return result;
+    }
+    
+    result.success = true;
     return result;
 }
 
@@ -218,12 +974,11 @@ void Warehouse::printStockReport() const {
     cout << "----------------------------------------------------------------" << endl;
     
     for (const auto& product : products) {
-        double totalValue = product->getPrice() * product->getQuantity();
-        cout << left << setw(8) << product->getId()
-             << setw(40) << product->getName()
-             << setw(10) << product->getQuantity()
-             << setw(15) << fixed << setprecision(2) << product->getPrice()
-             << setw(20) << fixed << setprecision(2) << totalValue << endl;
+        cout << left << setw(8) << product.getId()
+             << setw(40) << product.getName()
+             << setw(10) << product.getQuantity()
+             << setw(15) << fixed << setprecision(2) << product.getPrice()
+             << setw(20) << fixed << setprecision(2) << product.getTotalValue() << endl;
     }
     cout << "----------------------------------------------------------------" << endl;
 }
@@ -232,13 +987,12 @@ void Warehouse::printLowStockReport(int threshold) const {
     cout << "\n=== ТОВАРЫ С НИЗКИМ ОСТАТКОМ (< " << threshold << " шт.) ===" << endl;
     bool hasLowStock = false;
     
-    for (const auto& product : products) {
-        if (product->getQuantity() < threshold) {
-            hasLowStock = true;
-            cout << "ID: " << product->getId()
-                 << " | " << product->getName()
-                 << " | Остаток: " << product->getQuantity() << " шт." << endl;
-        }
+    for (int id : getLowStockProductIds(threshold)) {
+        hasLowStock = true;
+        size_t slot = products.find(id);
+        cout << "ID: " << id
+             << " | " << products.nameAt(slot)
+             << " | Остаток: " << products.quantityAt(slot) << " шт." << endl;
     }
     
     if (!hasLowStock) {
@@ -248,36 +1002,39 @@ void Warehouse::printLowStockReport(int threshold) const {
 
 void Warehouse::printDocumentsReport() const {
     cout << "\n=== ОТЧЕТ ПО ДОКУМЕНТАМ ===" << endl;
-    cout << "Всего документов: " << documents.size() << endl;
-    
-    map<string, int> docCount;
-    for (const auto& doc : documents) {
-        docCount[doc->getTypeName()]++;
-    }
+    DocumentSummary summary = summarizeDocuments();
+    cout << "Всего документов: " << summary.documents << endl;
     
-    for (const auto& [type, count] : docCount) {
-        cout << type << ": " << count << " шт." << endl;
+    for (int type = 0; type < DOCUMENT_TYPE_COUNT; type++) {
+        const DocumentTypeTotals& totals = summary.types[type];
+        if (totals.documents == 0) continue;
+        cout << documentTypeName(static_cast<DocumentType>(type)) << ": " << totals.documents
+             << " шт., строк " << totals.lines << ", на сумму " << totals.amount << " руб." << endl;
     }
 }
 
+const StockLedger& Warehouse::getLedger() const {
+    return ledger;
+}
+
+vector<MovementSummary> Warehouse::getMovementSummary(time_t from, time_t to) const {
+    return ledger.summarize(from, to);
+}
+
 int Warehouse::getTotalProductsCount() const {
     return products.size();
 }
 
-int Warehouse::getTotalItemsCount() const {
-    int total = 0;
-    for (const auto& product : products) {
-        total += product->getQuantity();
-    }
-    return total;
+long long Warehouse::getTotalItemsCount() const {
+    lock_guard<mutex> lock(stockMutex);
+    checkTotals();
+    return totalItems;
 }
 
 double Warehouse::getTotalInventoryValue() const {
-    double total = 0;
-    for (const auto& product : products) {
-        total += product->getPrice() * product->getQuantity();
-    }
-    return total;
+    lock_guard<mutex> lock(stockMutex);
+    checkTotals();
+    return totalValue;
 }
 
 map<string, int> Warehouse::getCategorySummary() const {
@@ -287,54 +1044,885 @@ map<string, int> Warehouse::getCategorySummary() const {
 }
 
 bool Warehouse::saveToFile(const string& filename) const {
+    SnapshotImage image;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        lock_guard<mutex> documentsLock(documentsLoadMutex);
+        image = SnapshotWriter::capture(products, documents.all(), nextProductId, nextDocumentId,
+                                        0, pendingDocuments);
+        image.ledger = ledger.share();
+    }
+    return SnapshotWriter::write(filename, image);
+}
+
+bool Warehouse::loadFromFile(const string& filename) {
+    if (!loadSnapshot(filename, nullptr)) return false;
+    // Журнал относится к прежнему состоянию - начинаем его заново от загруженного
+    if (isStorageOpen()) return checkpoint(true);
+    return true;
+}
+
+bool Warehouse::loadSnapshot(const string& filename, uint64_t* logGeneration) {
+    auto reader = make_shared<SnapshotReader>();
+    if (!reader->open(filename)) {
+        cout << "Ошибка загрузки снимка: " << reader->getError() << endl;
+        return false;
+    }
+    
+    lock_guard<mutex> lock(stockMutex);
+    // Горячие колонки (id, количество, цена) копируются из отображенного файла
+    // как есть, без разбора; наименования читаются прямо из файла
+    if (!products.assign(reader->productCount(),
+                         reader->section<int32_t>(SECTION_PRODUCT_IDS),
+                         reader->section<int32_t>(SECTION_PRODUCT_QUANTITIES),
+                         reader->section<double>(SECTION_PRODUCT_PRICES),
+                         reader->section<uint32_t>(SECTION_PRODUCT_NAME_OFFSETS),
+                         reader->section<char>(SECTION_PRODUCT_NAMES), reader)) {
+        cout << "Ошибка загрузки снимка: повторяющийся id товара" << endl;
+        return false;
+    }
+    
+    // Реестр документов строится при первом обращении (см. ensureDocuments)
+    {
+        lock_guard<mutex> documentsLock(documentsLoadMutex);
+        documents.clear();
+        pendingDocuments = reader->documentCount() > 0 ? reader : nullptr;
+        documentsPending.store(pendingDocuments != nullptr, memory_order_release);
+    }
+    
+    // Журнал движения заменяется вместе с каталогом: записи, сделанные до
+    // загрузки, к загруженному состоянию не относятся. Снимок старше
+    // версии 4 журнала движения не содержит.
+    ledger.clear();
+    const SnapshotLedgerRecord* ledgerRecords = reader->section<SnapshotLedgerRecord>(SECTION_LEDGER);
+    for (size_t i = 0; i < reader->ledgerCount(); i++) {
+        const SnapshotLedgerRecord& entry = ledgerRecords[i];
+        ledger.append(static_cast<time_t>(entry.timestamp), entry.productId, entry.delta,
+                      entry.documentId, static_cast<StockOperation>(entry.operation));
+    }
+    
+    nextProductId = max(nextProductId, static_cast<int>(reader->getHeader().nextProductId));
+    nextDocumentId = max(nextDocumentId, static_cast<int>(reader->getHeader().nextDocumentId));
+    if (logGeneration) *logGeneration = reader->getHeader().logGeneration;
+    
+    // Снимок чужого склада - исходное состояние зеркала
+    const SnapshotHeader& header = reader->getHeader();
+    if (header.syncSource != 0 && header.syncSource != instanceId) {
+        mirrorSource = header.syncSource;
+        mirrorPosition = WalPosition{header.syncGeneration, header.syncOffset};
+    }
+    resetAfterLoad();
+    return true;
+}
+
+// Строит реестр из документов снимка, отложенных при загрузке. Документы
+// восстанавливаются только заголовками; строки и поля остаются в отображенном
+// файле до первого обращения к документу. Потоки, обратившиеся к реестру
+// одновременно, ждут на documentsLoadMutex, пока он не будет построен целиком.
+void Warehouse::ensureDocuments() const {
+    if (!documentsPending.load(memory_order_acquire)) return;
+    lock_guard<mutex> lock(documentsLoadMutex);
+    if (!pendingDocuments) return;
+    shared_ptr<const SnapshotReader> reader = pendingDocuments;
+    
+    shared_ptr<const SnapshotContentSource> contentSource;
+    if (reader->hasDocumentContents()) contentSource = make_shared<SnapshotContentSource>(reader);
+    
+    const SnapshotDocumentRecord* records = reader->section<SnapshotDocumentRecord>(SECTION_DOCUMENTS);
+    for (size_t i = 0; i < reader->documentCount(); i++) {
+        const SnapshotDocumentRecord& record = records[i];
+        auto doc = restoreDocument(static_cast<DocumentType>(record.type), record.id,
+                                   string(reader->documentString(record.number)),
+                                   string(reader->documentString(record.createdBy)),
+                                   string(reader->documentString(record.department)),
+                                   string(reader->documentString(record.comment)),
+                                   static_cast<time_t>(record.date),
+                                   parseDocumentStatus(static_cast<DocumentType>(record.type),
+                                                       reader->documentString(record.status)));
+        if (contentSource) doc->setContentSource(contentSource, static_cast<uint32_t>(i));
+        documents.add(doc);
+    }
+    pendingDocuments.reset();
+    documentsPending.store(false, memory_order_release);
+}
+
+DocumentRegistry& Warehouse::loadedDocuments() const {
+    ensureDocuments();
+    return documents;
+}
+
+size_t Warehouse::getDocumentCount() const {
+    lock_guard<mutex> lock(documentsLoadMutex);
+    return pendingDocuments ? pendingDocuments->documentCount() : documents.size();
+}
+
+bool Warehouse::openStorage(const string& basePath) {
+    closeStorage();
+    storagePath = basePath;
+    string snapshotPath = basePath + ".bin";
+    if (!loadSyncState()) return false;
+    
+    uint64_t fromGeneration = 0;
+    bool hasSnapshot = filesystem::exists(snapshotPath);
+    // Хранилище создается впервые: ни снимка, ни журнала
+    bool created = !hasSnapshot && WriteAheadLog::listGenerations(basePath).empty();
+    if (hasSnapshot && !loadSnapshot(snapshotPath, &fromGeneration)) return false;
+    
+    // Холодные сегменты нужны уже при воспроизведении: записи журнала
+    // могут относиться к документам, вытесненным из реестра
+    if (!coldDocuments.open(basePath)) {
+        cout << "Холодные сегменты документов открыты не все: " << coldDocuments.getError() << endl;
+    }
+    
+    // Воспроизводим только поколения журнала, которые не вошли в снимок
+    string error;
+    size_t replayed;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        replayed = WriteAheadLog::replay(basePath, fromGeneration,
+            [this](WalRecordReader& record) { return applyLogRecord(record); }, error);
+        if (replayed > 0) resetAfterLoad();
+    }
+    if (replayed > 0) {
+        cout << "Из журнала восстановлено изменений: " << replayed << endl;
+    }
+    if (!error.empty()) {
+        cout << "Журнал восстановлен не полностью: " << error << endl;
+    }
+    
+    // Продолжаем последнее поколение; оборванный хвост ниже сразу уходит в снимок
+    vector<uint64_t> generations = WriteAheadLog::listGenerations(basePath);
+    uint64_t generation = generations.empty() ? fromGeneration
+                                              : max(fromGeneration, generations.back());
+    if (!wal.open(basePath, generation)) {
+        cout << "Не удалось открыть журнал " << WriteAheadLog::generationPath(basePath, generation) << endl;
+        return false;
+    }
+    
+    // Новое хранилище начинается с демонстрационного каталога; он пишется
+    // в журнал и сразу попадает в первый снимок
+    if (created && getTotalProductsCount() == 0) initializeProducts();
+    
+    // Без снимка, а также после оборванного журнала сразу фиксируем
+    // восстановленное состояние: недочитанный хвост больше не нужен.
+    // Контрольная точка заодно вытесняет устаревшие документы.
+    if (!hasSnapshot || !error.empty() || hasColdCandidates()) return checkpoint(true);
+    return true;
+}
+
+void Warehouse::closeStorage() {
+    {
+        lock_guard<mutex> lock(checkpointMutex);
+        if (checkpointTask.valid()) checkpointTask.get();
+    }
+    wal.close();
+    coldDocuments.close();
+    faultedDocuments.clear();
+    instanceId = 0;
+    exportedPosition = WalPosition();
+    mirrorSource = 0;
+    mirrorPosition = WalPosition();
+}
+
+bool Warehouse::isStorageOpen() const {
+    return wal.isOpen();
+}
+
+bool Warehouse::commit() {
+    return wal.isOpen() && wal.sync();
+}
+
+void Warehouse::setCheckpointThreshold(uint64_t bytes) {
+    checkpointThreshold = bytes;
+}
+
+bool Warehouse::checkpoint(bool wait) {
+    if (!wal.isOpen()) return false;
+    
+    lock_guard<mutex> checkpointLock(checkpointMutex);
+    if (checkpointTask.valid()) {
+        // Предыдущая контрольная точка еще пишется - новая не нужна
+        if (!wait && checkpointTask.wait_for(chrono::seconds(0)) != future_status::ready) {
+            return true;
+        }
+        checkpointTask.get();
+    }
+    
+    if (!startCheckpointLocked(nullptr, nullptr)) return false;
+    if (!wait) return true;
+    return checkpointTask.get();
+}
+
+bool Warehouse::saveInBackground(const SnapshotProgress& progress,
+                                 const function<void(bool)>& finished) {
+    if (!wal.isOpen()) return false;
+    
+    lock_guard<mutex> checkpointLock(checkpointMutex);
+    if (checkpointTask.valid()) {
+        if (checkpointTask.wait_for(chrono::seconds(0)) != future_status::ready) return false;
+        checkpointTask.get();
+    }
+    return startCheckpointLocked(progress, finished);
+}
+
+// Снимает копию состояния и запускает ее запись в фоне; вызывается под checkpointMutex
+bool Warehouse::startCheckpointLocked(const SnapshotProgress& progress,
+                                      const function<void(bool)>& finished) {
+    // Снимок не должен содержать вытесненные документы: они уже в сегментах
+    tierDocuments();
+    
+    // Новое поколение журнала и копия состояния снимаются в одной критической
+    // секции: все, что попало в старые поколения, есть в снимке
+    auto image = make_shared<SnapshotImage>();
+    uint64_t generation;
+    uint64_t removeBefore;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        uint64_t previous = wal.currentGeneration();
+        generation = wal.rotate();
+        if (generation == previous) {
+            cout << "Не удалось начать новое поколение журнала" << endl;
+            return false;
+        }
+        // Еще не загруженные документы переносятся из прежнего снимка как есть
+        lock_guard<mutex> documentsLock(documentsLoadMutex);
+        *image = SnapshotWriter::capture(products, documents.all(), nextProductId,
+                                         nextDocumentId, generation, pendingDocuments);
+        image->ledger = ledger.share();
+        fillSyncFields(*image, generation);
+        // Еще не выгруженные для зеркала поколения остаются на диске
+        removeBefore = instanceId != 0 ? min(generation, exportedPosition.generation) : generation;
+    }
+    
+    string snapshotPath = storagePath + ".bin";
+    WriteAheadLog* log = &wal;
+    checkpointTask = async(launch::async, [image, snapshotPath, log, removeBefore, progress, finished]() {
+        bool ok = SnapshotWriter::write(snapshotPath, *image, progress);
+        // Старые поколения удаляются только после того, как снимок на диске
+        if (ok) log->removeGenerationsBefore(removeBefore);
+        if (finished) finished(ok);
+        return ok;
+    });
+    return true;
+}
+
+// Снимок склада-источника соответствует началу нового поколения его журнала,
+// снимок зеркала - последнему примененному пакету
+void Warehouse::fillSyncFields(SnapshotImage& image, uint64_t generation) const {
+    if (mirrorSource != 0) {
+        image.syncSource = mirrorSource;
+        image.syncGeneration = mirrorPosition.generation;
+        image.syncOffset = mirrorPosition.offset;
+    } else if (instanceId != 0) {
+        image.syncSource = instanceId;
+        image.syncGeneration = generation;
+        image.syncOffset = 0;
+    }
+}
+
+bool Warehouse::loadSyncState() {
+    ifstream file(storagePath + ".sync");
+    if (!file.is_open()) return true;
+    
+    string key;
+    while (file >> key) {
+        if (key == "instance") {
+            file >> instanceId;
+        } else if (key == "exported") {
+            file >> exportedPosition.generation >> exportedPosition.offset;
+        } else {
+            break;
+        }
+    }
+    if (file.fail() && !file.eof()) {
+        cout << "Поврежден файл " << storagePath << ".sync" << endl;
+        return false;
+    }
+    return true;
+}
+
+// Файл заменяется целиком через переименование. Если запись потеряется при
+// сбое, следующий пакет повторит часть уже выгруженного - зеркало ее пропустит.
+bool Warehouse::saveSyncState() const {
+    string filename = storagePath + ".sync";
+    string tempFilename = filename + ".tmp";
+    {
+        ofstream file(tempFilename, ios::trunc);
+        if (!file.is_open()) return false;
+        file << "instance " << instanceId << "\n"
+             << "exported " << exportedPosition.generation << " " << exportedPosition.offset << "\n";
+        if (!file.good()) return false;
+    }
+    error_code error;
+    filesystem::rename(tempFilename, filename, error);
+    return !error;
+}
+
+bool Warehouse::startLiveView(const string& name) {
+    lock_guard<mutex> lock(stockMutex);
+    if (!liveView.open(name, products)) {
+        cout << "Не удалось опубликовать остатки: " << liveView.getError() << endl;
+        return false;
+    }
+    return true;
+}
+
+void Warehouse::stopLiveView() {
+    lock_guard<mutex> lock(stockMutex);
+    liveView.close();
+}
+
+bool Warehouse::startChangeTracking() {
+    if (!wal.isOpen()) return false;
+    if (mirrorSource != 0) {
+        cout << "Зеркало другого склада не выгружает собственные изменения" << endl;
+        return false;
+    }
+    if (instanceId != 0) return true;
+    
+    random_device device;
+    mt19937_64 generator((static_cast<uint64_t>(device()) << 32) ^ device() ^
+                         static_cast<uint64_t>(time(nullptr)));
+    uint64_t id = 0;
+    while (id == 0) id = generator();
+    
+    // Под checkpointMutex поколение журнала меняет только эта контрольная
+    // точка: ее снимок и позиция выгрузки указывают на одно и то же место
+    lock_guard<mutex> checkpointLock(checkpointMutex);
+    if (checkpointTask.valid()) checkpointTask.get();
+    {
+        lock_guard<mutex> lock(stockMutex);
+        instanceId = id;
+        exportedPosition = WalPosition();
+    }
+    if (!startCheckpointLocked(nullptr, nullptr) || !checkpointTask.get()) {
+        lock_guard<mutex> lock(stockMutex);
+        instanceId = 0;
+        return false;
+    }
+    {
+        lock_guard<mutex> lock(stockMutex);
+        exportedPosition = WalPosition{wal.currentGeneration(), 0};
+    }
+    return saveSyncState();
+}
+
+DeltaExportResult Warehouse::exportChanges(const string& filename) {
+    DeltaExportResult result;
+    if (!wal.isOpen() || instanceId == 0) {
+        result.error = "Выгрузка изменений не включена";
+        return result;
+    }
+    
+    // Все записи до этой позиции должны быть на диске до чтения журнала
+    WalPosition to = wal.position();
+    if (!wal.sync()) {
+        result.error = "Не удалось сбросить журнал на диск";
+        return result;
+    }
+    
+    result = DeltaWriter::write(filename, storagePath, instanceId, exportedPosition, to);
+    if (!result.success) return result;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        exportedPosition = to;
+    }
+    if (!saveSyncState()) {
+        result.success = false;
+        result.error = "Не удалось сохранить позицию выгрузки в " + storagePath + ".sync";
+    }
+    return result;
+}
+
+DeltaImportResult Warehouse::importChanges(const string& filename) {
+    DeltaImportResult result;
+    if (!wal.isOpen()) {
+        result.error = "Хранилище не открыто";
+        return result;
+    }
+    if (instanceId != 0) {
+        result.error = "Склад сам выгружает изменения и не может быть зеркалом";
+        return result;
+    }
+    DeltaReader delta;
+    if (!delta.open(filename)) {
+        result.error = delta.getError();
+        return result;
+    }
+    
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (mirrorSource == 0) {
+            result.error = "Склад не является зеркалом: сначала загрузите копию снимка источника";
+            return result;
+        }
+        if (delta.sourceId() != mirrorSource) {
+            result.error = "Пакет выгружен другим складом: зеркало принимает изменения только "
+                           "склада, с копии снимка которого оно начато";
+            return result;
+        }
+        if (mirrorPosition < delta.from()) {
+            result.error = "Пропущены изменения: пакет начинается с поколения " +
+                           to_string(delta.from().generation) + ", применено до поколения " +
+                           to_string(mirrorPosition.generation);
+            return result;
+        }
+        if (!(mirrorPosition < delta.to())) {
+            // Пакет уже применен
+            result.skippedRecords = delta.recordCount();
+            result.success = true;
+            return result;
+        }
+        
+        // Пакет проверяется целиком до применения: некорректная запись или
+        // конфликт с данными зеркала отклоняют его, ничего не меняя
+        DeltaCreations created;
+        delta.forEach([&](const char*, size_t, WalPosition position, WalRecordReader& record) {
+            if (position < mirrorPosition || checkDeltaRecord(record, created, result.error)) return true;
+            if (result.error.empty()) {
+                result.error = "Некорректная запись в пакете на смещении " + to_string(position.offset) +
+                               " поколения " + to_string(position.generation);
+            }
+            return false;
+        });
+        if (!result.error.empty()) return result;
+        
+        // Примененные записи попадают в журнал зеркала одной записью вместе
+        // с новой позицией: после сбоя пакет восстанавливается целиком или никак
+        string frames;
+        WalPosition reached = delta.to();
+        bool failed = false;
+        delta.forEach([&](const char* frame, size_t frameSize, WalPosition position,
+                          WalRecordReader& record) {
+            if (position < mirrorPosition) {
+                result.skippedRecords++;
+                return true;
+            }
+            if (!applyLogRecord(record) || !record.good()) {
+                reached = position;
+                failed = true;
+                return false;
+            }
+            frames.append(frame, frameSize);
+            result.appliedRecords++;
+            return true;
+        });
+        
+        mirrorPosition = reached;
+        resetAfterLoad();
+        logRecord(WalRecordBuilder(WalRecordType::CHANGES_APPLIED)
+                      .putUInt64(mirrorSource)
+                      .putUInt64(reached.generation)
+                      .putUInt64(reached.offset)
+                      .putTail(frames.data(), frames.size()));
+        if (failed) {
+            result.error = "Некорректная запись в пакете на смещении " + to_string(reached.offset) +
+                           " поколения " + to_string(reached.generation);
+        }
+    }
+    
+    if (!commit() && result.error.empty()) result.error = "Не удалось записать журнал";
+    maybeCheckpoint();
+    result.success = result.error.empty();
+    return result;
+}
+
+void Warehouse::maybeCheckpoint() {
+    if (wal.isOpen() && wal.bytesInGeneration() >= checkpointThreshold) {
+        checkpoint(false);
+    }
+}
+
+// Зеркало меняется только пакетами источника (см. importChanges): локальные
+// товары и документы получили бы id и номера, которые источник выдаст своим.
+// Вызывается под stockMutex.
+bool Warehouse::rejectOnMirror() const {
+    if (mirrorSource == 0) return false;
+    cout << MIRROR_READ_ONLY_ERROR << endl;
+    return true;
+}
+
+// Проверяет запись пакета перед применением; вызывается под stockMutex.
+// Запись должна разбираться целиком, а создаваемые ею товары и документы -
+// не совпадать по id и номеру ни с данными зеркала, ни с созданными выше
+// в том же пакете. false без error - запись повреждена.
+bool Warehouse::checkDeltaRecord(WalRecordReader& record, DeltaCreations& created,
+                                 string& error) const {
+    auto addsProduct = [&](int id) {
+        if (products.contains(id) || !created.products.insert(id).second) {
+            error = "Конфликт пакета: товар id " + to_string(id) + " уже есть на зеркале";
+            return false;
+        }
+        return true;
+    };
+    auto readsQuantities = [&record]() {
+        int count = record.getInt();
+        if (!record.good() || count < 0) return false;
+        for (int i = 0; i < count && record.good(); i++) {
+            record.getInt();
+            record.getInt();
+        }
+        return record.good();
+    };
+    
+    switch (record.type()) {
+        case WalRecordType::PRODUCT_ADD: {
+            int id = record.getInt();
+            record.getDouble();
+            record.getInt();
+            record.getString();
+            return record.good() && addsProduct(id);
+        }
+        case WalRecordType::PRODUCT_BATCH_ADD: {
+            int count = record.getInt();
+            if (!record.good() || count < 0) return false;
+            for (int i = 0; i < count; i++) {
+                int id = record.getInt();
+                record.getDouble();
+                record.getInt();
+                record.getString();
+                if (!record.good() || !addsProduct(id)) return false;
+            }
+            return true;
+        }
+        case WalRecordType::PRODUCT_REMOVE:
+            record.getInt();
+            return record.good();
+        case WalRecordType::QUANTITY_SET:
+            record.getInt();
+            record.getInt();
+            return record.good();
+        case WalRecordType::DOCUMENT_CREATE: {
+            int id = record.getInt();
+            int type = record.getInt();
+            record.getInt64();
+            string number = record.getString();
+            record.getString();
+            record.getString();
+            record.getString();
+            if (!record.good() || type < 0 || type >= DOCUMENT_TYPE_COUNT) return false;
+            const DocumentRegistry& registry = loadedDocuments();
+            if (registry.findById(id) || (coldDocuments.isOpen() && coldDocuments.contains(id)) ||
+                !created.documents.insert(id).second) {
+                error = "Конфликт пакета: документ id " + to_string(id) + " уже есть на зеркале";
+                return false;
+            }
+            if (registry.findByNumber(number) ||
+                (coldDocuments.isOpen() && coldDocuments.findNumber(number) != 0) ||
+                !created.numbers.insert(number).second) {
+                error = "Конфликт пакета: документ №" + number + " уже есть на зеркале";
+                return false;
+            }
+            return true;
+        }
+        case WalRecordType::DOCUMENT_ITEM:
+            record.getInt();
+            record.getInt();
+            record.getInt();
+            record.getString();
+            return record.good();
+        case WalRecordType::DOCUMENT_FIELD:
+            record.getInt();
+            record.getString();
+            record.getString();
+            return record.good();
+        case WalRecordType::DOCUMENT_POSTED:
+            record.getInt();
+            record.getString();
+            return record.good() && readsQuantities();
+        case WalRecordType::DOCUMENT_CANCELLED:
+            record.getInt();
+            return record.good() && readsQuantities();
+        case WalRecordType::CATALOG_REPLACED:
+            error = "Каталог источника заменен целиком: нужна новая копия его снимка";
+            return false;
+        case WalRecordType::CHANGES_APPLIED:
+            // Источник сам не бывает зеркалом
+            return false;
+    }
+    return false;
+}
+
+// Добавляет запись в журнал, если хранилище открыто. Вызывается под stockMutex
+// вместе с самим изменением, поэтому порядок записей совпадает с порядком применения.
+void Warehouse::logRecord(const WalRecordBuilder& record) {
+    if (wal.isOpen()) wal.append(record);
+}
+
+// Применяет запись журнала при восстановлении; вызывается под stockMutex.
+// Итоги и индекс по остатку пересчитываются один раз после воспроизведения.
+bool Warehouse::applyLogRecord(WalRecordReader& record) {
+    switch (record.type()) {
+        case WalRecordType::PRODUCT_ADD: {
+            int id = record.getInt();
+            double price = record.getDouble();
+            int quantity = record.getInt();
+            string name = record.getString();
+            time_t timestamp = record.atEnd() ? 0 : static_cast<time_t>(record.getInt64());
+            if (!record.good()) return false;
+            if (!products.contains(id)) {
+                products.append(id, name, price, quantity);
+                if (quantity != 0 && timestamp != 0) {
+                    ledger.append(timestamp, id, quantity, 0, StockOperation::PRODUCT_CREATED);
+                }
+            }
+            nextProductId = max(nextProductId, id + 1);
+            return true;
+        }
+        case WalRecordType::PRODUCT_BATCH_ADD: {
+            int count = record.getInt();
+            if (!record.good() || count < 0) return false;
+            vector<pair<int, int>> created;
+            for (int i = 0; i < count; i++) {
+                int id = record.getInt();
+                double price = record.getDouble();
+                int quantity = record.getInt();
+                string name = record.getString();
+                if (!record.good()) return false;
+                if (!products.contains(id)) {
+                    products.append(id, name, price, quantity);
+                    if (quantity != 0) created.emplace_back(id, quantity);
+                }
+                nextProductId = max(nextProductId, id + 1);
+            }
+            // Время пакета записано после всех товаров
+            time_t timestamp = record.atEnd() ? 0 : static_cast<time_t>(record.getInt64());
+            if (!record.good()) return false;
+            if (timestamp != 0) {
+                for (const auto& [id, quantity] : created) {
+                    ledger.append(timestamp, id, quantity, 0, StockOperation::PRODUCT_CREATED);
+                }
+            }
+            return true;
+        }
+        case WalRecordType::CATALOG_REPLACED:
+            // Новый каталог записан снимком; для зеркала это разрыв потока изменений
+            return true;
+        case WalRecordType::CHANGES_APPLIED: {
+            uint64_t source = record.getUInt64();
+            WalPosition position;
+            position.generation = record.getUInt64();
+            position.offset = record.getUInt64();
+            if (!record.good()) return false;
+            string_view frames = record.getTail();
+            bool failed = false;
+            size_t parsed = WriteAheadLog::scanFrames(frames.data(), frames.size(),
+                [&](const char*, size_t, size_t, WalRecordReader& inner) {
+                    failed = !applyLogRecord(inner) || !inner.good();
+                    return !failed;
+                });
+            if (failed || parsed != frames.size()) return false;
+            mirrorSource = source;
+            mirrorPosition = position;
+            return true;
+        }
+        case WalRecordType::PRODUCT_REMOVE: {
+            int id = record.getInt();
+            time_t timestamp = record.atEnd() ? 0 : static_cast<time_t>(record.getInt64());
+            if (!record.good()) return false;
+            size_t slot = products.find(id);
+            if (slot != ProductStore::npos && products.quantityAt(slot) != 0 && timestamp != 0) {
+                ledger.append(timestamp, id, -products.quantityAt(slot), 0,
+                              StockOperation::PRODUCT_REMOVED);
+            }
+            products.remove(id);
+            reorderThresholds.erase(id);
+            return true;
+        }
+        case WalRecordType::QUANTITY_SET: {
+            int id = record.getInt();
+            int quantity = record.getInt();
+            time_t timestamp = 0;
+            int operation = static_cast<int>(StockOperation::MANUAL_SET);
+            if (!record.atEnd()) {
+                timestamp = static_cast<time_t>(record.getInt64());
+                operation = record.getInt();
+            }
+            if (!record.good() || operation < static_cast<int>(StockOperation::MANUAL_SET) ||
+                operation > static_cast<int>(StockOperation::MANUAL_REMOVE)) {
+                return false;
+            }
+            size_t slot = products.find(id);
+            if (slot != ProductStore::npos) {
+                replayQuantityAt(slot, quantity, static_cast<StockOperation>(operation), 0, timestamp);
+            }
+            return true;
+        }
+        case WalRecordType::DOCUMENT_CREATE: {
+            int id = record.getInt();
+            int type = record.getInt();
+            time_t date = static_cast<time_t>(record.getInt64());
+            string number = record.getString();
+            string createdBy = record.getString();
+            string department = record.getString();
+            string comment = record.getString();
+            if (!record.good() || type < 0 || type >= DOCUMENT_TYPE_COUNT) return false;
+            loadedDocuments().add(restoreDocument(static_cast<DocumentType>(type), id, number, createdBy,
+                                          department, comment, date, DocumentStatus::DRAFT));
+            nextDocumentId = max(nextDocumentId, id + 1);
+            return true;
+        }
+        case WalRecordType::DOCUMENT_ITEM: {
+            int docId = record.getInt();
+            int productId = record.getInt();
+            int quantity = record.getInt();
+            string comment = record.getString();
+            if (!record.good()) return false;
+            auto doc = findModifiedDocument(docId);
+            size_t slot = products.find(productId);
+            if (doc && slot != ProductStore::npos) {
+                doc->addLine(productId, products.nameAt(slot), products.priceAt(slot), quantity, comment);
+            }
+            return true;
+        }
+        case WalRecordType::DOCUMENT_FIELD: {
+            int docId = record.getInt();
+            string fieldName = record.getString();
+            string value = record.getString();
+            if (!record.good()) return false;
+            if (auto doc = findModifiedDocument(docId)) doc->setSpecificField(fieldName, value);
+            return true;
+        }
+        case WalRecordType::DOCUMENT_POSTED: {
+            int docId = record.getInt();
+            string status = record.getString();
+            vector<pair<int, int>> changes;
+            if (!record.good() || !readQuantityChanges(record, changes)) return false;
+            time_t timestamp = record.atEnd() ? 0 : static_cast<time_t>(record.getInt64());
+            if (!record.good()) return false;
+            for (const auto& [productId, quantity] : changes) {
+                size_t slot = products.find(productId);
+                if (slot != ProductStore::npos) {
+                    replayQuantityAt(slot, quantity, StockOperation::DOCUMENT_POSTING, docId, timestamp);
+                }
+            }
+            if (auto doc = findModifiedDocument(docId)) documents.transition(doc, DocumentStatus::POSTED);
+            return true;
+        }
+        case WalRecordType::DOCUMENT_CANCELLED: {
+            int docId = record.getInt();
+            vector<pair<int, int>> changes;
+            if (!record.good() || !readQuantityChanges(record, changes)) return false;
+            time_t timestamp = record.atEnd() ? 0 : static_cast<time_t>(record.getInt64());
+            if (!record.good()) return false;
+            for (const auto& [productId, quantity] : changes) {
+                size_t slot = products.find(productId);
+                if (slot != ProductStore::npos) {
+                    replayQuantityAt(slot, quantity, StockOperation::DOCUMENT_CANCEL, docId, timestamp);
+                }
+            }
+            if (auto doc = findModifiedDocument(docId)) documents.transition(doc, DocumentStatus::CANCELLED);
+            return true;
+        }
+    }
+    return false;
+}
+
+// Остаток из записи журнала при восстановлении. Итоги и индексы
+// пересчитываются после воспроизведения (resetAfterLoad), а журнал движения
+// пополняется здесь же, со временем из записи. В записях старого формата
+// времени нет (timestamp == 0) - такие изменения в журнал движения не попадают.
+void Warehouse::replayQuantityAt(size_t slot, int newQuantity, StockOperation operation,
+                                 int documentId, time_t timestamp) {
+    int delta = newQuantity - products.quantityAt(slot);
+    if (delta != 0 && timestamp != 0) {
+        ledger.append(timestamp, products.idAt(slot), delta, documentId, operation);
+    }
+    products.setQuantityAt(slot, newQuantity);
+}
+
+// Пары (id товара, новое количество) записей проведения и отмены
+bool Warehouse::readQuantityChanges(WalRecordReader& record, vector<pair<int, int>>& changes) {
+    int count = record.getInt();
+    if (!record.good() || count < 0) return false;
+    changes.reserve(static_cast<size_t>(count));
+    for (int i = 0; i < count; i++) {
+        int productId = record.getInt();
+        int quantity = record.getInt();
+        if (!record.good()) return false;
+        changes.emplace_back(productId, quantity);
+    }
+    return true;
+}
+
+// Пересчитывает производные структуры после замены каталога целиком
+void Warehouse::resetAfterLoad() {
+    recalculateTotals();
+    invalidateIndexes();
+    if (liveView.isOpen()) liveView.publishAll(products);
+}
+
+// Поле CSV в кавычках, если в нем есть запятая, кавычка или перевод строки
+static string csvField(string_view value) {
+    if (value.find_first_of(",\"\r\n") == string_view::npos) return string(value);
+    string quoted = "\"";
+    for (char c : value) {
+        if (c == '"') quoted += '"';
+        quoted += c;
+    }
+    quoted += '"';
+    return quoted;
+}
+
+bool Warehouse::exportToCsv(const string& filename) const {
     ofstream file(filename);
     if (!file.is_open()) return false;
     
     // Сохраняем товары
     file << "[PRODUCTS]" << endl;
+    file << setprecision(15);
     for (const auto& product : products) {
-        file << product->getId() << ","
-             << product->getName() << ","
-             << product->getPrice() << ","
-             << product->getQuantity() << endl;
+        file << product.getId() << ","
+             << csvField(product.getName()) << ","
+             << product.getPrice() << ","
+             << product.getQuantity() << "\n";
     }
     
     file.close();
     return true;
 }
 
-bool Warehouse::loadFromFile(const string& filename) {
-    ifstream file(filename);
-    if (!file.is_open()) return false;
-    
-    // Загружаем товары
-    string line;
-    while (getline(file, line)) {
-        if (line == "[PRODUCTS]") break;
+bool Warehouse::importFromCsv(const string& filename) {
+    CsvImportResult result = importCatalog(filename);
+    if (!result.success) {
+        cout << "Ошибка импорта CSV: " << result.error << endl;
+        return false;
+    }
+    for (const auto& error : result.errors) {
+        cout << "Пропущена строка CSV " << error.line << ": " << error.message << endl;
+    }
+    if (result.rejectedRows > result.errors.size()) {
+        cout << "... и еще " << result.rejectedRows - result.errors.size() << " строк" << endl;
+    }
+    return true;
+}
+
+CsvImportResult Warehouse::importCatalog(const string& filename, unsigned threads) {
+    // Разбор идет без блокировки склада, под ней - только замена каталога
+    CsvImporter importer;
+    if (!importer.parse(filename, threads)) {
+        CsvImportResult result;
+        result.error = importer.getError();
+        return result;
     }
     
-    products.clear();
-    while (getline(file, line) && !line.empty()) {
-        stringstream ss(line);
-        string token;
-        vector<string> tokens;
-        
-        while (getline(ss, token, ',')) {
-            tokens.push_back(token);
-        }
-        
-        if (tokens.size() >= 4) {
-            int id = stoi(tokens[0]);
-            string name = tokens[1];
-            double price = stod(tokens[2]);
-            int quantity = stoi(tokens[3]);
-            
-            auto product = make_shared<Product>(id, name, price, quantity);
-            products.push_back(product);
-            if (id >= nextProductId) nextProductId = id + 1;
+    CsvImportResult result;
+    {
+        lock_guard<mutex> lock(stockMutex);
+        if (mirrorSource != 0) {
+            result.error = MIRROR_READ_ONLY_ERROR;
+            return result;
         }
+        result = importer.storeTo(products);
+        nextProductId = max(nextProductId, result.maxProductId + 1);
+        resetAfterLoad();
+        if (instanceId != 0) logRecord(WalRecordBuilder(WalRecordType::CATALOG_REPLACED));
     }
     
-    file.close();
-    return true;
-}
\ No newline at end of file
+    // Каталог заменен целиком - дешевле записать снимок, чем журналировать каждую строку
+    if (isStorageOpen() && !checkpoint(true)) {
+        result.success = false;
+        result.error = "Не удалось записать снимок после импорта";
+    }
+    return result;
+}
@@ -2,40 +2,247 @@
 #define WAREHOUSE_H
 
 #include "product.h"
+#include "product_store.h"
+#include "document_registry.h"
+#include "stock_posting.h"
+#include "stock_ledger.h"
+#include "write_ahead_log.h"
+#include "csv_import.h"
+#include "document_archive.h"
+#include "snapshot.h"
+#include "document_cold_store.h"
+#include "change_delta.h"
+#include "live_stock_publisher.h"
+#include "columnar_file.h"
 #include "document_type.h"  // Включаем отдельный файл с enum
 #include <vector>
+#include <array>
 #include <memory>
 #include <iostream>
 #include <map>
+#include <set>
+#include <unordered_map>
+#include <unordered_set>
+#include <functional>
+#include <mutex>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <ctime>
 
 // Предварительное объявление классов
 class DocumentBase;
 template<DocumentType> class DocumentTemplate;
 
+// Событие пересечения порога дозаказа
+struct ReorderEvent {
+    int productId;
+    int oldQuantity;
+    int newQuantity;
+    int threshold;
+    bool belowThreshold;  // true - остаток опустился ниже порога, false - восстановился
+};
+
+using ReorderCallback = std::function<void(const ReorderEvent&)>;
+
+// Строка пакетного добавления товаров (см. Warehouse::addProducts)
+struct ProductDraft {
+    std::string name;
+    double price;
+    int quantity;
+};
+
+enum class BulkAddStatus {
+    ADDED,                // товар создан
+    EXISTING_NAME,        // товар с таким наименованием уже есть на складе
+    DUPLICATE_IN_BATCH,   // наименование уже встречалось выше в этом же пакете
+    INVALID               // пустое наименование, отрицательная цена или количество;
+                          // также все строки, если склад - зеркало (см. importChanges)
+};
+
+struct BulkAddOutcome {
+    BulkAddStatus status;
+    int productId;        // созданный или уже существующий товар; 0 для INVALID
+};
+
+struct BulkAddResult {
+    size_t added = 0;
+    size_t duplicates = 0;
+    size_t rejected = 0;
+    std::vector<BulkAddOutcome> rows;   // по одной на каждую строку пакета, в том же порядке
+};
+
+// Выгрузка для аналитики (см. Warehouse::exportAnalytics)
+struct AnalyticsExportResult {
+    bool success = false;
+    std::string error;
+    std::vector<std::string> files;
+    size_t products = 0;
+    size_t documents = 0;
+    size_t documentLines = 0;
+    size_t movements = 0;
+};
+
+// Итоги по документам одного типа (см. Warehouse::summarizeDocuments)
+struct DocumentTypeTotals {
+    size_t documents = 0;
+    size_t lines = 0;
+    double amount = 0.0;                                    // сумма строк: цена × количество
+    std::array<size_t, DOCUMENT_STATUS_COUNT> byStatus{};   // число документов в каждом статусе
+};
+
+struct DocumentSummary {
+    size_t documents = 0;
+    std::array<DocumentTypeTotals, DOCUMENT_TYPE_COUNT> types{};
+};
+
 class Warehouse {
 private:
-    std::vector<std::shared_ptr<Product>> products;
-    std::vector<std::shared_ptr<DocumentBase>> documents;
+    ProductStore products;
+    // Реестр строится при первом обращении к документам (см. ensureDocuments),
+    // до тех пор документы лежат в отображенном снимке pendingDocuments.
+    // Построение может начаться из const-метода в любом потоке, поэтому
+    // pendingDocuments и построение реестра защищены documentsLoadMutex
+    // (берется после stockMutex, не наоборот), а documentsPending позволяет
+    // не брать его, когда реестр уже готов.
+    mutable DocumentRegistry documents;
+    mutable std::shared_ptr<const SnapshotReader> pendingDocuments;
+    mutable std::mutex documentsLoadMutex;
+    mutable std::atomic<bool> documentsPending{false};
     int nextProductId = 1001;
     int nextDocumentId = 1;
     
+    // Итоги по складу, поддерживаемые при каждом изменении
+    long long totalItems = 0;
+    double totalValue = 0;
+    
+    // Товары, упорядоченные по остатку: (количество, id).
+    // Строится при первом запросе, чтобы не замедлять загрузку каталога.
+    mutable std::set<std::pair<int, int>> quantityIndex;
+    mutable bool quantityIndexReady = false;
+    
+    // Наименование -> товар; тоже строится при первом запросе
+    mutable ProductNameIndex nameIndex;
+    mutable bool nameIndexReady = false;
+    
+    // Журнал движения: запись на каждое изменение остатка
+    StockLedger ledger;
+    
+    // Пороги дозаказа и подписчики на их пересечение
+    int defaultReorderThreshold = 5;
+    std::unordered_map<int, int> reorderThresholds;
+    std::map<int, ReorderCallback> reorderSubscribers;
+    std::vector<ReorderEvent> pendingReorderEvents;
+    int nextSubscriptionId = 1;
+    
+    // Критическая секция для всех изменений остатков; подписчики
+    // уведомляются уже после ее снятия
+    mutable std::mutex stockMutex;
+    
+    // Журнал изменений и контрольные точки (см. openStorage)
+    std::string storagePath;
+    WriteAheadLog wal;
+    std::future<bool> checkpointTask;
+    std::mutex checkpointMutex;
+    uint64_t checkpointThreshold = 16 * 1024 * 1024;
+    
+    // Холодный уровень: проведенные документы старше documentTierAge
+    // вытесняются из реестра в сжатые сегменты (см. tierDocuments)
+    DocumentColdStore coldDocuments;
+    time_t documentTierAge = 30 * 24 * 3600;
+    std::unordered_set<int> faultedDocuments;   // возвращены из сегментов и не менялись
+    
+    // Пакеты изменений (см. change_delta.h). Источник: id склада (0 - изменения
+    // не выгружаются) и позиция журнала, до которой они уже выгружены; более
+    // поздние поколения журнала не удаляются. Хранится в <basePath>.sync.
+    uint64_t instanceId = 0;
+    WalPosition exportedPosition;
+    // Зеркало: склад-источник и позиция его журнала, до которой изменения применены.
+    // Зеркало повторяет ровно один источник и само не меняется (см. rejectOnMirror).
+    uint64_t mirrorSource = 0;
+    WalPosition mirrorPosition;
+    
+    // Товары и документы, которые создает проверяемый пакет (см. checkDeltaRecord)
+    struct DeltaCreations {
+        std::unordered_set<int> products;
+        std::unordered_set<int> documents;
+        std::unordered_set<std::string> numbers;
+    };
+    
+    // Живая витрина остатков для внешних процессов (см. live_stock.h)
+    LiveStockPublisher liveView;
+    
     void initializeProducts();
+    bool registerDocument(const std::shared_ptr<DocumentBase>& doc);
+    void setQuantityAt(size_t slot, int newQuantity, StockOperation operation,
+                       int documentId = 0, time_t timestamp = 0);
+    void recalculateTotals();
+    void invalidateIndexes();
+    void ensureQuantityIndex() const;
+    void ensureNameIndex() const;
+    void resetAfterLoad();
+    int reorderThresholdLocked(int productId) const;
+    void queueReorderEvent(int productId, int oldQuantity, int newQuantity);
+    void dispatchReorderEvents();
+    void checkTotals() const;
+    bool loadSnapshot(const std::string& filename, uint64_t* logGeneration);
+    void ensureDocuments() const;
+    DocumentRegistry& loadedDocuments() const;
+    void logRecord(const WalRecordBuilder& record);
+    bool applyLogRecord(WalRecordReader& record);
+    void replayQuantityAt(size_t slot, int newQuantity, StockOperation operation,
+                          int documentId, time_t timestamp);
+    static bool readQuantityChanges(WalRecordReader& record,
+                                    std::vector<std::pair<int, int>>& changes);
+    void maybeCheckpoint();
+    std::shared_ptr<DocumentBase> findDocumentLocked(int id);
+    std::shared_ptr<DocumentBase> findModifiedDocument(int id);
+    std::shared_ptr<DocumentBase> findEditableDocument(int id);
+    bool hasColdCandidates() const;
+    bool rejectOnMirror() const;
+    bool checkDeltaRecord(WalRecordReader& record, DeltaCreations& created, std::string& error) const;
+    bool loadSyncState();
+    bool saveSyncState() const;
+    void fillSyncFields(SnapshotImage& image, uint64_t generation) const;
+    bool startCheckpointLocked(const SnapshotProgress& progress,
+                               const std::function<void(bool)>& finished);
 
 public:
     Warehouse();
+    ~Warehouse();
     
     // Управление товарами
-    std::shared_ptr<Product> addProduct(const std::string& name, double price, int quantity);
+    // addProduct, getProductById и getProductByName возвращают неизменяемый
+    // снимок товара на момент вызова; сами данные хранятся в ProductStore,
+    // остатки меняются только через методы склада (updateProductQuantity и др.)
+    std::shared_ptr<const Product> addProduct(const std::string& name, double price, int quantity);
     bool removeProduct(int id);
-    std::shared_ptr<Product> getProductById(int id);
-    std::shared_ptr<Product> getProductByName(const std::string& name);
-    const std::vector<std::shared_ptr<Product>>& getAllProducts() const;
+    std::shared_ptr<const Product> getProductById(int id) const;
+    std::shared_ptr<const Product> getProductByName(const std::string& name) const;
+    
+    // Пакетное добавление: место под пакет резервируется заранее, наименования
+    // сверяются с каталогом и между собой по хеш-индексу, id выдаются подряд
+    // начиная с nextProductId. В журнал пакет попадает одной записью.
+    BulkAddResult addProducts(const std::vector<ProductDraft>& batch);
+    const ProductStore& getAllProducts() const;
+    // Неизменяемая копия колонок каталога (O(1)) - для чтения в другом потоке
+    ProductColumns shareProductColumns() const;
     
     // Управление количеством
     bool updateProductQuantity(int id, int newQuantity);
     bool addProductQuantity(int id, int amount);
     bool removeProductQuantity(int id, int amount);
     
+    // Товары с остатком ниже threshold, по возрастанию остатка (O(k))
+    std::vector<int> getLowStockProductIds(int threshold) const;
+    
+    // Пороги дозаказа и уведомления о их пересечении
+    void setReorderThreshold(int threshold);
+    void setReorderThreshold(int productId, int threshold);
+    int getReorderThreshold(int productId) const;
+    int subscribeReorder(ReorderCallback callback);
+    void unsubscribeReorder(int subscriptionId);
+    
     // Управление документами
     std::shared_ptr<DocumentBase> createReceipt(
         const std::string& number, const std::string& createdBy,
@@ -61,25 +268,129 @@ public:
                                                 const std::string& comment = "");
     
     // Работа с документами
+    // Проводит документ: применяет все его строки к остаткам атомарно
+    PostingResult postDocument(int docId);
     bool processDocument(int docId);
-    bool cancelDocument(int docId);
+    // Отменяет черновик или проведенный документ; у проведенного движение
+    // остатков сторнируется атомарно, как при проведении
+    PostingResult cancelDocument(int docId);
+    // Строки и поля меняются только у черновика (false для проведенного и отмененного)
+    bool addDocumentItem(int docId, int productId, int quantity, const std::string& comment = "");
+    bool setDocumentField(int docId, const std::string& fieldName, const std::string& value);
+    // Документ из холодного сегмента подгружается при обращении
     std::shared_ptr<DocumentBase> getDocumentById(int id);
+    std::shared_ptr<DocumentBase> getDocumentByNumber(const std::string& number);
     const std::vector<std::shared_ptr<DocumentBase>>& getAllDocuments() const;
-    std::vector<std::shared_ptr<DocumentBase>> getDocumentsByType(DocumentType type) const;
+    // Число документов в памяти; не требует построения реестра
+    size_t getDocumentCount() const;
+    const std::vector<std::shared_ptr<DocumentBase>>& getDocumentsByType(DocumentType type) const;
+    
+    // Документы за период [from, to) - представление без копирования
+    DocumentRegistry::DateRange getDocumentsByDate(time_t from, time_t to) const;
+    DocumentRegistry::DateRange getDocumentsByDate(DocumentType type, time_t from, time_t to) const;
+    // Документы в статусе status (за период [from, to)) - по индексу статусов
+    DocumentRegistry::DateRange getDocumentsByStatus(DocumentStatus status) const;
+    DocumentRegistry::DateRange getDocumentsByStatus(DocumentStatus status, time_t from, time_t to) const;
+    // Реестр целиком - для массовых операций DocumentRegistry::forEach и filter
+    const DocumentRegistry& getDocumentRegistry() const;
+    // Итоги по типам и статусам документов за период [from, to): один проход
+    // по документам без виртуальных вызовов
+    DocumentSummary summarizeDocuments(time_t from = std::numeric_limits<time_t>::min(),
+                                       time_t to = std::numeric_limits<time_t>::max()) const;
+    
+    // Выгрузка документов за период [from, to) в каталог directory
+    DocumentExportResult exportDocuments(const std::string& directory,
+                                         DocumentExportFormat format = DocumentExportFormat::ARCHIVE,
+                                         time_t from = 0,
+                                         time_t to = std::numeric_limits<time_t>::max()) const;
+    
+    // Выгрузка для аналитики в колоночном формате (см. columnar_file.h):
+    // <prefix>_products.col, <prefix>_documents.col, <prefix>_document_lines.col
+    // и <prefix>_movements.col в каталоге directory. Как и exportDocuments,
+    // берет документы в памяти; движение товаров - за все время.
+    AnalyticsExportResult exportAnalytics(const std::string& directory,
+                                          const std::string& prefix = "warehouse") const;
     
     // Отчеты
     void printStockReport() const;
     void printLowStockReport(int threshold = 5) const;
     void printDocumentsReport() const;
     
-    // Статистика
+    // Движение товаров
+    const StockLedger& getLedger() const;
+    std::vector<MovementSummary> getMovementSummary(time_t from, time_t to) const;
+    
+    // Статистика (O(1), итоги ведутся инкрементально)
     int getTotalProductsCount() const;
-    int getTotalItemsCount() const;
+    long long getTotalItemsCount() const;
     double getTotalInventoryValue() const;
     
+    // Постоянное хранилище: снимок <basePath>.bin и журнал <basePath>.wal.<N>.
+    // При открытии загружается снимок и воспроизводится только хвост журнала.
+    // Каждое изменение склада пишется в журнал; когда журнал разрастается,
+    // в фоне записывается новый снимок, а старые поколения журнала удаляются.
+    // Новое хранилище (без снимка и журнала) заполняется демонстрационным каталогом.
+    bool openStorage(const std::string& basePath = "warehouse_data");
+    void closeStorage();
+    bool isStorageOpen() const;
+    // Дожидается, пока все изменения окажутся на диске; стоимость зависит
+    // только от объема изменений с прошлого вызова
+    bool commit();
+    // Записывает снимок и начинает новое поколение журнала;
+    // wait = false - запись снимка идет в фоне
+    bool checkpoint(bool wait = true);
+    void setCheckpointThreshold(uint64_t bytes);
+    
+    // Многоуровневое хранение документов. Проведенные документы старше
+    // заданного возраста уходят из памяти в сжатые сегменты <basePath>.cold.<N>
+    // при каждой контрольной точке. Списки и отчеты по реестру видят только
+    // документы в памяти; getDocumentById и getDocumentByNumber находят и вытесненные.
+    // seconds = 0 отключает вытеснение.
+    void setDocumentTierAge(time_t seconds);
+    // Вытесняет подходящие документы; возвращает их число
+    size_t tierDocuments(time_t now = time(nullptr));
+    // Контрольная точка для интерфейса: копия состояния снимается под
+    // блокировкой (колонки товаров - без копирования данных, см. SharedColumn),
+    // снимок пишется в фоне, склад можно менять во время записи.
+    // progress и finished вызываются из потока записи.
+    // false - хранилище не открыто, предыдущая запись еще идет
+    // или начать запись не удалось.
+    bool saveInBackground(const SnapshotProgress& progress,
+                          const std::function<void(bool)>& finished);
+    
+    // Синхронизация с зеркалом через файлы пакетов изменений.
+    // startChangeTracking записывает снимок: его копия вместе с сегментами
+    // <basePath>.cold.* - исходное состояние зеркала. Дальше exportChanges
+    // выгружает только изменения с прошлой выгрузки. На зеркале importChanges
+    // применяет пакеты по порядку; повторный пакет ничего не меняет. Пакет
+    // проверяется целиком до применения и при ошибке или конфликте не
+    // применяется вовсе. Зеркало ведет один источник; для нескольких складов
+    // нужны отдельные зеркала (свой basePath на каждый), так как id их
+    // товаров и документов пересекаются. Локальные изменения на зеркале
+    // отклоняются.
+    bool startChangeTracking();
+    bool isChangeTrackingEnabled() const { return instanceId != 0; }
+    DeltaExportResult exportChanges(const std::string& filename);
+    DeltaImportResult importChanges(const std::string& filename);
+    
+    // Публикация остатков в разделяемой памяти: внешние программы читают их
+    // через LiveStockReader без копирования и без блокировки склада.
+    // Витрина обновляется при каждом изменении остатков и каталога.
+    bool startLiveView(const std::string& name = LIVE_STOCK_DEFAULT_NAME);
+    void stopLiveView();
+    bool isLiveViewActive() const { return liveView.isOpen(); }
+    
     // Сохранение/загрузка
-    bool saveToFile(const std::string& filename = "warehouse_data.txt") const;
-    bool loadFromFile(const std::string& filename = "warehouse_data.txt");
+    // Основной формат - двоичный снимок (см. snapshot.h)
+    bool saveToFile(const std::string& filename = "warehouse_data.bin") const;
+    bool loadFromFile(const std::string& filename = "warehouse_data.bin");
+    
+    // Обмен каталогом в текстовом формате id,name,price,quantity
+    bool exportToCsv(const std::string& filename) const;
+    bool importFromCsv(const std::string& filename);
+    // Массовая загрузка каталога (см. CsvImporter): заменяет каталог целиком,
+    // ошибочные строки пропускаются и перечисляются в результате
+    CsvImportResult importCatalog(const std::string& filename, unsigned threads = 0);
     
     // Вспомогательные методы
     std::map<std::string, int> getCategorySummary() const;
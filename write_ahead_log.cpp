@@ -0,0 +1,296 @@
+#include "write_ahead_log.h"
+#include "mapped_file.h"
+#include <filesystem>
+#include <algorithm>
+#include <chrono>
+
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Пакет сбрасывается не реже, чем раз в FLUSH_INTERVAL, или сразу при таком объеме
+const auto FLUSH_INTERVAL = chrono::milliseconds(20);
+const size_t FLUSH_THRESHOLD = 256 * 1024;
+
+const size_t FRAME_HEADER_SIZE = 2 * sizeof(uint32_t);
+
+uint32_t recordChecksum(const char* data, size_t size) {
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < size; i++) {
+        hash = (hash ^ static_cast<unsigned char>(data[i])) * 16777619u;
+    }
+    return hash;
+}
+
+} // namespace
+
+WriteAheadLog::~WriteAheadLog() {
+    close();
+}
+
+string WriteAheadLog::generationPath(const string& basePath, uint64_t generation) {
+    return basePath + ".wal." + to_string(generation);
+}
+
+bool WriteAheadLog::open(const string& _basePath, uint64_t _generation) {
+    close();
+    basePath = _basePath;
+    generation = _generation;
+    string path = generationPath(basePath, generation);
+    file = fopen(path.c_str(), "ab");
+    if (!file) return false;
+    // Пакеты пишутся целиком одним fwrite; без буфера FILE после неудачной
+    // записи в нем не остается байт, которые ушли бы в файл позже
+    setvbuf(file, nullptr, _IONBF, 0);
+
+    stopping = false;
+    flushInFlight = false;
+    failedFlushes = 0;
+    pending.clear();
+    appendedBytes = durableBytes = 0;
+    error_code ignored;
+    generationBytes = filesystem::file_size(path, ignored);
+    if (ignored) generationBytes = 0;
+    fileBytes = generationBytes;
+    flusher = thread(&WriteAheadLog::flushLoop, this);
+    return true;
+}
+
+void WriteAheadLog::close() {
+    if (flusher.joinable()) {
+        {
+            lock_guard<mutex> lock(logMutex);
+            stopping = true;
+        }
+        flushRequested.notify_all();
+        flusher.join();
+    }
+    if (file) {
+        fclose(file);
+        file = nullptr;
+    }
+}
+
+void WriteAheadLog::append(const WalRecordBuilder& record) {
+    const string& payload = record.data();
+    uint32_t header[2] = {static_cast<uint32_t>(payload.size()),
+                          recordChecksum(payload.data(), payload.size())};
+
+    bool wakeFlusher;
+    {
+        lock_guard<mutex> lock(logMutex);
+        pending.append(reinterpret_cast<const char*>(header), sizeof(header));
+        pending.append(payload);
+        size_t frameSize = sizeof(header) + payload.size();
+        appendedBytes += frameSize;
+        generationBytes += frameSize;
+        wakeFlusher = pending.size() >= FLUSH_THRESHOLD;
+    }
+    if (wakeFlusher) flushRequested.notify_one();
+}
+
+// Пишет пакет в конец файла с fsync. При ошибке файл обрезается до
+// validSize, чтобы повторная запись пакета не оставила в журнале его обрывок.
+bool WriteAheadLog::writeBatch(FILE* target, const string& path, uint64_t validSize,
+                               const string& data) {
+    bool ok = fwrite(data.data(), 1, data.size(), target) == data.size() && fflush(target) == 0;
+#ifndef _WIN32
+    ok = ok && fsync(fileno(target)) == 0;
+#endif
+    if (!ok) {
+        clearerr(target);
+        error_code ignored;
+        filesystem::resize_file(path, validSize, ignored);
+    }
+    return ok;
+}
+
+// Отдает накопленный пакет на диск; запись идет без удержания мьютекса,
+// чтобы append не ждал fsync. Пока пакет пишется, flushInFlight не дает
+// rotate закрыть файл. Неудачный пакет возвращается в начало очереди.
+bool WriteAheadLog::flushPendingLocked(unique_lock<mutex>& lock) {
+    if (pending.empty() || !file || flushInFlight) return true;
+
+    string batch;
+    batch.swap(pending);
+    FILE* target = file;
+    string path = generationPath(basePath, generation);
+    uint64_t validSize = fileBytes;
+    flushInFlight = true;
+    lock.unlock();
+    bool ok = writeBatch(target, path, validSize, batch);
+    lock.lock();
+    flushInFlight = false;
+
+    if (ok) {
+        durableBytes += batch.size();
+        fileBytes += batch.size();
+    } else {
+        pending.insert(0, batch);
+        failedFlushes++;
+    }
+    flushCompleted.notify_all();
+    return ok;
+}
+
+void WriteAheadLog::flushLoop() {
+    unique_lock<mutex> lock(logMutex);
+    while (true) {
+        flushRequested.wait_for(lock, FLUSH_INTERVAL,
+                                [this] { return stopping || pending.size() >= FLUSH_THRESHOLD; });
+        bool ok = flushPendingLocked(lock);
+        // При закрытии неудачный пакет не повторяется бесконечно
+        if (stopping && (pending.empty() || !ok)) break;
+    }
+}
+
+bool WriteAheadLog::sync() {
+    unique_lock<mutex> lock(logMutex);
+    if (!file) return false;
+    uint64_t target = appendedBytes;
+    uint64_t failures = failedFlushes;
+    flushRequested.notify_one();
+    flushCompleted.wait(lock, [this, target, failures] {
+        return durableBytes >= target || failedFlushes != failures;
+    });
+    return durableBytes >= target;
+}
+
+uint64_t WriteAheadLog::rotate() {
+    // Основную часть очереди сбрасывает флешер, не задерживая append
+    sync();
+
+    unique_lock<mutex> lock(logMutex);
+    // Файл нельзя закрывать, пока флешер пишет в него без мьютекса
+    flushCompleted.wait(lock, [this] { return !flushInFlight; });
+    if (!file) return generation;
+
+    // Записи, добавленные после sync, принадлежат текущему поколению
+    if (!pending.empty()) {
+        if (!writeBatch(file, generationPath(basePath, generation), fileBytes, pending)) {
+            failedFlushes++;
+            flushCompleted.notify_all();
+            return generation;
+        }
+        durableBytes += pending.size();
+        pending.clear();
+        flushCompleted.notify_all();
+    }
+
+    FILE* next = fopen(generationPath(basePath, generation + 1).c_str(), "ab");
+    if (!next) return generation;
+    setvbuf(next, nullptr, _IONBF, 0);
+    fclose(file);
+    file = next;
+    generation++;
+    generationBytes = 0;
+    fileBytes = 0;
+    return generation;
+}
+
+bool WriteAheadLog::isOpen() const {
+    lock_guard<mutex> lock(logMutex);
+    return file != nullptr;
+}
+
+uint64_t WriteAheadLog::currentGeneration() const {
+    lock_guard<mutex> lock(logMutex);
+    return generation;
+}
+
+uint64_t WriteAheadLog::bytesInGeneration() const {
+    lock_guard<mutex> lock(logMutex);
+    return generationBytes;
+}
+
+WalPosition WriteAheadLog::position() const {
+    lock_guard<mutex> lock(logMutex);
+    return WalPosition{generation, generationBytes};
+}
+
+void WriteAheadLog::removeGenerationsBefore(uint64_t before) const {
+    for (uint64_t existing : listGenerations(basePath)) {
+        if (existing >= before) break;
+        error_code ignored;
+        filesystem::remove(generationPath(basePath, existing), ignored);
+    }
+}
+
+vector<uint64_t> WriteAheadLog::listGenerations(const string& basePath) {
+    vector<uint64_t> generations;
+    filesystem::path base(basePath);
+    filesystem::path directory = base.has_parent_path() ? base.parent_path() : filesystem::path(".");
+    string prefix = base.filename().string() + ".wal.";
+
+    error_code error;
+    for (const auto& entry : filesystem::directory_iterator(directory, error)) {
+        string name = entry.path().filename().string();
+        if (name.compare(0, prefix.size(), prefix) != 0) continue;
+        string suffix = name.substr(prefix.size());
+        if (suffix.empty() || !all_of(suffix.begin(), suffix.end(), ::isdigit)) continue;
+        generations.push_back(stoull(suffix));
+    }
+    sort(generations.begin(), generations.end());
+    return generations;
+}
+
+size_t WriteAheadLog::scanFrames(const char* data, size_t size, const FrameVisitor& visit) {
+    size_t position = 0;
+    while (position + FRAME_HEADER_SIZE <= size) {
+        uint32_t header[2];
+        memcpy(header, data + position, sizeof(header));
+        const char* payload = data + position + FRAME_HEADER_SIZE;
+        if (header[0] == 0 || header[0] > size - position - FRAME_HEADER_SIZE ||
+            recordChecksum(payload, header[0]) != header[1]) {
+            return position;
+        }
+
+        size_t frameSize = FRAME_HEADER_SIZE + header[0];
+        WalRecordReader reader(payload, header[0]);
+        if (!visit(data + position, frameSize, position, reader)) return position;
+        position += frameSize;
+    }
+    return position;
+}
+
+size_t WriteAheadLog::replay(const string& basePath, uint64_t fromGeneration,
+                             const ReplayCallback& apply, string& error) {
+    size_t applied = 0;
+    error.clear();
+
+    for (uint64_t generation : listGenerations(basePath)) {
+        if (generation < fromGeneration) continue;
+
+        MappedFile log;
+        if (!log.open(generationPath(basePath, generation))) {
+            error = "Не удалось открыть журнал поколения " + to_string(generation);
+            return applied;
+        }
+
+        bool failed = false;
+        size_t position = scanFrames(log.data(), log.size(),
+            [&](const char*, size_t, size_t, WalRecordReader& reader) {
+                if (!apply(reader) || !reader.good()) {
+                    failed = true;
+                    return false;
+                }
+                applied++;
+                return true;
+            });
+        if (failed) {
+            error = "Некорректная запись журнала поколения " + to_string(generation);
+            return applied;
+        }
+        if (position != log.size()) {
+            // Оборванный хвост после сбоя: все, что дальше, не подтверждено
+            error = "Журнал поколения " + to_string(generation) + " оборван на смещении " +
+                    to_string(position);
+            return applied;
+        }
+    }
+    return applied;
+}
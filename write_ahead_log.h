@@ -0,0 +1,211 @@
+#ifndef WRITE_AHEAD_LOG_H
+#define WRITE_AHEAD_LOG_H
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <cstddef>
+
+// Тип записи журнала изменений склада.
+// Записи, меняющие остаток, заканчиваются временем изменения (и видом
+// операции для QUANTITY_SET) - из них восстанавливается журнал движения.
+// В записях, сделанных до появления этих полей, их нет (см. atEnd).
+enum class WalRecordType : uint8_t {
+    PRODUCT_ADD = 1,      // id, цена, количество, наименование, время
+    PRODUCT_REMOVE,       // id, время
+    QUANTITY_SET,         // id, новое количество, время, операция (StockOperation)
+    DOCUMENT_CREATE,      // id, тип, дата, номер, создал, подразделение, комментарий
+    DOCUMENT_ITEM,        // id документа, id товара, количество, комментарий
+    DOCUMENT_FIELD,       // id документа, поле, значение
+    DOCUMENT_POSTED,      // id документа, статус, пары (id товара, новое количество), время
+    PRODUCT_BATCH_ADD,    // число товаров, для каждого как в PRODUCT_ADD без времени, время
+    CATALOG_REPLACED,     // каталог заменен целиком (импорт); поток изменений прерван
+    CHANGES_APPLIED,      // источник, позиция (поколение, смещение), кадры записей источника
+    DOCUMENT_CANCELLED    // id документа, пары (id товара, новое количество), время
+};
+
+// Позиция в журнале: поколение и смещение от начала его файла
+struct WalPosition {
+    uint64_t generation = 0;
+    uint64_t offset = 0;
+
+    bool operator<(const WalPosition& other) const {
+        return generation != other.generation ? generation < other.generation
+                                              : offset < other.offset;
+    }
+    bool operator==(const WalPosition& other) const {
+        return generation == other.generation && offset == other.offset;
+    }
+};
+
+// Сборка полезной нагрузки записи
+class WalRecordBuilder {
+private:
+    std::string bytes;
+
+public:
+    explicit WalRecordBuilder(WalRecordType type) { bytes.push_back(static_cast<char>(type)); }
+
+    WalRecordBuilder& putInt(int32_t value) { return putRaw(&value, sizeof(value)); }
+    WalRecordBuilder& putInt64(int64_t value) { return putRaw(&value, sizeof(value)); }
+    WalRecordBuilder& putUInt64(uint64_t value) { return putRaw(&value, sizeof(value)); }
+    WalRecordBuilder& putDouble(double value) { return putRaw(&value, sizeof(value)); }
+    WalRecordBuilder& putString(std::string_view value) {
+        putInt(static_cast<int32_t>(value.size()));
+        bytes.append(value.data(), value.size());
+        return *this;
+    }
+
+    // Байты до конца записи, без длины (читаются WalRecordReader::getTail)
+    WalRecordBuilder& putTail(const char* data, size_t size) { return putRaw(data, size); }
+
+    void reserve(size_t size) { bytes.reserve(size + 1); }
+    const std::string& data() const { return bytes; }
+
+private:
+    WalRecordBuilder& putRaw(const void* data, size_t size) {
+        bytes.append(static_cast<const char*>(data), size);
+        return *this;
+    }
+};
+
+// Разбор полезной нагрузки записи; при выходе за границы good() становится false
+class WalRecordReader {
+private:
+    const char* data;
+    size_t size;
+    size_t position = 1;
+    bool ok = true;
+
+    template<typename T>
+    T getRaw() {
+        T value{};
+        if (position + sizeof(T) > size) {
+            ok = false;
+            return value;
+        }
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+public:
+    WalRecordReader(const char* _data, size_t _size) : data(_data), size(_size) {}
+
+    WalRecordType type() const { return static_cast<WalRecordType>(data[0]); }
+    int32_t getInt() { return getRaw<int32_t>(); }
+    int64_t getInt64() { return getRaw<int64_t>(); }
+    uint64_t getUInt64() { return getRaw<uint64_t>(); }
+    double getDouble() { return getRaw<double>(); }
+    std::string getString() {
+        int32_t length = getInt();
+        if (!ok || length < 0 || position + static_cast<size_t>(length) > size) {
+            ok = false;
+            return std::string();
+        }
+        std::string value(data + position, static_cast<size_t>(length));
+        position += static_cast<size_t>(length);
+        return value;
+    }
+    std::string_view getTail() {
+        std::string_view tail(data + position, size - position);
+        position = size;
+        return tail;
+    }
+    bool good() const { return ok; }
+    // Прочитана ли запись целиком: так отличаются записи без необязательных полей в конце
+    bool atEnd() const { return position >= size; }
+};
+
+// Журнал упреждающей записи.
+//
+// Каждое изменение склада добавляется как короткая двоичная запись
+// [длина][контрольная сумма][тип][данные]. Записи копятся в памяти, фоновый
+// поток сбрасывает их на диск пакетами (group commit) с fsync на пакет.
+// Журнал разбит на поколения: файл <base>.wal.<N>. При контрольной точке
+// начинается новое поколение, а старые удаляются, когда снимок записан.
+class WriteAheadLog {
+public:
+    using ReplayCallback = std::function<bool(WalRecordReader&)>;
+    // Кадр целиком ([длина][контрольная сумма][данные]), его смещение и разобранная запись
+    using FrameVisitor = std::function<bool(const char* frame, size_t frameSize, size_t offset,
+                                            WalRecordReader& record)>;
+
+    WriteAheadLog() = default;
+    ~WriteAheadLog();
+
+    WriteAheadLog(const WriteAheadLog&) = delete;
+    WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+    // Открывает поколение generation для дозаписи и запускает фоновый сброс
+    bool open(const std::string& basePath, uint64_t generation);
+    void close();
+    bool isOpen() const;
+
+    void append(const WalRecordBuilder& record);
+
+    // Ждет, пока все добавленные до вызова записи окажутся на диске.
+    // false - запись пакета не удалась (например, кончилось место); записи
+    // остаются в очереди, и следующий сброс повторит их.
+    bool sync();
+
+    // Закрывает текущее поколение и начинает следующее; возвращает его номер.
+    // Если дописать текущее поколение или создать файл следующего не удалось,
+    // возвращает номер текущего, и запись продолжается в него.
+    uint64_t rotate();
+    uint64_t currentGeneration() const;
+    uint64_t bytesInGeneration() const;
+    // Позиция, с которой будет записана следующая запись
+    WalPosition position() const;
+
+    // Удаляет файлы поколений меньше generation
+    void removeGenerationsBefore(uint64_t generation) const;
+
+    // Номера существующих поколений по возрастанию
+    static std::vector<uint64_t> listGenerations(const std::string& basePath);
+
+    // Воспроизводит записи поколений начиная с fromGeneration.
+    // Останавливается на первой поврежденной или оборванной записи.
+    static size_t replay(const std::string& basePath, uint64_t fromGeneration,
+                         const ReplayCallback& apply, std::string& error);
+
+    // Обходит целые кадры в data[0, size). Возвращает смещение первого не
+    // разобранного байта: size, если хвост не оборван; visit, вернувший
+    // false, останавливает обход на своем кадре.
+    static size_t scanFrames(const char* data, size_t size, const FrameVisitor& visit);
+
+    static std::string generationPath(const std::string& basePath, uint64_t generation);
+
+private:
+    std::string basePath;
+    uint64_t generation = 0;
+    FILE* file = nullptr;
+
+    mutable std::mutex logMutex;
+    std::condition_variable flushRequested;
+    std::condition_variable flushCompleted;
+    std::thread flusher;
+    bool stopping = false;
+
+    std::string pending;             // записи, еще не переданные на диск
+    uint64_t appendedBytes = 0;      // всего добавлено байт
+    uint64_t durableBytes = 0;       // из них сброшено с fsync
+    uint64_t generationBytes = 0;    // добавлено в текущее поколение
+    uint64_t fileBytes = 0;          // размер файла текущего поколения, сброшенный с fsync
+    bool flushInFlight = false;      // флешер пишет пакет в file без мьютекса
+    uint64_t failedFlushes = 0;      // число неудачных сбросов (для sync)
+
+    void flushLoop();
+    bool writeBatch(FILE* target, const std::string& path, uint64_t validSize,
+                    const std::string& data);
+    bool flushPendingLocked(std::unique_lock<std::mutex>& lock);
+};
+
+#endif // WRITE_AHEAD_LOG_H